@@ -1,6 +1,10 @@
 #include "BattleTank.hpp"
 
+#include <chrono>
+
 #include "engine/core/logger.hpp"
+#include "engine/gems/state/io.hpp"
+#include "messages/state/differential_base.hpp"
 #include <math.h>
 
 namespace isaac
@@ -8,58 +12,161 @@ namespace isaac
 namespace ev3
 {
 
-int writePPM(uint16_t width, uint16_t height, uint32_t *image, const char *filename, uint32_t index);
-void demosaic(uint16_t width, uint16_t height, const uint8_t *bayerImage, uint32_t *image);
-
-// Name of states
-constexpr char kStateInit[] = "kInit";
-constexpr char kStateExit[] = "kExit";
-constexpr char kStateNavigation[] = "kStateNavigation";
-constexpr char kStateDetected[] = "kStateDetected";
-constexpr char kStateCloseToShoot[] = "kStateCloseToShoot";
-constexpr char kStateShoot[] = "kStateShoot";
+const char *BattleTank::ToString(State state)
+{
+  switch (state)
+  {
+  case State::kInit:
+    return "kInit";
+  case State::kNavigation:
+    return "kStateNavigation";
+  case State::kDetected:
+    return "kStateDetected";
+  case State::kShoot:
+    return "kStateShoot";
+  case State::kExit:
+    return "kExit";
+  default:
+    return "unknown";
+  }
+}
 
 void BattleTank::start()
 {
   navigation_mode_ = node()->app()->findComponentByName<navigation::GroupSelectorBehavior>(
       get_navigation_mode());
   ASSERT(navigation_mode_, "Could not find navigation mode");
+  pixy_vision_ = node()->app()->findComponentByName<PixyVision>(get_pixy_vision());
+  ASSERT(pixy_vision_, "Could not find Pixy2 camera");
+  ASSERT(get_control_mode() == "goal" || get_control_mode() == "servo", "Unknown control mode '%s'",
+         get_control_mode().c_str());
+  servo_mode_ = get_control_mode() == "servo";
+  ASSERT(get_detection_source() == "pixy" || get_detection_source() == "blob",
+         "Unknown detection source '%s'", get_detection_source().c_str());
+  blob_source_ = get_detection_source() == "blob";
   createStateMachine();
 
   // Start in desired state
-  machine_.start(kStateInit);
+  machine_.start(State::kInit);
 
-  tickPeriodically();
+  // both sources publish detections for every frame, thus we react at camera rate
+  tickOnMessage(detections());
+}
 
-  // we need to initalise it after call to tickPeriodically() to work
-  int result = pixy.init();
-  ASSERT(result >= 0, "Could not initialise Pixy2 Camera");
+alice::ProtoRx<Detections2Proto> &BattleTank::detections()
+{
+  return blob_source_ ? rx_blob_blocks() : rx_blocks();
 }
 
 void BattleTank::tick()
 {
-  pixy.ccc.getBlocks(true, CCC_SIG1, 1);
+  const auto timer = tick_latency_.measure();
+  tick_latency_.report(getTickTime(), [this](const char *tag, double value) { show(tag, value); });
+  target_visible_ = readTarget(target_);
   machine_.tick();
 }
 
+bool BattleTank::readTarget(Target &target)
+{
+  auto proto = detections().getProto();
+  auto predictions = proto.getPredictions();
+  auto boxes = proto.getBoundingBoxes();
+  const std::string signature = std::to_string(get_target_signature());
+  // blocks are sorted by size, the first one with our signature is the biggest
+  for (size_t i = 0; i < predictions.size() && i < boxes.size(); i++)
+  {
+    if (signature != predictions[i].getLabel().cStr())
+    {
+      continue;
+    }
+    // bounding boxes are given as (row, column)
+    const Vector2d min = FromProto(boxes[i].getMin());
+    const Vector2d max = FromProto(boxes[i].getMax());
+    target.x = 0.5 * (min.y() + max.y());
+    target.y = 0.5 * (min.x() + max.x());
+    target.width = max.y() - min.y();
+    target.height = max.x() - min.x();
+    return true;
+  }
+  return false;
+}
+
 void BattleTank::stop()
 {
   machine_.stop();
+  tick_latency_.dump(full_name());
+  // time spent per state and the cost of checking its transitions
+  for (size_t i = 0; i < static_cast<size_t>(State::kCount); i++)
+  {
+    const State state = static_cast<State>(i);
+    const auto &stats = machine_.stats(state);
+    if (stats.entries == 0)
+    {
+      continue;
+    }
+    LOG_INFO("%s: entered %llu times, %.3f s, %llu checks, %.2f us per check", ToString(state),
+             static_cast<unsigned long long>(stats.entries),
+             std::chrono::duration<double>(stats.time_in_state).count(),
+             static_cast<unsigned long long>(stats.checks), 1e6 * stats.averageCheckTime());
+  }
 }
 
-void BattleTank::createStateMachine()
+void BattleTank::startServo()
+{
+  VisualServo::Parameters parameters;
+  parameters.angular_gain = get_servo_angular_gain();
+  parameters.linear_gain = get_servo_linear_gain();
+  parameters.min_linear_speed = get_servo_min_linear_speed();
+  parameters.max_linear_speed = get_servo_max_linear_speed();
+  parameters.max_angular_speed = get_servo_max_angular_speed();
+  parameters.max_linear_acceleration = get_servo_max_linear_acceleration();
+  parameters.max_angular_acceleration = get_servo_max_angular_acceleration();
+  parameters.center_threshold = get_center_threshold();
+  parameters.area_threshold = get_area_threshold();
+  parameters.lost_lock_timeout = get_lost_lock_timeout();
+  servo_.setParameters(parameters);
+  servo_.reset();
+  // the planner must not fight the servo for the base
+  navigation_mode_->async_set_desired_behavior("stop");
+  // we only enter this state with the target in sight, take the lock right away
+  tickServo();
+}
+
+void BattleTank::tickServo()
 {
-  const std::vector<State> all_states = {
-      kStateNavigation,
-      kStateDetected,
-      kStateShoot};
+  VisualServo::Command command;
+  if (target_visible_)
+  {
+    const double frameWidth = pixy_vision_->frameWidth();
+    const double frameHeight = pixy_vision_->frameHeight();
+    const double offset = (target_.x - frameWidth / 2) / frameWidth;
+    const double area = target_.width * target_.height / (frameWidth * frameHeight);
+    command = servo_.update(getTickTime(), offset, area);
+  }
+  else
+  {
+    command = servo_.update(getTickTime());
+  }
+  if (servo_.arrived())
+  {
+    shoot_target = true;
+  }
+
+  messages::DifferentialBaseControl control;
+  control.linear_speed() = command.linear_speed;
+  control.angular_speed() = command.angular_speed;
+  ToProto(control, tx_command().initProto(), tx_command().buffers());
+  tx_command().publish();
+}
 
-  machine_.setToString([this](const State &state) { return state; });
+void BattleTank::createStateMachine()
+{
+  machine_.setToString(&BattleTank::ToString);
 
-  machine_.addState(kStateInit, [] {}, [] {}, [] {});
+  machine_.addState(State::kInit, [] {}, [] {}, [] {});
 
   // move in kStateNavigation after world_T_robot is available
-  machine_.addTransition(kStateInit, kStateNavigation,
+  machine_.addTransition(State::kInit, State::kNavigation,
                          [this] {
                            bool ok;
                            get_world_T_robot(getTickTime(), ok);
@@ -71,29 +178,29 @@ void BattleTank::createStateMachine()
                          },
                          [this] {});
 
-  machine_.addState(kStateNavigation,
+  machine_.addState(State::kNavigation,
                     [this] {
-                      LOG_INFO("Entering %s", kStateNavigation);
+                      LOG_INFO("Entering %s", ToString(State::kNavigation));
                     },
                     [this] {
-                      if (rx_original_goal().available())
-                      {
-                        auto original_goal = rx_original_goal().getProto();
-                        auto goal = tx_goal().initProto();
-                        // publish back the original goal
-                        goal.setGoal(original_goal.getGoal());
-                        goal.setGoalFrame(original_goal.getGoalFrame());
-                        goal.setStopRobot(original_goal.getStopRobot());
-                        goal.setTolerance(original_goal.getTolerance());
-                        tx_goal().publish();
-                      }
+                      // we tick at camera rate, only forward goals we did not forward yet
+                      rx_original_goal().processLatestNewMessage(
+                          [this](auto original_goal, int64_t pubtime, int64_t acqtime) {
+                            auto goal = tx_goal().initProto();
+                            // publish back the original goal
+                            goal.setGoal(original_goal.getGoal());
+                            goal.setGoalFrame(original_goal.getGoalFrame());
+                            goal.setStopRobot(original_goal.getStopRobot());
+                            goal.setTolerance(original_goal.getTolerance());
+                            tx_goal().publish();
+                          });
                     },
                     [] {});
 
   // move in kStateDetected if Pixy2 detected the target
-  machine_.addTransition(kStateNavigation, kStateDetected,
+  machine_.addTransition(State::kNavigation, State::kDetected,
                          [this] {
-                           if (pixy.ccc.numBlocks && !success)
+                           if (target_visible_ && !success)
                            {
                              return true;
                            }
@@ -102,21 +209,29 @@ void BattleTank::createStateMachine()
                          [this] {
                          });
 
-  machine_.addState(kStateDetected, [this] { 
-        LOG_INFO("Entering %s", kStateDetected); 
+  machine_.addState(State::kDetected, [this] { 
+        LOG_INFO("Entering %s", ToString(State::kDetected)); 
         translation = false;
         rotation = false;
         prev_translation = false;
-        prev_rotation = false; },
+        prev_rotation = false;
+        if (servo_mode_) {
+            startServo();
+        } },
                     [this] {
-        if (pixy.ccc.numBlocks) {
+        if (servo_mode_) {
+            tickServo();
+            return;
+        }
+        if (target_visible_) {
             Pose2d move_to = Pose2d::Translation(0,0);
             translation = false;
             rotation = false;
-            Block block = pixy.ccc.blocks[0];            
+            const double frameWidth = pixy_vision_->frameWidth();
+            const double frameHeight = pixy_vision_->frameHeight();
             // check first the alignment
-            if(std::abs(block.m_x-pixy.frameWidth/2) > get_center_threshold()*pixy.frameWidth){                
-                if(block.m_x - pixy.frameWidth/2 < 0) {
+            if(std::abs(target_.x-frameWidth/2) > get_center_threshold()*frameWidth){                
+                if(target_.x - frameWidth/2 < 0) {
                     move_to = Pose2d::Rotation(M_PI_4)*Pose2d::Translation(0.2,0);
                 } else {
                     move_to = Pose2d::Rotation(-M_PI_4)*Pose2d::Translation(0.2,0);
@@ -125,8 +240,8 @@ void BattleTank::createStateMachine()
                 rotation=true;
             } else {
                 // if aligned with the target, check the distance
-                double area_detected = block.m_width * block.m_height;
-                double pixyFrameArea = (pixy.frameWidth * pixy.frameHeight);
+                double area_detected = target_.width * target_.height;
+                double pixyFrameArea = (frameWidth * frameHeight);
                 if (area_detected / pixyFrameArea > get_area_threshold())
                 {
                     // stop as it's close enough
@@ -168,7 +283,7 @@ void BattleTank::createStateMachine()
         } }, [] {});
 
   // move kStateShoot if target is aligned and close enough
-  machine_.addTransition(kStateDetected, kStateShoot,
+  machine_.addTransition(State::kDetected, State::kShoot,
                          [this] {
                            if (shoot_target)
                            {
@@ -179,34 +294,31 @@ void BattleTank::createStateMachine()
                          [this] {
                          });
 
-  machine_.addState(kStateShoot, [this] {
-    LOG_INFO("Entering %s", kStateShoot);
+  // in servo mode go back to kStateNavigation if we lost the target
+  machine_.addTransition(State::kDetected, State::kNavigation,
+                         [this] {
+                           return servo_mode_ && !servo_.locked();
+                         },
+                         [this] {
+                           LOG_WARNING("Lost lock, resuming navigation");
+                           navigation_mode_->async_set_desired_behavior(get_navigate_behavior());
+                         });
+
+  machine_.addState(State::kShoot, [this] {
+    LOG_INFO("Entering %s", ToString(State::kShoot));
     success = true;
     shoot_target = false;
 
-    // take a picture with Pixy2
-    pixy.m_link.stop();
-    int result;
-    uint8_t *bayerFrame;
-    uint32_t rgbFrame[PIXY2_RAW_FRAME_WIDTH * PIXY2_RAW_FRAME_HEIGHT];
-    // grab raw frame, BGGR Bayer format, 1 byte per pixel
-    pixy.m_link.getRawFrame(&bayerFrame);
-    // convert Bayer frame to RGB frame
-    demosaic(PIXY2_RAW_FRAME_WIDTH, PIXY2_RAW_FRAME_HEIGHT, bayerFrame, rgbFrame);
-    // write frame to PPM file for verification
-    result = writePPM(PIXY2_RAW_FRAME_WIDTH, PIXY2_RAW_FRAME_HEIGHT, rgbFrame, "out", ++index_frame);
-    if (result < 0)
-    {
-      LOG_ERROR("Can't write PPM file");
-    }
-    pixy.m_link.resume();
+    // the camera thread takes the picture with its next frame
+    pictures_before_shot_ = pixy_vision_->picturesDone();
+    pixy_vision_->requestPicture();
   },
                     [] {}, [] {});
 
   // move back to kStateNavigation after taking picture
-  machine_.addTransition(kStateShoot, kStateNavigation,
+  machine_.addTransition(State::kShoot, State::kNavigation,
                          [this] {
-                           if (success)
+                           if (pixy_vision_->picturesDone() != pictures_before_shot_)
                            {
                              return true;
                            }
@@ -215,86 +327,7 @@ void BattleTank::createStateMachine()
                          [this] {
                          });
 
-  machine_.addState(kStateExit, [this] {}, [] {}, [] {});
-}
-
-
-// functions from Pixy2 samples to get full raw frames
-// https://github.com/charmedlabs/pixy2/blob/master/src/host/libpixyusb2_examples/get_raw_frame/get_raw_frame.cpp
-int writePPM(uint16_t width, uint16_t height, uint32_t *image, const char *filename, uint32_t index)
-{
-  int i, j;
-  char fn[32];
-
-  sprintf(fn, "/tmp/%s%010d.ppm", filename, index);
-  FILE *fp = fopen(fn, "wb");
-  if (fp == NULL)
-    return -1;
-  fprintf(fp, "P6\n%d %d\n255\n", width, height);
-  for (j = 0; j < height; j++)
-  {
-    for (i = 0; i < width; i++)
-      fwrite((char *)(image + j * width + i), 1, 3, fp);
-  }
-  fclose(fp);
-  return 0;
-}
-
-void demosaic(uint16_t width, uint16_t height, const uint8_t *bayerImage, uint32_t *image)
-{
-  uint32_t x, y, r, g, b;
-  int32_t xx, yy;
-  uint8_t *pixel0, *pixel;
-
-  for (y = 0; y < height; y++)
-  {
-    yy = y;
-    if (yy == 0)
-      yy++;
-    else if (yy == height - 1)
-      yy--;
-    pixel0 = (uint8_t *)bayerImage + yy * width;
-    for (x = 0; x < width; x++, image++)
-    {
-      xx = x;
-      if (xx == 0)
-        xx++;
-      else if (xx == width - 1)
-        xx--;
-      pixel = pixel0 + xx;
-      if (yy & 1)
-      {
-        if (xx & 1)
-        {
-          r = *pixel;
-          g = (*(pixel - 1) + *(pixel + 1) + *(pixel + width) + *(pixel - width)) >> 2;
-          b = (*(pixel - width - 1) + *(pixel - width + 1) + *(pixel + width - 1) + *(pixel + width + 1)) >> 2;
-        }
-        else
-        {
-          r = (*(pixel - 1) + *(pixel + 1)) >> 1;
-          g = *pixel;
-          b = (*(pixel - width) + *(pixel + width)) >> 1;
-        }
-      }
-      else
-      {
-        if (xx & 1)
-        {
-          r = (*(pixel - width) + *(pixel + width)) >> 1;
-          g = *pixel;
-          b = (*(pixel - 1) + *(pixel + 1)) >> 1;
-        }
-        else
-        {
-          r = (*(pixel - width - 1) + *(pixel - width + 1) + *(pixel + width - 1) + *(pixel + width + 1)) >> 2;
-          g = (*(pixel - 1) + *(pixel + 1) + *(pixel + width) + *(pixel - width)) >> 2;
-          b = *pixel;
-        }
-      }
-      *image = (b << 16) | (g << 8) | r;
-    }
-  }
+  machine_.addState(State::kExit, [this] {}, [] {}, [] {});
 }
 
 } // namespace ev3
@@ -4,14 +4,16 @@
 #include <utility>
 #include <vector>
 
-#include "libpixyusb2.h"
+#include "PixyVision.hpp"
+#include "VisualServo.hpp"
 
 #include "engine/alice/alice.hpp"
 #include "messages/messages.hpp"
 #include "engine/alice/components/deprecated/GroupSelectorBehavior.hpp"
 #include "engine/alice/components/deprecated/SelectorBehavior.hpp"
-#include "engine/gems/state_machine/state_machine.hpp"
 #include "messages/math.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
+#include "packages/utils/EnumStateMachine.hpp"
 
 namespace isaac
 {
@@ -32,6 +34,10 @@ public:
     void tick() override;
     void stop() override;
 
+    // Blocks detected by the Pixy2 camera, we tick whenever a new frame was processed
+    ISAAC_PROTO_RX(Detections2Proto, blocks);
+    // Blobs detected on the CPU by BlobVision, used instead of blocks if detection_source is "blob"
+    ISAAC_PROTO_RX(Detections2Proto, blob_blocks);
     // The original goal
     ISAAC_PROTO_RX(Goal2Proto, original_goal);    
     // Feedback about our progress towards the goal
@@ -39,6 +45,8 @@ public:
 
     // The desired goal for the tank
     ISAAC_PROTO_TX(Goal2Proto, goal);
+    // Body speed commands, only published in servo mode while approaching the target
+    ISAAC_PROTO_TX(StateProto, command);
 
     // Parameter to get navigation mode behavior
     ISAAC_PARAM(std::string, navigation_mode,
@@ -52,12 +60,69 @@ public:
     // If the target's detected area is bigger than area_threshold * total area then the target is considered close enough
     ISAAC_PARAM(double, area_threshold, 0.1);
 
+    // Parameter to get the Pixy2 camera component which detects blocks and takes pictures
+    ISAAC_PARAM(std::string, pixy_vision, "pixy_vision/isaac.ev3.PixyVision");
+
+    // Where targets are detected: "pixy" uses the color connected components of the camera,
+    // "blob" the CPU blob detector
+    ISAAC_PARAM(std::string, detection_source, "pixy");
+
+    // Color signature of the target
+    ISAAC_PARAM(int, target_signature, 1);
+
+    // Parameter to select how the target is approached: "goal" publishes pose goals for the
+    // planner, "servo" turns every detection directly into a speed command
+    ISAAC_PARAM(std::string, control_mode, "goal");
+    // Navigation behavior which is restored if the servo loses the target
+    ISAAC_PARAM(std::string, navigate_behavior, "navigate");
+    // Angular speed in rad/s for a target at the border of the image
+    ISAAC_PARAM(double, servo_angular_gain, 0.6);
+    // Linear speed in m/s per multiple of the arrival distance the target is still away
+    ISAAC_PARAM(double, servo_linear_gain, 0.3);
+    // Linear speed in m/s while aligned with a target which is not close enough yet
+    ISAAC_PARAM(double, servo_min_linear_speed, 0.02);
+    // Speed and acceleration limits of the servo
+    ISAAC_PARAM(double, servo_max_linear_speed, 0.1);
+    ISAAC_PARAM(double, servo_max_angular_speed, 0.6);
+    ISAAC_PARAM(double, servo_max_linear_acceleration, 0.2);
+    ISAAC_PARAM(double, servo_max_angular_acceleration, 1.5);
+    // Time in seconds without detection after which the servo stops and navigation resumes
+    ISAAC_PARAM(double, lost_lock_timeout, 0.5);
+
     ISAAC_POSE2(world,robot);
 
 private:
-    // pixy2 interface
-    Pixy2 pixy;
-    uint32_t index_frame = 0;    
+    // A block of the target color, in pixels
+    struct Target {
+        double x;
+        double y;
+        double width;
+        double height;
+    };
+    // Reads the target from the latest detections. Returns false if it is not visible.
+    bool readTarget(Target& target);
+    // Detections of the selected source
+    alice::ProtoRx<Detections2Proto>& detections();
+    bool blob_source_ = false;
+
+    // pixy2 camera running on its own thread
+    PixyVision* pixy_vision_;
+    // latest target and whether it was visible in the latest frame
+    Target target_;
+    bool target_visible_ = false;
+    // picture count of the camera when we asked it to shoot
+    uint32_t pictures_before_shot_ = 0;
+
+    // Hands the base over to the servo
+    void startServo();
+    // Publishes the servo command for the latest detection
+    void tickServo();
+
+    bool servo_mode_ = false;
+    VisualServo servo_;
+
+    // duration of our ticks
+    TickLatency tick_latency_;
 
     navigation::GroupSelectorBehavior* navigation_mode_;
 
@@ -73,10 +138,19 @@ private:
     bool prev_translation = false;
     bool prev_rotation = false;
 
-    using State = std::string;
+    enum class State {
+        kInit,
+        kNavigation,
+        kDetected,
+        kShoot,
+        kExit,
+        kCount
+    };
+    // Name of a state for logging
+    static const char* ToString(State state);
     // Creates the state machine
     void createStateMachine();
-    state_machine::StateMachine<State> machine_;
+    EnumStateMachine<State> machine_;
     
 };
 } // namespace ev3
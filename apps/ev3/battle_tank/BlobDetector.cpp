@@ -0,0 +1,241 @@
+#include "BlobDetector.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+// Tests 8 samples against the chroma box and returns 0xFF for every match
+inline uint8x8_t matchNeon(uint8x8_t r, uint8x8_t g, uint8x8_t b, int16x8_t u_min, int16x8_t u_max,
+                           int16x8_t v_min, int16x8_t v_max, uint16x8_t brightness_min)
+{
+  // widening subtractions wrap around, reinterpreted as signed they are the exact differences
+  const int16x8_t u = vreinterpretq_s16_u16(vsubl_u8(r, g));
+  const int16x8_t v = vreinterpretq_s16_u16(vsubl_u8(b, g));
+  const uint16x8_t brightness = vaddq_u16(vaddl_u8(r, b), vshll_n_u8(g, 1));
+  uint16x8_t match = vandq_u16(vcgeq_s16(u, u_min), vcleq_s16(u, u_max));
+  match = vandq_u16(match, vandq_u16(vcgeq_s16(v, v_min), vcleq_s16(v, v_max)));
+  match = vandq_u16(match, vcgeq_u16(brightness, brightness_min));
+  return vmovn_u16(match);
+}
+#endif
+
+} // namespace
+
+void BlobDetector::encodeRows(const uint8_t *bayer, int quads_x, size_t stride, int row_begin, int row_end,
+                              std::vector<Run> &runs, uint8_t *mask) const
+{
+  const Parameters &p = parameters_;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const int16x8_t u_min = vdupq_n_s16(p.u_min);
+  const int16x8_t u_max = vdupq_n_s16(p.u_max);
+  const int16x8_t v_min = vdupq_n_s16(p.v_min);
+  const int16x8_t v_max = vdupq_n_s16(p.v_max);
+  const uint16x8_t brightness_min = vdupq_n_u16(std::max(0, p.brightness_min));
+#endif
+
+  for (int row = row_begin; row < row_end; row++)
+  {
+    // BGGR: blue and green on even rows, green and red on odd rows
+    const uint8_t *even = bayer + 2 * row * stride;
+    const uint8_t *odd = even + stride;
+    int qx = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; qx + 16 <= quads_x; qx += 16)
+    {
+      // de-interleave 16 quads: even = (b, g), odd = (g, r)
+      const uint8x16x2_t e = vld2q_u8(even + 2 * qx);
+      const uint8x16x2_t o = vld2q_u8(odd + 2 * qx);
+      const uint8x16_t g = vhaddq_u8(e.val[1], o.val[0]);
+      const uint8x8_t low = matchNeon(vget_low_u8(o.val[1]), vget_low_u8(g), vget_low_u8(e.val[0]),
+                                      u_min, u_max, v_min, v_max, brightness_min);
+      const uint8x8_t high = matchNeon(vget_high_u8(o.val[1]), vget_high_u8(g), vget_high_u8(e.val[0]),
+                                       u_min, u_max, v_min, v_max, brightness_min);
+      vst1q_u8(mask + qx, vcombine_u8(low, high));
+    }
+#endif
+    for (; qx < quads_x; qx++)
+    {
+      const int b = even[2 * qx];
+      const int g = (even[2 * qx + 1] + odd[2 * qx]) >> 1;
+      const int r = odd[2 * qx + 1];
+      const int u = r - g;
+      const int v = b - g;
+      mask[qx] = (u >= p.u_min && u <= p.u_max && v >= p.v_min && v <= p.v_max &&
+                  r + 2 * g + b >= p.brightness_min) ? 0xFF : 0;
+    }
+
+    // run-length encode the mask row
+    qx = 0;
+    while (qx < quads_x)
+    {
+      if (!mask[qx])
+      {
+        qx++;
+        continue;
+      }
+      const int begin = qx;
+      while (qx < quads_x && mask[qx])
+      {
+        qx++;
+      }
+      runs.push_back(Run{uint16_t(row), uint16_t(begin), uint16_t(qx)});
+    }
+  }
+}
+
+uint32_t BlobDetector::find(uint32_t index)
+{
+  while (parent_[index] != index)
+  {
+    // path halving
+    parent_[index] = parent_[parent_[index]];
+    index = parent_[index];
+  }
+  return index;
+}
+
+void BlobDetector::unite(uint32_t a, uint32_t b)
+{
+  a = find(a);
+  b = find(b);
+  if (a != b)
+  {
+    // the smaller index is the root, thus roots are always the first run of a blob
+    parent_[std::max(a, b)] = std::min(a, b);
+  }
+}
+
+void BlobDetector::detect(const uint8_t *bayer, int width, int height, size_t stride, std::vector<Blob> &blobs)
+{
+  blobs.clear();
+  const int quads_x = width / 2;
+  const int quads_y = height / 2;
+  if (quads_x == 0 || quads_y == 0)
+  {
+    return;
+  }
+
+  // threshold and encode bands of rows in parallel
+  size_t threads = parameters_.threads;
+  if (threads == 0)
+  {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  const size_t bands = std::min<size_t>(threads, quads_y);
+  band_runs_.resize(bands);
+  band_masks_.resize(bands);
+  if (!pool_ || pool_->threads() != threads)
+  {
+    pool_.reset(new WorkerPool(threads));
+  }
+  pool_->run(bands, [&](size_t band) {
+    band_runs_[band].clear();
+    band_masks_[band].resize(quads_x);
+    const int row_begin = quads_y * band / bands;
+    const int row_end = quads_y * (band + 1) / bands;
+    encodeRows(bayer, quads_x, stride, row_begin, row_end, band_runs_[band], band_masks_[band].data());
+  });
+
+  // bands are consecutive, thus concatenating them keeps the runs sorted by row
+  runs_.clear();
+  for (const auto &runs : band_runs_)
+  {
+    runs_.insert(runs_.end(), runs.begin(), runs.end());
+  }
+  row_start_.assign(quads_y + 1, 0);
+  for (const Run &run : runs_)
+  {
+    row_start_[run.row + 1]++;
+  }
+  std::partial_sum(row_start_.begin(), row_start_.end(), row_start_.begin());
+
+  // merge runs which touch a run of the previous row, diagonal neighbours included
+  parent_.resize(runs_.size());
+  std::iota(parent_.begin(), parent_.end(), 0);
+  for (int row = 1; row < quads_y; row++)
+  {
+    uint32_t i = row_start_[row - 1];
+    uint32_t j = row_start_[row];
+    const uint32_t i_end = row_start_[row];
+    const uint32_t j_end = row_start_[row + 1];
+    while (i < i_end && j < j_end)
+    {
+      const Run &above = runs_[i];
+      const Run &below = runs_[j];
+      if (above.begin <= below.end && below.begin <= above.end)
+      {
+        unite(i, j);
+      }
+      if (above.end < below.end)
+        i++;
+      else
+        j++;
+    }
+  }
+
+  // accumulate the statistics of every blob at its root run
+  accumulated_.resize(runs_.size());
+  sum_x_.assign(runs_.size(), 0);
+  sum_y_.assign(runs_.size(), 0);
+  for (uint32_t k = 0; k < runs_.size(); k++)
+  {
+    const Run &run = runs_[k];
+    const uint32_t root = find(k);
+    Blob &blob = accumulated_[root];
+    if (root == k)
+    {
+      blob = Blob{2 * run.begin, 2 * run.row, 2 * run.end - 1, 2 * run.row + 1, 0, 0.0, 0.0};
+    }
+    else
+    {
+      blob.x_min = std::min(blob.x_min, 2 * run.begin);
+      blob.x_max = std::max(blob.x_max, 2 * run.end - 1);
+      blob.y_max = 2 * run.row + 1;
+    }
+    const int length = run.end - run.begin;
+    // area counts quads for now, converted to pixels below
+    blob.area += length;
+    // twice the sum of the quad columns avoids fractions
+    sum_x_[root] += int64_t(run.begin + run.end - 1) * length;
+    sum_y_[root] += int64_t(run.row) * length;
+  }
+  for (uint32_t k = 0; k < runs_.size(); k++)
+  {
+    if (parent_[k] != k)
+    {
+      continue;
+    }
+    Blob blob = accumulated_[k];
+    const int quads = blob.area;
+    blob.area = 4 * quads;
+    if (blob.area < parameters_.min_area)
+    {
+      continue;
+    }
+    // every quad covers 2x2 pixels with its center at +0.5
+    blob.center_x = double(sum_x_[k]) / quads + 0.5;
+    blob.center_y = 2.0 * sum_y_[k] / quads + 0.5;
+    blobs.push_back(blob);
+  }
+  std::sort(blobs.begin(), blobs.end(), [](const Blob &a, const Blob &b) { return a.area > b.area; });
+  if (blobs.size() > parameters_.max_blobs)
+  {
+    blobs.resize(parameters_.max_blobs);
+  }
+}
+
+} // namespace ev3
+} // namespace isaac
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "packages/utils/ParallelFor.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// A connected region of pixels of the target color, in raw frame pixels
+struct Blob {
+  // Bounding box, max is inclusive
+  int x_min;
+  int y_min;
+  int x_max;
+  int y_max;
+  // Number of pixels
+  int area;
+  // Center of mass
+  double center_x;
+  double center_y;
+};
+
+// Finds blobs of one color in raw BGGR Bayer frames, similar to the color connected components of
+// the Pixy2 firmware but with all the resolution and as many blobs as we like.
+//
+// Every 2x2 Bayer quad is one sample. A sample matches if its chroma u = r - g and v = b - g is
+// inside the configured box and its brightness r + 2g + b is high enough; the chroma test is done
+// with NEON on ARM. Matching samples are run-length encoded per row, rows are processed in
+// parallel bands and the runs are merged into 8-connected blobs afterwards.
+class BlobDetector {
+ public:
+  struct Parameters {
+    // Chroma box of the target color, in [-255, 255]
+    int u_min = 40;
+    int u_max = 255;
+    int v_min = -255;
+    int v_max = 0;
+    // Minimum brightness r + 2g + b, in [0, 1020]
+    int brightness_min = 60;
+    // Blobs with fewer pixels are ignored
+    int min_area = 64;
+    // Maximum number of reported blobs, the biggest ones win
+    size_t max_blobs = 4;
+    // Number of threads, 0 uses all cores
+    size_t threads = 0;
+  };
+
+  BlobDetector() = default;
+  explicit BlobDetector(const Parameters& parameters) : parameters_(parameters) {}
+
+  void setParameters(const Parameters& parameters) { parameters_ = parameters; }
+  const Parameters& parameters() const { return parameters_; }
+
+  // Detects blobs in a raw frame with `stride` bytes per row. Blobs are sorted by decreasing area.
+  // Buffers and the worker threads are kept between calls, thus steady state detection neither
+  // allocates nor starts threads.
+  void detect(const uint8_t* bayer, int width, int height, size_t stride, std::vector<Blob>& blobs);
+
+ private:
+  // A horizontal run of matching samples in quad coordinates, end is exclusive
+  struct Run {
+    uint16_t row;
+    uint16_t begin;
+    uint16_t end;
+  };
+
+  // Thresholds and run-length encodes the quad rows [row_begin, row_end)
+  void encodeRows(const uint8_t* bayer, int quads_x, size_t stride, int row_begin, int row_end,
+                  std::vector<Run>& runs, uint8_t* mask) const;
+
+  // Union-find over run indices
+  uint32_t find(uint32_t index);
+  void unite(uint32_t a, uint32_t b);
+
+  Parameters parameters_;
+  // Started on the first detection and again when the thread count changes
+  std::unique_ptr<WorkerPool> pool_;
+  // Per band: runs and a scratch mask row
+  std::vector<std::vector<Run>> band_runs_;
+  std::vector<std::vector<uint8_t>> band_masks_;
+  // All runs in row order, index of the first run of every row and the union-find parents
+  std::vector<Run> runs_;
+  std::vector<uint32_t> row_start_;
+  std::vector<uint32_t> parent_;
+  std::vector<Blob> accumulated_;
+  std::vector<int64_t> sum_x_;
+  std::vector<int64_t> sum_y_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
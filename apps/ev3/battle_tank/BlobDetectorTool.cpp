@@ -0,0 +1,117 @@
+#include "BlobDetector.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using isaac::ev3::Blob;
+using isaac::ev3::BlobDetector;
+
+namespace
+{
+
+// Resolution of Pixy2 raw frames
+constexpr int kWidth = 316;
+constexpr int kHeight = 208;
+
+// Writes a BGGR pixel of the given color
+void setPixel(std::vector<uint8_t> &bayer, int width, int x, int y, uint8_t r, uint8_t g, uint8_t b)
+{
+  const bool even_row = y % 2 == 0;
+  const bool even_col = x % 2 == 0;
+  bayer[y * width + x] = even_row ? (even_col ? b : g) : (even_col ? g : r);
+}
+
+// A grey frame with a red disc and a smaller red square
+void synthesize(std::vector<uint8_t> &bayer, int width, int height)
+{
+  bayer.resize(width * height);
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      const double dx = x - 0.3 * width;
+      const double dy = y - 0.5 * height;
+      const bool disc = std::sqrt(dx * dx + dy * dy) < 30.0;
+      const bool square = x >= 220 && x < 240 && y >= 40 && y < 60;
+      if (disc || square)
+        setPixel(bayer, width, x, y, 200, 40, 30);
+      else
+        setPixel(bayer, width, x, y, 90, 100, 95);
+    }
+  }
+}
+
+// Reads a binary PGM holding a raw Bayer frame
+bool readPgm(const char *filename, std::vector<uint8_t> &bayer, int &width, int &height)
+{
+  FILE *file = std::fopen(filename, "rb");
+  if (!file)
+    return false;
+  int max_value = 0;
+  const bool ok = std::fscanf(file, "P5 %d %d %d", &width, &height, &max_value) == 3 && max_value == 255 &&
+                  std::fgetc(file) != EOF;
+  if (ok)
+  {
+    bayer.resize(width * height);
+  }
+  const bool read = ok && std::fread(bayer.data(), 1, bayer.size(), file) == bayer.size();
+  std::fclose(file);
+  return read;
+}
+
+} // namespace
+
+int main(int argc, const char *argv[])
+{
+  if (argc > 3)
+  {
+    std::cerr << "usage: " << argv[0] << " [RAW_FRAME.pgm] [THREADS]\n"
+              "Runs the blob detector on a raw BGGR frame stored as binary PGM, or on a synthetic "
+              "frame if none is given, and prints the blobs and the detection time." << std::endl;
+    return 1;
+  }
+  std::vector<uint8_t> bayer;
+  int width = kWidth;
+  int height = kHeight;
+  if (argc >= 2 && std::string(argv[1]) != "-")
+  {
+    if (!readPgm(argv[1], bayer, width, height))
+    {
+      std::cerr << "Could not read " << argv[1] << std::endl;
+      return 1;
+    }
+  }
+  else
+  {
+    synthesize(bayer, width, height);
+  }
+
+  BlobDetector::Parameters parameters;
+  parameters.threads = argc == 3 ? std::atoi(argv[2]) : 1;
+  BlobDetector detector(parameters);
+  std::vector<Blob> blobs;
+
+  // the first call allocates, thus it is not timed
+  detector.detect(bayer.data(), width, height, width, blobs);
+  constexpr int kIterations = 1000;
+  const auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; i++)
+  {
+    detector.detect(bayer.data(), width, height, width, blobs);
+  }
+  const auto end = std::chrono::steady_clock::now();
+  const double micros = std::chrono::duration<double, std::micro>(end - begin).count() / kIterations;
+
+  for (const Blob &blob : blobs)
+  {
+    std::printf("blob center (%.1f, %.1f) box [%d, %d]-[%d, %d] area %d\n", blob.center_x, blob.center_y,
+                blob.x_min, blob.y_min, blob.x_max, blob.y_max, blob.area);
+  }
+  std::printf("%dx%d frame, %zu threads: %.1f us per frame\n", width, height, parameters.threads, micros);
+  return 0;
+}
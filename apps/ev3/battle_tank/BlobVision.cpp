@@ -0,0 +1,68 @@
+#include "BlobVision.hpp"
+
+#include <algorithm>
+#include <string>
+
+#include "engine/core/image/image.hpp"
+#include "messages/image.hpp"
+#include "messages/math.hpp"
+
+namespace isaac
+{
+namespace ev3
+{
+
+void BlobVision::start()
+{
+  tickOnMessage(rx_raw_frame());
+}
+
+void BlobVision::tick()
+{
+  const auto timer = tick_latency_.measure();
+  tick_latency_.report(getTickTime(), [this](const char *tag, double value) { show(tag, value); });
+
+  // parameters may be changed in Sight at any time
+  BlobDetector::Parameters parameters;
+  parameters.u_min = get_u_min();
+  parameters.u_max = get_u_max();
+  parameters.v_min = get_v_min();
+  parameters.v_max = get_v_max();
+  parameters.brightness_min = get_brightness_min();
+  parameters.min_area = get_min_area();
+  parameters.max_blobs = std::max(0, get_max_blocks());
+  parameters.threads = std::max(0, get_threads());
+  detector_.setParameters(parameters);
+
+  ImageConstView1ub frame;
+  const bool ok = FromProto(rx_raw_frame().getProto(), rx_raw_frame().buffers(), frame);
+  if (!ok)
+  {
+    LOG_ERROR("Raw frames must be single channel 8-bit images");
+    return;
+  }
+  detector_.detect(frame.element_wise_begin(), frame.cols(), frame.rows(), frame.cols(), blobs_);
+
+  const std::string label = std::to_string(get_signature());
+  auto proto = tx_blocks().initProto();
+  auto predictions = proto.initPredictions(blobs_.size());
+  auto boxes = proto.initBoundingBoxes(blobs_.size());
+  for (size_t i = 0; i < blobs_.size(); i++)
+  {
+    const Blob &blob = blobs_[i];
+    predictions[i].setLabel(label);
+    predictions[i].setConfidence(1.0);
+    // blob bounds are inclusive pixel indices
+    ToProto(Vector2d(blob.y_min, blob.x_min), boxes[i].initMin());
+    ToProto(Vector2d(blob.y_max + 1, blob.x_max + 1), boxes[i].initMax());
+  }
+  tx_blocks().publish(rx_raw_frame().acqtime());
+}
+
+void BlobVision::stop()
+{
+  tick_latency_.dump(full_name());
+}
+
+} // namespace ev3
+} // namespace isaac
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "BlobDetector.hpp"
+
+#include "engine/alice/alice.hpp"
+#include "messages/messages.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// A codelet that detects blobs of one color in raw Pixy2 frames on the CPU. It is a drop-in
+// replacement for the color connected components of the camera firmware: detections are published
+// in the same format as the blocks of PixyVision, labelled with the configured signature.
+class BlobVision : public alice::Codelet {
+ public:
+  void start() override;
+  void tick() override;
+  void stop() override;
+
+  // Raw BGGR Bayer frames, for example from PixyVision
+  ISAAC_PROTO_RX(ImageProto, raw_frame);
+  // Blobs found in the latest frame, sorted by size and also published if nothing was found.
+  // Bounding boxes are in pixels as (row, column) and labels hold the signature.
+  ISAAC_PROTO_TX(Detections2Proto, blocks);
+
+  // Signature reported as label for all blobs
+  ISAAC_PARAM(int, signature, 1);
+  // Chroma box u = r - g and v = b - g of the target color, in [-255, 255]
+  ISAAC_PARAM(int, u_min, 40);
+  ISAAC_PARAM(int, u_max, 255);
+  ISAAC_PARAM(int, v_min, -255);
+  ISAAC_PARAM(int, v_max, 0);
+  // Minimum brightness r + 2g + b of a matching pixel, in [0, 1020]
+  ISAAC_PARAM(int, brightness_min, 60);
+  // Blobs with fewer pixels are ignored
+  ISAAC_PARAM(int, min_area, 64);
+  // Maximum number of blocks reported per frame
+  ISAAC_PARAM(int, max_blocks, 4);
+  // Number of threads used for thresholding, 0 uses all cores
+  ISAAC_PARAM(int, threads, 2);
+
+ private:
+  BlobDetector detector_;
+  std::vector<Blob> blobs_;
+  TickLatency tick_latency_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
+
+ISAAC_ALICE_REGISTER_CODELET(isaac::ev3::BlobVision);
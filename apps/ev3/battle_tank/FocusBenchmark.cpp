@@ -0,0 +1,109 @@
+// Measures the cost of scoring a raw Pixy2 frame with focusMeasure, which a burst pays for every
+// frame, against demosaicing the chosen one. Also checks the vectorized measure against a plain
+// implementation and that blurring a frame lowers its score.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "PixyImaging.hpp"
+#include "packages/utils/Benchmark.hpp"
+
+using namespace isaac::ev3;
+
+namespace
+{
+
+// Raw frame size of the Pixy2
+constexpr uint16_t kWidth = 316;
+constexpr uint16_t kHeight = 208;
+
+// Straightforward variance of the green Laplacian on even rows, see focusMeasure
+double focusMeasureReference(uint16_t width, uint16_t height, const uint8_t *bayer)
+{
+  double sum = 0.0, squares = 0.0;
+  size_t count = 0;
+  for (int y = 2; y + 1 < height; y += 2)
+  {
+    for (int x = 1; x + 1 < width; x += 2)
+    {
+      const int laplacian = 4 * bayer[y * width + x] - bayer[(y - 1) * width + x - 1] -
+                            bayer[(y - 1) * width + x + 1] - bayer[(y + 1) * width + x - 1] -
+                            bayer[(y + 1) * width + x + 1];
+      sum += laplacian;
+      squares += double(laplacian) * laplacian;
+      count++;
+    }
+  }
+  const double mean = sum / count;
+  return squares / count - mean * mean;
+}
+
+// A BGGR frame of a random checkerboard scene, blurred with a box of the given radius
+std::vector<uint8_t> makeFrame(int blur)
+{
+  std::mt19937 rng(3);
+  std::uniform_int_distribution<int> level(20, 235);
+  std::vector<int> tiles(64 * 64);
+  for (int &tile : tiles)
+    tile = level(rng);
+  std::vector<uint8_t> frame(kWidth * kHeight);
+  for (int y = 0; y < kHeight; y++)
+  {
+    for (int x = 0; x < kWidth; x++)
+    {
+      int total = 0, samples = 0;
+      for (int dy = -blur; dy <= blur; dy++)
+      {
+        for (int dx = -blur; dx <= blur; dx++)
+        {
+          total += tiles[((y + dy + 64) / 6 % 64) * 64 + (x + dx + 64) / 6 % 64];
+          samples++;
+        }
+      }
+      frame[y * kWidth + x] = uint8_t(total / samples);
+    }
+  }
+  return frame;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const std::string json_path = ParseBenchmarkOut(argc, argv);
+  int failures = 0;
+  double previous = 1e30;
+  for (int blur = 0; blur <= 3; blur++)
+  {
+    const std::vector<uint8_t> frame = makeFrame(blur);
+    const double score = focusMeasure(kWidth, kHeight, frame.data());
+    const double reference = focusMeasureReference(kWidth, kHeight, frame.data());
+    std::printf("blur radius %d: focus %.1f (reference %.1f)\n", blur, score, reference);
+    if (std::abs(score - reference) > 1e-6 * std::max(1.0, reference) || !(score < previous))
+    {
+      std::printf("  unexpected score\n");
+      failures++;
+    }
+    previous = score;
+  }
+
+  const std::vector<uint8_t> frame = makeFrame(0);
+  std::vector<uint8_t> rgb(size_t(kWidth) * kHeight * 3);
+  const double pixels = double(kWidth) * kHeight;
+  std::vector<BenchmarkResult> results;
+  results.push_back(RunBenchmark("focusMeasure", [&] { DoNotOptimize(focusMeasure(kWidth, kHeight, frame.data())); },
+                                 pixels));
+  results.push_back(RunBenchmark("focusMeasure reference",
+                                 [&] { DoNotOptimize(focusMeasureReference(kWidth, kHeight, frame.data())); }, pixels));
+  results.push_back(RunBenchmark("demosaic bilinear",
+                                 [&] {
+                                   demosaicFrame(DemosaicMode::kBilinear, kWidth, kHeight, frame.data(), rgb.data());
+                                   DoNotOptimize(rgb[0]);
+                                 },
+                                 pixels));
+  const bool written = ReportBenchmarks(results, argv[0], json_path);
+  return failures == 0 && written ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace isaac {
+namespace ev3 {
+
+// Memory layout of a demosaiced frame
+enum class PixelLayout {
+  // Interleaved 8-bit RGB triplets, 3 bytes per pixel
+  kRgb24,
+  // Three consecutive 8-bit planes: all red, then all green, then all blue samples
+  kPlanar
+};
+
+// A fixed set of equally sized, aligned frame buffers. All memory is allocated once when the pool
+// is created; acquiring and releasing a buffer afterwards never touches the heap. The pool must
+// outlive every buffer it handed out.
+class FrameBufferPool {
+ public:
+  // Default alignment of every buffer, large enough for cache lines and SIMD loads
+  static constexpr size_t kDefaultAlignment = 64;
+
+  // A buffer on loan from the pool. It is returned to the pool when destroyed or released.
+  class Buffer {
+   public:
+    Buffer() = default;
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+    Buffer(Buffer&& other) noexcept : pool_(other.pool_), data_(other.data_) {
+      other.pool_ = nullptr;
+      other.data_ = nullptr;
+    }
+    Buffer& operator=(Buffer&& other) noexcept {
+      if (this != &other) {
+        release();
+        pool_ = other.pool_;
+        data_ = other.data_;
+        other.pool_ = nullptr;
+        other.data_ = nullptr;
+      }
+      return *this;
+    }
+    ~Buffer() { release(); }
+
+    uint8_t* data() const { return data_; }
+    size_t size() const { return pool_ ? pool_->bufferSize() : 0; }
+    explicit operator bool() const { return data_ != nullptr; }
+
+    // Gives the buffer back to the pool early
+    void release() {
+      if (pool_) {
+        pool_->giveBack(data_);
+      }
+      pool_ = nullptr;
+      data_ = nullptr;
+    }
+
+   private:
+    friend class FrameBufferPool;
+    Buffer(FrameBufferPool* pool, uint8_t* data) : pool_(pool), data_(data) {}
+
+    FrameBufferPool* pool_ = nullptr;
+    uint8_t* data_ = nullptr;
+  };
+
+  // Creates `count` buffers with at least `buffer_size` bytes each
+  FrameBufferPool(size_t buffer_size, size_t count, size_t alignment = kDefaultAlignment)
+      : buffer_size_(buffer_size) {
+    const size_t stride = (buffer_size + alignment - 1) / alignment * alignment;
+    void* storage = nullptr;
+    if (posix_memalign(&storage, alignment, stride * count) != 0) {
+      throw std::bad_alloc();
+    }
+    storage_ = static_cast<uint8_t*>(storage);
+    free_.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+      free_.push_back(storage_ + i * stride);
+    }
+  }
+  FrameBufferPool(const FrameBufferPool&) = delete;
+  FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+  ~FrameBufferPool() { std::free(storage_); }
+
+  // Takes a buffer from the pool. Returns an empty buffer if all buffers are in use.
+  Buffer acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.empty()) {
+      return Buffer();
+    }
+    uint8_t* data = free_.back();
+    free_.pop_back();
+    return Buffer(this, data);
+  }
+
+  // Size in bytes of every buffer in the pool
+  size_t bufferSize() const { return buffer_size_; }
+
+  // Number of buffers which are currently not in use
+  size_t available() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return free_.size();
+  }
+
+ private:
+  void giveBack(uint8_t* data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(data);
+  }
+
+  size_t buffer_size_;
+  uint8_t* storage_ = nullptr;
+  // The free list never grows beyond its initial capacity, thus releasing never allocates.
+  std::vector<uint8_t*> free_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
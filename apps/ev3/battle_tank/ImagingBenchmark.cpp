@@ -0,0 +1,105 @@
+// Measures the imaging kernels of a picture: demosaicing a raw Pixy2 frame in every mode and
+// encoding it as PPM like PixyVision does, into memory so that the file system is not measured. The input is a fixed BGGR frame of a lit scene with
+// edges, gradients and sensor noise.
+//
+//   imaging_benchmark [--benchmark_out=PATH]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "PixyImaging.hpp"
+#include "packages/utils/Benchmark.hpp"
+
+using namespace isaac::ev3;
+
+namespace
+{
+
+// Raw frame size of the Pixy2
+constexpr uint16_t kWidth = 316;
+constexpr uint16_t kHeight = 208;
+
+// A BGGR frame of a scene with a bright wall, a dark floor, a red target and noise
+std::vector<uint8_t> makeFrame()
+{
+  std::mt19937 rng(7);
+  std::normal_distribution<float> noise(0.0f, 3.0f);
+  std::vector<uint8_t> frame(size_t(kWidth) * kHeight);
+  for (int y = 0; y < kHeight; y++)
+  {
+    for (int x = 0; x < kWidth; x++)
+    {
+      // color of the scene at this pixel
+      float r = 180.0f - 0.3f * y, g = 170.0f - 0.35f * y, b = 150.0f - 0.2f * y;
+      if (y > 130)
+      {
+        r = g = b = 60.0f + 0.1f * x;
+      }
+      if (std::hypot(x - 200.0f, y - 90.0f) < 25.0f)
+      {
+        r = 220.0f, g = 40.0f, b = 30.0f;
+      }
+      // BGGR: blue on even rows and columns, red on odd ones
+      const float value = (y % 2 == 0) ? (x % 2 == 0 ? b : g) : (x % 2 == 0 ? g : r);
+      frame[y * kWidth + x] = uint8_t(std::max(0.0f, std::min(255.0f, value + noise(rng))));
+    }
+  }
+  return frame;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const std::string json_path = ParseBenchmarkOut(argc, argv);
+  const std::vector<uint8_t> frame = makeFrame();
+  std::vector<uint8_t> image(size_t(kWidth) * kHeight * 3);
+  const double pixels = double(kWidth) * kHeight;
+
+  std::vector<BenchmarkResult> results;
+  results.push_back(RunBenchmark("demosaic bilinear rgb24",
+                                 [&] {
+                                   demosaic(kWidth, kHeight, frame.data(), image.data(), PixelLayout::kRgb24);
+                                   DoNotOptimize(image[0]);
+                                 },
+                                 pixels));
+  results.push_back(RunBenchmark("demosaic bilinear planar",
+                                 [&] {
+                                   demosaic(kWidth, kHeight, frame.data(), image.data(), PixelLayout::kPlanar);
+                                   DoNotOptimize(image[0]);
+                                 },
+                                 pixels));
+  results.push_back(RunBenchmark("demosaic half",
+                                 [&] {
+                                   demosaicHalf(kWidth, kHeight, frame.data(), image.data(), PixelLayout::kRgb24);
+                                   DoNotOptimize(image[0]);
+                                 },
+                                 pixels));
+  results.push_back(RunBenchmark("demosaic luma",
+                                 [&] {
+                                   demosaicLuma(kWidth, kHeight, frame.data(), image.data());
+                                   DoNotOptimize(image[0]);
+                                 },
+                                 pixels));
+
+  demosaic(kWidth, kHeight, frame.data(), image.data(), PixelLayout::kRgb24);
+  // a memory stream, thus this measures the header and the copy of the payload
+  std::vector<char> encoded(size_t(kWidth) * kHeight * 3 + 32);
+  FILE *sink = fmemopen(encoded.data(), encoded.size(), "wb");
+  if (sink == nullptr)
+  {
+    std::perror("fmemopen");
+    return 1;
+  }
+  results.push_back(RunBenchmark("writePPM to memory",
+                                 [&] {
+                                   std::rewind(sink);
+                                   DoNotOptimize(writePPM(sink, kWidth, kHeight, image.data()));
+                                 },
+                                 pixels));
+  std::fclose(sink);
+  return ReportBenchmarks(results, argv[0], json_path) ? 0 : 1;
+}
@@ -0,0 +1,313 @@
+#include "PixyImaging.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+
+// Eight 16-bit lanes, NEON on the Jetson and SSE on the host
+using Uint16x8 = uint16_t __attribute__((vector_size(16)));
+using Int16x8 = int16_t __attribute__((vector_size(16)));
+using Int32x4 = int32_t __attribute__((vector_size(16)));
+
+inline Uint16x8 load16(const uint8_t *bytes)
+{
+  Uint16x8 value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+// Interpolates the three color samples at (xx, yy) of a BGGR Bayer frame. Border pixels are
+// clamped to their inner neighbours by the caller.
+inline void bilinearAt(const uint8_t *pixel, uint16_t width, int32_t xx, int32_t yy,
+                       uint32_t &r, uint32_t &g, uint32_t &b)
+{
+  if (yy & 1)
+  {
+    if (xx & 1)
+    {
+      r = *pixel;
+      g = (*(pixel - 1) + *(pixel + 1) + *(pixel + width) + *(pixel - width)) >> 2;
+      b = (*(pixel - width - 1) + *(pixel - width + 1) + *(pixel + width - 1) + *(pixel + width + 1)) >> 2;
+    }
+    else
+    {
+      r = (*(pixel - 1) + *(pixel + 1)) >> 1;
+      g = *pixel;
+      b = (*(pixel - width) + *(pixel + width)) >> 1;
+    }
+  }
+  else
+  {
+    if (xx & 1)
+    {
+      r = (*(pixel - width) + *(pixel + width)) >> 1;
+      g = *pixel;
+      b = (*(pixel - 1) + *(pixel + 1)) >> 1;
+    }
+    else
+    {
+      r = (*(pixel - width - 1) + *(pixel - width + 1) + *(pixel + width - 1) + *(pixel + width + 1)) >> 2;
+      g = (*(pixel - 1) + *(pixel + 1) + *(pixel + width) + *(pixel - width)) >> 2;
+      b = *pixel;
+    }
+  }
+}
+
+// Walks all pixels of a Bayer frame in row-major order and hands the interpolated colors to `store`
+template <typename Store>
+void forEachBilinear(uint16_t width, uint16_t height, const uint8_t *bayerImage, Store store)
+{
+  uint32_t x, y, r, g, b;
+  int32_t xx, yy;
+  const uint8_t *pixel0;
+
+  for (y = 0; y < height; y++)
+  {
+    yy = y;
+    if (yy == 0)
+      yy++;
+    else if (yy == height - 1)
+      yy--;
+    pixel0 = bayerImage + yy * width;
+    for (x = 0; x < width; x++)
+    {
+      xx = x;
+      if (xx == 0)
+        xx++;
+      else if (xx == width - 1)
+        xx--;
+      bilinearAt(pixel0 + xx, width, xx, yy, r, g, b);
+      store(r, g, b);
+    }
+  }
+}
+
+int writeNetpbm(FILE *fp, const char *magic, uint16_t width, uint16_t height, size_t size, const uint8_t *image)
+{
+  if (fprintf(fp, "%s\n%d %d\n255\n", magic, width, height) < 0)
+    return -1;
+  return fwrite(image, 1, size, fp) == size ? 0 : -1;
+}
+
+int writeNetpbm(const char *magic, const char *extension, uint16_t width, uint16_t height,
+                size_t size, const uint8_t *image, const char *filename, uint32_t index)
+{
+  char fn[32];
+
+  snprintf(fn, sizeof(fn), "/tmp/%s%010d.%s", filename, index, extension);
+  FILE *fp = fopen(fn, "wb");
+  if (fp == NULL)
+    return -1;
+  const int result = writeNetpbm(fp, magic, width, height, size, image);
+  return fclose(fp) == 0 ? result : -1;
+}
+
+} // namespace
+
+bool parseDemosaicMode(const std::string &name, DemosaicMode &mode)
+{
+  if (name == "bilinear")
+  {
+    mode = DemosaicMode::kBilinear;
+  }
+  else if (name == "half")
+  {
+    mode = DemosaicMode::kHalfResolution;
+  }
+  else if (name == "luma")
+  {
+    mode = DemosaicMode::kLuma;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+FrameGeometry demosaicGeometry(DemosaicMode mode, uint16_t width, uint16_t height)
+{
+  switch (mode)
+  {
+  case DemosaicMode::kHalfResolution:
+    return FrameGeometry{uint16_t(width / 2), uint16_t(height / 2), 3};
+  case DemosaicMode::kLuma:
+    return FrameGeometry{width, height, 1};
+  case DemosaicMode::kBilinear:
+  default:
+    return FrameGeometry{width, height, 3};
+  }
+}
+
+void demosaicFrame(DemosaicMode mode, uint16_t width, uint16_t height, const uint8_t *bayerImage,
+                   uint8_t *image, PixelLayout layout)
+{
+  switch (mode)
+  {
+  case DemosaicMode::kHalfResolution:
+    demosaicHalf(width, height, bayerImage, image, layout);
+    break;
+  case DemosaicMode::kLuma:
+    demosaicLuma(width, height, bayerImage, image);
+    break;
+  case DemosaicMode::kBilinear:
+  default:
+    demosaic(width, height, bayerImage, image, layout);
+    break;
+  }
+}
+
+// functions from Pixy2 samples to get full raw frames
+// https://github.com/charmedlabs/pixy2/blob/master/src/host/libpixyusb2_examples/get_raw_frame/get_raw_frame.cpp
+void demosaic(uint16_t width, uint16_t height, const uint8_t *bayerImage, uint8_t *image, PixelLayout layout)
+{
+  if (layout == PixelLayout::kPlanar)
+  {
+    // planar output stores all red, then all green, then all blue samples
+    const size_t plane = size_t(width) * height;
+    forEachBilinear(width, height, bayerImage, [&image, plane](uint32_t r, uint32_t g, uint32_t b) {
+      image[0] = r;
+      image[plane] = g;
+      image[2 * plane] = b;
+      image++;
+    });
+  }
+  else
+  {
+    forEachBilinear(width, height, bayerImage, [&image](uint32_t r, uint32_t g, uint32_t b) {
+      image[0] = r;
+      image[1] = g;
+      image[2] = b;
+      image += 3;
+    });
+  }
+}
+
+void demosaicHalf(uint16_t width, uint16_t height, const uint8_t *bayerImage, uint8_t *image, PixelLayout layout)
+{
+  const uint16_t halfWidth = width / 2;
+  const uint16_t halfHeight = height / 2;
+  const size_t plane = size_t(halfWidth) * halfHeight;
+  const bool planar = layout == PixelLayout::kPlanar;
+
+  for (uint16_t y = 0; y < halfHeight; y++)
+  {
+    // BGGR: blue and green on even rows, green and red on odd rows
+    const uint8_t *even = bayerImage + 2 * y * width;
+    const uint8_t *odd = even + width;
+    for (uint16_t x = 0; x < halfWidth; x++, even += 2, odd += 2)
+    {
+      const uint8_t r = odd[1];
+      const uint8_t g = (even[1] + odd[0]) >> 1;
+      const uint8_t b = even[0];
+      if (planar)
+      {
+        image[0] = r;
+        image[plane] = g;
+        image[2 * plane] = b;
+        image++;
+      }
+      else
+      {
+        image[0] = r;
+        image[1] = g;
+        image[2] = b;
+        image += 3;
+      }
+    }
+  }
+}
+
+void demosaicLuma(uint16_t width, uint16_t height, const uint8_t *bayerImage, uint8_t *image)
+{
+  forEachBilinear(width, height, bayerImage, [&image](uint32_t r, uint32_t g, uint32_t b) {
+    // BT.601 luma in 8.8 fixed point, the weights sum up to 256
+    *image++ = (77 * r + 150 * g + 29 * b) >> 8;
+  });
+}
+
+double focusMeasure(uint16_t width, uint16_t height, const uint8_t *bayerImage)
+{
+  // Loaded as little-endian 16-bit lanes starting at an even column, the high byte of a lane is
+  // the green sample of an even row and the low byte the sample left of it, which is green on odd
+  // rows.
+  const Uint16x8 low = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+  int64_t sum = 0;
+  int64_t squares = 0;
+  int64_t count = 0;
+  for (int y = 2; y + 1 < height; y += 2)
+  {
+    const uint8_t *up = bayerImage + (y - 1) * width;
+    const uint8_t *row = bayerImage + y * width;
+    const uint8_t *down = bayerImage + (y + 1) * width;
+    // per row in 32 bits, a row of squares stays far below 2^31
+    Int32x4 row_sum = {0, 0, 0, 0};
+    Int32x4 row_squares = {0, 0, 0, 0};
+    int x = 0;
+    // green at x + 1 ... x + 15 with diagonals up to x + 16, the loads reach x + 17
+    for (; x + 18 <= width; x += 16)
+    {
+      const Int16x8 green = (Int16x8)(load16(row + x) >> 8);
+      const Int16x8 diagonals = (Int16x8)((load16(up + x) & low) + (load16(up + x + 2) & low) +
+                                          (load16(down + x) & low) + (load16(down + x + 2) & low));
+      const Int16x8 laplacian = (green << 2) - diagonals;
+      // sign-extend the even and odd 16-bit lanes into 32 bits
+      const Int32x4 pairs = (Int32x4)laplacian;
+      const Int32x4 a = (pairs << 16) >> 16;
+      const Int32x4 b = pairs >> 16;
+      row_sum += a + b;
+      row_squares += a * a + b * b;
+      count += 8;
+    }
+    for (; x + 2 < width; x += 2)
+    {
+      const int laplacian = 4 * row[x + 1] - up[x] - up[x + 2] - down[x] - down[x + 2];
+      row_sum[0] += laplacian;
+      row_squares[0] += laplacian * laplacian;
+      count++;
+    }
+    sum += row_sum[0] + row_sum[1] + row_sum[2] + row_sum[3];
+    squares += row_squares[0] + row_squares[1] + row_squares[2] + row_squares[3];
+  }
+  if (count == 0)
+  {
+    return 0.0;
+  }
+  const double mean = double(sum) / count;
+  return double(squares) / count - mean * mean;
+}
+
+int writePPM(uint16_t width, uint16_t height, const uint8_t *image, const char *filename, uint32_t index)
+{
+  // the image is already packed RGB24, which is exactly the PPM payload
+  return writeNetpbm("P6", "ppm", width, height, size_t(width) * height * 3, image, filename, index);
+}
+
+int writePPM(FILE *file, uint16_t width, uint16_t height, const uint8_t *image)
+{
+  return writeNetpbm(file, "P6", width, height, size_t(width) * height * 3, image);
+}
+
+int writePGM(uint16_t width, uint16_t height, const uint8_t *image, const char *filename, uint32_t index)
+{
+  return writeNetpbm("P5", "pgm", width, height, size_t(width) * height, image, filename, index);
+}
+
+int writeFrame(const FrameGeometry &geometry, const uint8_t *image, const char *filename, uint32_t index)
+{
+  if (geometry.channels == 1)
+  {
+    return writePGM(geometry.width, geometry.height, image, filename, index);
+  }
+  return writePPM(geometry.width, geometry.height, image, filename, index);
+}
+
+} // namespace ev3
+} // namespace isaac
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "FrameBufferPool.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// How a raw Pixy2 Bayer frame is converted into an image
+enum class DemosaicMode {
+  // Full resolution RGB, every missing color sample is interpolated from its neighbours
+  kBilinear,
+  // Half resolution RGB, every 2x2 BGGR quad becomes a single pixel
+  kHalfResolution,
+  // Full resolution single channel luma
+  kLuma
+};
+
+// Parses "bilinear", "half" or "luma". Returns false for unknown names and leaves `mode` untouched.
+bool parseDemosaicMode(const std::string& name, DemosaicMode& mode);
+
+// Dimensions of a demosaiced frame
+struct FrameGeometry {
+  uint16_t width;
+  uint16_t height;
+  // 3 for RGB and 1 for luma
+  uint8_t channels;
+
+  size_t bytes() const { return size_t(width) * height * channels; }
+};
+
+// Computes the output geometry of `demosaicFrame` for a raw frame of the given size
+FrameGeometry demosaicGeometry(DemosaicMode mode, uint16_t width, uint16_t height);
+
+// Converts a BGGR Bayer frame using the given mode. `image` must hold at least
+// `demosaicGeometry(mode, width, height).bytes()` bytes. The layout is ignored for luma.
+void demosaicFrame(DemosaicMode mode, uint16_t width, uint16_t height, const uint8_t* bayerImage,
+                   uint8_t* image, PixelLayout layout = PixelLayout::kRgb24);
+
+// Full resolution bilinear demosaic of a BGGR Bayer frame
+void demosaic(uint16_t width, uint16_t height, const uint8_t* bayerImage, uint8_t* image,
+              PixelLayout layout);
+
+// Half resolution demosaic which collapses each BGGR quad into one pixel. The output is
+// (width / 2) x (height / 2) pixels.
+void demosaicHalf(uint16_t width, uint16_t height, const uint8_t* bayerImage, uint8_t* image,
+                  PixelLayout layout);
+
+// Full resolution luma (BT.601 weights) of a BGGR Bayer frame, 1 byte per pixel
+void demosaicLuma(uint16_t width, uint16_t height, const uint8_t* bayerImage, uint8_t* image);
+
+// Sharpness of a BGGR Bayer frame: the variance of the Laplacian of its green samples. Green
+// samples of a Bayer frame form a checkerboard whose closest neighbours are the diagonal ones, thus
+// the Laplacian of a green sample is 4x itself minus its four diagonal neighbours. It is computed
+// for the green samples on even rows, half of them, eight at a time with vector instructions.
+// Blurred frames, e.g. taken while the tank still rocks, score lower.
+double focusMeasure(uint16_t width, uint16_t height, const uint8_t* bayerImage);
+
+// Writes a packed RGB24 frame to /tmp/<filename><index>.ppm. Returns -1 on failure.
+int writePPM(uint16_t width, uint16_t height, const uint8_t* image, const char* filename,
+             uint32_t index);
+
+// Writes a packed RGB24 frame as PPM to an open file. Returns -1 on failure.
+int writePPM(FILE* file, uint16_t width, uint16_t height, const uint8_t* image);
+
+// Writes a single channel frame to /tmp/<filename><index>.pgm. Returns -1 on failure.
+int writePGM(uint16_t width, uint16_t height, const uint8_t* image, const char* filename,
+             uint32_t index);
+
+// Writes a frame produced by `demosaicFrame` with the RGB24 layout as PPM or PGM
+int writeFrame(const FrameGeometry& geometry, const uint8_t* image, const char* filename,
+               uint32_t index);
+
+}  // namespace ev3
+}  // namespace isaac
@@ -1,140 +1,225 @@
 #include "PixyVision.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <thread>
+
+#include "engine/core/image/image.hpp"
 #include "engine/core/logger.hpp"
+#include "messages/camera.hpp"
+#include "messages/image.hpp"
+#include "messages/math.hpp"
 
 namespace isaac
 {
 namespace ev3
 {
 
-int writePPM(uint16_t width, uint16_t height, uint32_t *image, const char *filename, uint32_t index)
+namespace
+{
+// Number of frame buffers kept ready for pictures
+constexpr size_t kFramePoolSize = 2;
+// Pause after a failed getBlocks to not spin on a disconnected camera
+constexpr auto kErrorBackoff = std::chrono::milliseconds(20);
+} // namespace
+
+void PixyVision::start()
 {
-  int i, j;
-  char fn[32];
-
-  sprintf(fn, "/tmp/%s%010d.ppm", filename, index);
-  FILE *fp = fopen(fn, "wb");
-  if (fp == NULL)
-    return -1;
-  fprintf(fp, "P6\n%d %d\n255\n", width, height);
-  for (j = 0; j < height; j++)
+  bool known_mode = parseDemosaicMode(get_demosaic_mode(), demosaic_mode_);
+  ASSERT(known_mode, "Unknown demosaic mode '%s'", get_demosaic_mode().c_str());
+  known_mode = parseDemosaicMode(get_picture_demosaic_mode(), picture_demosaic_mode_);
+  ASSERT(known_mode, "Unknown demosaic mode '%s'", get_picture_demosaic_mode().c_str());
+  // allocate all picture memory once, taking a picture only borrows from the pool
+  frame_pool_.reset(new FrameBufferPool(PIXY2_RAW_FRAME_WIDTH * PIXY2_RAW_FRAME_HEIGHT * 3, kFramePoolSize));
+  const int burst_frames = std::max(1, get_burst_frames());
+  burst_ring_.resize(size_t(burst_frames) * PIXY2_RAW_FRAME_WIDTH * PIXY2_RAW_FRAME_HEIGHT);
+  burst_scores_.resize(burst_frames);
+
+  int result = pixy.init();
+  if (result < 0)
   {
-    for (i = 0; i < width; i++)
-      fwrite((char *)(image + j * width + i), 1, 3, fp);
+    LOG_ERROR("Error");
+    LOG_ERROR("pixy.init() returned %d", result);
+    return;
   }
-  fclose(fp);
-  return 0;
+  LOG_INFO("Initialised Pixy2 Camera");
+  frame_width_ = pixy.frameWidth;
+  frame_height_ = pixy.frameHeight;
+
+  // getBlocks waits for the next camera frame, thus we tick as fast as the camera delivers frames
+  tickBlocking();
 }
 
-void demosaic(uint16_t width, uint16_t height, const uint8_t *bayerImage, uint32_t *image)
+void PixyVision::tick()
 {
-  uint32_t x, y, r, g, b;
-  int32_t xx, yy;
-  uint8_t *pixel0, *pixel;
+  // includes waiting for the next camera frame
+  const auto timer = tick_latency_.measure();
+  tick_latency_.report(getTickTime(), [this](const char *tag, double value) { show(tag, value); });
 
-  for (y = 0; y < height; y++)
+  if (burst_count_ < 0 && picture_requested_.exchange(false))
   {
-    yy = y;
-    if (yy == 0)
-      yy++;
-    else if (yy == height - 1)
-      yy--;
-    pixel0 = (uint8_t *)bayerImage + yy * width;
-    for (x = 0; x < width; x++, image++)
+    burst_count_ = 0;
+  }
+  if (burst_count_ >= 0)
+  {
+    // one frame per tick, the tick waits for the camera to deliver the next one
+    captureBurstFrame();
+    if (burst_count_ == int(burst_scores_.size()))
     {
-      xx = x;
-      if (xx == 0)
-        xx++;
-      else if (xx == width - 1)
-        xx--;
-      pixel = pixel0 + xx;
-      if (yy & 1)
-      {
-        if (xx & 1)
-        {
-          r = *pixel;
-          g = (*(pixel - 1) + *(pixel + 1) + *(pixel + width) + *(pixel - width)) >> 2;
-          b = (*(pixel - width - 1) + *(pixel - width + 1) + *(pixel + width - 1) + *(pixel + width + 1)) >> 2;
-        }
-        else
-        {
-          r = (*(pixel - 1) + *(pixel + 1)) >> 1;
-          g = *pixel;
-          b = (*(pixel - width) + *(pixel + width)) >> 1;
-        }
-      }
-      else
-      {
-        if (xx & 1)
-        {
-          r = (*(pixel - width) + *(pixel + width)) >> 1;
-          g = *pixel;
-          b = (*(pixel - 1) + *(pixel + 1)) >> 1;
-        }
-        else
-        {
-          r = (*(pixel - width - 1) + *(pixel - width + 1) + *(pixel + width - 1) + *(pixel + width + 1)) >> 2;
-          g = (*(pixel - 1) + *(pixel + 1) + *(pixel + width) + *(pixel - width)) >> 2;
-          b = *pixel;
-        }
-      }
-      *image = (b << 16) | (g << 8) | r;
+      savePicture();
+      burst_count_ = -1;
+      pictures_done_++;
     }
   }
-}
+  const bool frame_due = get_publish_frames() && getTickTime() >= next_frame_time_;
+  const bool raw_frame_due = get_publish_raw_frames() && getTickTime() >= next_raw_frame_time_;
+  if (frame_due || raw_frame_due)
+  {
+    uint8_t *bayerFrame;
+    pixy.m_link.stop();
+    // grab raw frame, BGGR Bayer format, 1 byte per pixel
+    pixy.m_link.getRawFrame(&bayerFrame);
+    const int64_t acqtime = node()->clock()->timestamp();
+    if (frame_due)
+    {
+      next_frame_time_ = getTickTime() + 1.0 / get_frame_rate();
+      publishFrame(bayerFrame, acqtime);
+    }
+    if (raw_frame_due)
+    {
+      next_raw_frame_time_ = getTickTime() + 1.0 / get_raw_frame_rate();
+      publishRawFrame(bayerFrame, acqtime);
+    }
+    pixy.m_link.resume();
+  }
 
-void PixyVision::start()
-{
-  tickPeriodically();
-  int result = pixy.init();
+  // blocks until the camera has processed a new frame
+  const int8_t result = pixy.ccc.getBlocks(true, get_signatures(), get_max_blocks());
   if (result < 0)
   {
-    LOG_ERROR("Error");
-    LOG_ERROR("pixy.init() returned %d", result);
+    if (errors_in_a_row_++ == 0)
+    {
+      LOG_ERROR("getBlocks() returned %d", result);
+    }
+    std::this_thread::sleep_for(kErrorBackoff);
+    return;
   }
-  else
-  {
-    LOG_INFO("Initialised Pixy2 Camera");
-  }  
+  errors_in_a_row_ = 0;
+  publishBlocks(node()->clock()->timestamp());
 }
 
-void PixyVision::tick()
+void PixyVision::stop()
+{
+  tick_latency_.dump(full_name());
+}
+
+void PixyVision::publishBlocks(int64_t acqtime)
 {
-  
-  // {
-  //   pixy.m_link.stop();
-  //   int result;
-  //   uint8_t *bayerFrame;
-  //   uint32_t rgbFrame[PIXY2_RAW_FRAME_WIDTH * PIXY2_RAW_FRAME_HEIGHT];
-  //   // grab raw frame, BGGR Bayer format, 1 byte per pixel
-  //   pixy.m_link.getRawFrame(&bayerFrame);
-  //   // convert Bayer frame to RGB frame
-  //   demosaic(PIXY2_RAW_FRAME_WIDTH, PIXY2_RAW_FRAME_HEIGHT, bayerFrame, rgbFrame);
-  //   // write frame to PPM file for verification
-  //   result = writePPM(PIXY2_RAW_FRAME_WIDTH, PIXY2_RAW_FRAME_HEIGHT, rgbFrame, "out", ++index_frame);
-  //   if(result < 0) {
-  //     LOG_ERROR("Can't write PPM file");
-  //   }
-  //   pixy.m_link.resume();
-  // }
+  const int count = pixy.ccc.numBlocks;
+  auto proto = tx_blocks().initProto();
+  auto predictions = proto.initPredictions(count);
+  auto boxes = proto.initBoundingBoxes(count);
+  for (int i = 0; i < count; i++)
   {
-    pixy.ccc.getBlocks();
+    const Block &block = pixy.ccc.blocks[i];
+    predictions[i].setLabel(std::to_string(block.m_signature));
+    // the camera does not report a confidence for color blocks
+    predictions[i].setConfidence(1.0);
+    // m_x and m_y are the center of the block
+    const double top = block.m_y - 0.5 * block.m_height;
+    const double left = block.m_x - 0.5 * block.m_width;
+    ToProto(Vector2d(top, left), boxes[i].initMin());
+    ToProto(Vector2d(top + block.m_height, left + block.m_width), boxes[i].initMax());
+  }
+  tx_blocks().publish(acqtime);
+}
 
-    if (pixy.ccc.numBlocks)
-    {
-      LOG_INFO("Detected %d block(s)", pixy.ccc.numBlocks);
-      for (int block_index = 0; block_index < pixy.ccc.numBlocks; ++block_index)
-      {
-        LOG_INFO("Block %d", block_index + 1);
-        pixy.ccc.blocks[block_index].print();
-      }
-    }
+void PixyVision::captureBurstFrame()
+{
+  const size_t frame_size = PIXY2_RAW_FRAME_WIDTH * PIXY2_RAW_FRAME_HEIGHT;
+  uint8_t *slot = burst_ring_.data() + burst_count_ * frame_size;
+  uint8_t *bayerFrame;
+  pixy.m_link.stop();
+  // grab raw frame, BGGR Bayer format, 1 byte per pixel
+  pixy.m_link.getRawFrame(&bayerFrame);
+  std::copy(bayerFrame, bayerFrame + frame_size, slot);
+  pixy.m_link.resume();
+
+  const auto begin = std::chrono::steady_clock::now();
+  burst_scores_[burst_count_] = focusMeasure(PIXY2_RAW_FRAME_WIDTH, PIXY2_RAW_FRAME_HEIGHT, slot);
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  show("burst.score_ms", 1000.0 * elapsed);
+  show("burst.focus", burst_scores_[burst_count_]);
+  burst_count_++;
+}
+
+void PixyVision::savePicture()
+{
+  FrameBufferPool::Buffer rgbFrame = frame_pool_->acquire();
+  if (!rgbFrame)
+  {
+    LOG_ERROR("No free frame buffer, skipping picture");
+    return;
+  }
+  const auto best = std::max_element(burst_scores_.begin(), burst_scores_.end());
+  const size_t index = best - burst_scores_.begin();
+  LOG_INFO("Picture %u is frame %zu of %zu with focus %.1f (worst %.1f)", index_frame + 1, index + 1,
+           burst_scores_.size(), *best, *std::min_element(burst_scores_.begin(), burst_scores_.end()));
+  // only the chosen frame is demosaiced, to RGB24 or luma
+  const uint8_t *bayerFrame = burst_ring_.data() + index * PIXY2_RAW_FRAME_WIDTH * PIXY2_RAW_FRAME_HEIGHT;
+  demosaicFrame(picture_demosaic_mode_, PIXY2_RAW_FRAME_WIDTH, PIXY2_RAW_FRAME_HEIGHT, bayerFrame, rgbFrame.data());
+  // write frame to PPM/PGM file for verification
+  const int result = writeFrame(demosaicGeometry(picture_demosaic_mode_, PIXY2_RAW_FRAME_WIDTH, PIXY2_RAW_FRAME_HEIGHT),
+                                rgbFrame.data(), "out", ++index_frame);
+  if (result < 0)
+  {
+    LOG_ERROR("Can't write frame file");
   }
 }
 
-void PixyVision::stop()
+void PixyVision::publishRawFrame(const uint8_t *bayerFrame, int64_t acqtime)
 {
- 
+  // the USB buffer is reused by the next grab, thus the message needs its own copy
+  Image1ub image(PIXY2_RAW_FRAME_HEIGHT, PIXY2_RAW_FRAME_WIDTH);
+  std::copy(bayerFrame, bayerFrame + PIXY2_RAW_FRAME_WIDTH * PIXY2_RAW_FRAME_HEIGHT, image.element_wise_begin());
+  ToProto(std::move(image), tx_raw_frame().initProto(), tx_raw_frame().buffers());
+  tx_raw_frame().publish(acqtime);
+}
+
+void PixyVision::publishFrame(const uint8_t *bayerFrame, int64_t acqtime)
+{
+  const FrameGeometry geometry = demosaicGeometry(demosaic_mode_, PIXY2_RAW_FRAME_WIDTH, PIXY2_RAW_FRAME_HEIGHT);
+  auto camera = tx_frame().initProto();
+
+  // demosaic straight into the image which is handed over to the message without another copy
+  if (geometry.channels == 1)
+  {
+    Image1ub image(geometry.height, geometry.width);
+    demosaicFrame(demosaic_mode_, PIXY2_RAW_FRAME_WIDTH, PIXY2_RAW_FRAME_HEIGHT, bayerFrame,
+                  image.element_wise_begin());
+    camera.setColorSpace(ColorCameraProto::ColorSpace::GREYSCALE);
+    ToProto(std::move(image), camera.initImage(), tx_frame().buffers());
+  }
+  else
+  {
+    Image3ub image(geometry.height, geometry.width);
+    demosaicFrame(demosaic_mode_, PIXY2_RAW_FRAME_WIDTH, PIXY2_RAW_FRAME_HEIGHT, bayerFrame,
+                  image.element_wise_begin());
+    camera.setColorSpace(ColorCameraProto::ColorSpace::RGB);
+    ToProto(std::move(image), camera.initImage(), tx_frame().buffers());
+  }
+
+  // ideal pinhole derived from the horizontal field of view of the lens
+  const double focal = 0.5 * geometry.width / std::tan(0.5 * get_horizontal_fov());
+  auto pinhole = camera.initPinhole();
+  pinhole.setRows(geometry.height);
+  pinhole.setCols(geometry.width);
+  ToProto(Vector2d(focal, focal), pinhole.initFocal());
+  ToProto(Vector2d(0.5 * geometry.height, 0.5 * geometry.width), pinhole.initCenter());
+
+  tx_frame().publish(acqtime);
 }
 
 } // namespace ev3
@@ -1,26 +1,106 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <string>
+#include <vector>
 #include <signal.h>
 
 #include "libpixyusb2.h"
 
+#include "PixyImaging.hpp"
+
 #include "engine/alice/alice.hpp"
 #include "messages/messages.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
 
 namespace isaac {
 namespace ev3 {
 
-// A codelet that uses a Pixy2 Camera for detecting objects
+// A codelet that owns the Pixy2 Camera. It ticks on its own thread, waits for every new camera
+// frame and publishes the color connected components found by the camera as detections.
+// Pictures and raw frames are grabbed on the same thread, so nothing else talks to the camera.
 class PixyVision : public alice::Codelet {
  public:
   void start() override;
   void tick() override;
   void stop() override;
 
+  // Blocks detected by the camera in the latest frame, also published if nothing was detected.
+  // Bounding boxes are in pixels as (row, column) and labels hold the color signature.
+  ISAAC_PROTO_TX(Detections2Proto, blocks);
+
+  // Camera frames, only published if publish_frames is enabled
+  ISAAC_PROTO_TX(ColorCameraProto, frame);
+  // Raw BGGR Bayer frames, only published if publish_raw_frames is enabled
+  ISAAC_PROTO_TX(ImageProto, raw_frame);
+
+  // Bit mask of the color signatures which are reported
+  ISAAC_PARAM(int, signatures, CCC_SIG_ALL);
+  // Maximum number of blocks reported per frame
+  ISAAC_PARAM(int, max_blocks, 4);
+  // If enabled raw frames are grabbed, demosaiced and published on the frame channel
+  ISAAC_PARAM(bool, publish_frames, false);
+  // Maximum rate in Hz at which frames are published
+  ISAAC_PARAM(double, frame_rate, 2.0);
+  // If enabled raw frames are published on the raw_frame channel, e.g. for the BlobVision detector
+  ISAAC_PARAM(bool, publish_raw_frames, false);
+  // Maximum rate in Hz at which raw frames are published
+  ISAAC_PARAM(double, raw_frame_rate, 30.0);
+  // How frames are demosaiced: "bilinear", "half" or "luma"
+  ISAAC_PARAM(std::string, demosaic_mode, "half");
+  // How pictures written to disk are demosaiced
+  ISAAC_PARAM(std::string, picture_demosaic_mode, "bilinear");
+  // Number of consecutive raw frames grabbed for a picture. The sharpest one by focusMeasure is
+  // demosaiced and written, thus a picture taken while the tank still rocks is not blurred.
+  ISAAC_PARAM(int, burst_frames, 5);
+  // Horizontal field of view of the Pixy2 lens in radians, used for the pinhole model
+  ISAAC_PARAM(double, horizontal_fov, 1.047);
+
+  // Asks the camera thread to write a picture to disk, the sharpest of the next burst_frames
+  // frames. Thread-safe.
+  void requestPicture() { picture_requested_ = true; }
+  // Number of picture requests handled so far, successful or not. Thread-safe.
+  uint32_t picturesDone() const { return pictures_done_; }
+
+  // Resolution of the frames the blocks are detected in
+  int frameWidth() const { return frame_width_; }
+  int frameHeight() const { return frame_height_; }
+
  private:
+  // Publishes a raw frame as a camera image
+  void publishFrame(const uint8_t* bayerFrame, int64_t acqtime);
+  // Publishes a copy of a raw frame
+  void publishRawFrame(const uint8_t* bayerFrame, int64_t acqtime);
+  // Grabs the next raw frame of a burst into the ring and scores it
+  void captureBurstFrame();
+  // Demosaics the sharpest frame of the burst and writes it to disk
+  void savePicture();
+  // Publishes the blocks of the latest frame
+  void publishBlocks(int64_t acqtime);
+
   Pixy2 pixy;
   uint32_t index_frame = 0;
+  DemosaicMode demosaic_mode_ = DemosaicMode::kHalfResolution;
+  DemosaicMode picture_demosaic_mode_ = DemosaicMode::kBilinear;
+  // preallocated frames for pictures
+  std::unique_ptr<FrameBufferPool> frame_pool_;
+  // preallocated raw frames of a burst and their focus scores
+  std::vector<uint8_t> burst_ring_;
+  std::vector<double> burst_scores_;
+  // frames grabbed of the current burst, -1 if there is none
+  int burst_count_ = -1;
+  // Tick times at which the next frames are due
+  double next_frame_time_ = 0.0;
+  double next_raw_frame_time_ = 0.0;
+  // Number of getBlocks errors in a row, used to throttle error reports
+  int errors_in_a_row_ = 0;
+  TickLatency tick_latency_;
+
+  std::atomic<bool> picture_requested_{false};
+  std::atomic<uint32_t> pictures_done_{0};
+  std::atomic<int> frame_width_{0};
+  std::atomic<int> frame_height_{0};
 };
 } // namespace ev3
 } // namespace isaac
@@ -0,0 +1,98 @@
+// Compares the tick overhead of the string keyed state machine of the Isaac SDK with
+// EnumStateMachine, using the states and transitions of BattleTank with trivial actions.
+
+#include <string>
+#include <vector>
+
+#include "engine/gems/state_machine/state_machine.hpp"
+#include "packages/utils/Benchmark.hpp"
+#include "packages/utils/EnumStateMachine.hpp"
+
+using namespace isaac::ev3;
+
+namespace
+{
+
+enum class State
+{
+  kInit,
+  kNavigation,
+  kDetected,
+  kShoot,
+  kExit,
+  kCount
+};
+
+// Inputs of the transition conditions, toggled by the benchmarks
+struct Inputs
+{
+  bool pose_available = true;
+  bool target_visible = false;
+  bool shoot_target = false;
+  bool servo_mode = false;
+  bool locked = true;
+  bool picture_done = false;
+  int counter = 0;
+};
+
+template <typename Machine, typename Key>
+void build(Machine &machine, Inputs &in, Key init, Key navigation, Key detected, Key shoot, Key exit)
+{
+  Inputs *inputs = &in;
+  machine.addState(init, [] {}, [] {}, [] {});
+  machine.addTransition(init, navigation, [inputs] { return inputs->pose_available; }, [] {});
+  machine.addState(navigation, [] {}, [inputs] { inputs->counter++; }, [] {});
+  machine.addTransition(navigation, detected, [inputs] { return inputs->target_visible; }, [] {});
+  machine.addState(detected, [] {}, [inputs] { inputs->counter++; }, [] {});
+  machine.addTransition(detected, shoot, [inputs] { return inputs->shoot_target; }, [] {});
+  machine.addTransition(detected, navigation, [inputs] { return inputs->servo_mode && !inputs->locked; }, [] {});
+  machine.addState(shoot, [] {}, [] {}, [] {});
+  machine.addTransition(shoot, navigation, [inputs] { return inputs->picture_done; }, [] {});
+  machine.addState(exit, [] {}, [] {}, [] {});
+}
+
+template <typename Machine, typename Key>
+void run(const std::string &name, Key init, Key navigation, Key detected, Key shoot, Key exit,
+         std::vector<BenchmarkResult> &results)
+{
+  {
+    // staying in a state, the common case while driving around
+    Machine machine;
+    Inputs inputs;
+    build(machine, inputs, init, navigation, detected, shoot, exit);
+    machine.start(init);
+    machine.tick();
+    results.push_back(RunBenchmark(name + "/stay", [&] { machine.tick(); }));
+    DoNotOptimize(inputs.counter);
+    machine.stop();
+  }
+  {
+    // bouncing between navigation and detected on every tick
+    Machine machine;
+    Inputs inputs;
+    inputs.servo_mode = true;
+    build(machine, inputs, init, navigation, detected, shoot, exit);
+    machine.start(init);
+    machine.tick();
+    results.push_back(RunBenchmark(name + "/transition", [&] {
+      inputs.target_visible = !inputs.target_visible;
+      inputs.locked = inputs.target_visible;
+      machine.tick();
+    }));
+    DoNotOptimize(inputs.counter);
+    machine.stop();
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const std::string json_path = ParseBenchmarkOut(argc, argv);
+  std::vector<BenchmarkResult> results;
+  run<isaac::state_machine::StateMachine<std::string>, std::string>(
+      "StateMachine<std::string>", "kInit", "kStateNavigation", "kStateDetected", "kStateShoot", "kExit", results);
+  run<EnumStateMachine<State>, State>("EnumStateMachine", State::kInit, State::kNavigation, State::kDetected,
+                                      State::kShoot, State::kExit, results);
+  return ReportBenchmarks(results, argv[0], json_path) ? 0 : 1;
+}
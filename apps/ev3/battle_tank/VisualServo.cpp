@@ -0,0 +1,93 @@
+#include "VisualServo.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+
+double clamp(double value, double limit)
+{
+  return std::max(-limit, std::min(limit, value));
+}
+
+} // namespace
+
+void VisualServo::reset()
+{
+  command_ = Command();
+  has_time_ = false;
+  locked_ = false;
+  arrived_ = false;
+}
+
+VisualServo::Command VisualServo::update(double time, double offset, double area)
+{
+  locked_ = true;
+  last_seen_ = time;
+
+  const bool aligned = std::abs(offset) <= parameters_.center_threshold;
+  arrived_ = aligned && area >= parameters_.area_threshold;
+  if (arrived_)
+  {
+    // stop right away, the target is in front of us
+    command_ = Command();
+    last_time_ = time;
+    has_time_ = true;
+    return command_;
+  }
+
+  Command desired;
+  // offset is at most 0.5 at the image border; turn towards the target
+  desired.angular_speed = clamp(-2.0 * offset * parameters_.angular_gain, parameters_.max_angular_speed);
+  // slow down as the target grows and while we are still turning towards it. The area grows with
+  // the inverse square of the distance, thus its root tells how many times farther than at arrival
+  // the target is.
+  const double remaining = std::sqrt(parameters_.area_threshold / std::max(area, 1e-9)) - 1.0;
+  const double alignment = std::max(0.0, 1.0 - 2.0 * std::abs(offset));
+  desired.linear_speed = std::min(parameters_.max_linear_speed,
+                                  parameters_.linear_gain * std::max(0.0, remaining) * alignment);
+  if (aligned)
+  {
+    desired.linear_speed = std::max(desired.linear_speed, parameters_.min_linear_speed);
+  }
+  return limit(time, desired);
+}
+
+VisualServo::Command VisualServo::update(double time)
+{
+  arrived_ = false;
+  if (!locked_ || time - last_seen_ > parameters_.lost_lock_timeout)
+  {
+    // lost lock, stop the robot
+    locked_ = false;
+    command_ = Command();
+    last_time_ = time;
+    has_time_ = true;
+    return command_;
+  }
+  // keep turning in the direction the target was last seen, but do not drive blindly
+  Command desired;
+  desired.angular_speed = command_.angular_speed;
+  return limit(time, desired);
+}
+
+VisualServo::Command VisualServo::limit(double time, const Command &desired)
+{
+  const double dt = has_time_ ? std::max(0.0, time - last_time_) : 0.0;
+  last_time_ = time;
+  has_time_ = true;
+  command_.linear_speed += clamp(desired.linear_speed - command_.linear_speed,
+                                 parameters_.max_linear_acceleration * dt);
+  command_.angular_speed += clamp(desired.angular_speed - command_.angular_speed,
+                                  parameters_.max_angular_acceleration * dt);
+  return command_;
+}
+
+} // namespace ev3
+} // namespace isaac
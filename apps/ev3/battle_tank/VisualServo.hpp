@@ -0,0 +1,80 @@
+#pragma once
+
+namespace isaac {
+namespace ev3 {
+
+// Turns the position and size of a target in the camera image directly into body speeds for a
+// differential base. The horizontal offset of the target drives the angular speed, its apparent
+// area drives the linear speed. Speed changes are rate limited and the robot stops if the target
+// was not seen for a while.
+//
+// The class has no dependencies on the camera or the engine, visual_servo_sim drives it with a
+// simulated block source.
+class VisualServo {
+ public:
+  struct Parameters {
+    // Angular speed in rad/s for a target at the border of the image
+    double angular_gain = 0.6;
+    // Linear speed in m/s per multiple of the arrival distance the target is still away, the
+    // distance is estimated from the area
+    double linear_gain = 0.3;
+    // Linear speed in m/s while the target is aligned but not close enough yet, the speed of
+    // linear_gain alone vanishes just short of area_threshold
+    double min_linear_speed = 0.02;
+    double max_linear_speed = 0.1;
+    double max_angular_speed = 0.6;
+    // Rate limits in m/s^2 and rad/s^2
+    double max_linear_acceleration = 0.2;
+    double max_angular_acceleration = 1.5;
+    // Maximum absolute offset of the target center as a fraction of the image width to count as
+    // aligned
+    double center_threshold = 0.1;
+    // Fraction of the image covered by the target at which it is close enough
+    double area_threshold = 0.1;
+    // Time in seconds without detection after which the lock is lost
+    double lost_lock_timeout = 0.5;
+  };
+
+  // Body speed command
+  struct Command {
+    double linear_speed = 0.0;
+    double angular_speed = 0.0;
+  };
+
+  VisualServo() = default;
+  explicit VisualServo(const Parameters& parameters) : parameters_(parameters) {}
+
+  // Updates the parameters, for example after they were changed in Sight
+  void setParameters(const Parameters& parameters) { parameters_ = parameters; }
+
+  // Forgets the target and the previous command
+  void reset();
+
+  // Computes the next command for a detection at `time` (in seconds). `offset` is the horizontal
+  // offset of the target center from the image center as a fraction of the image width (negative
+  // if the target is to the left) and `area` the fraction of the image covered by the target.
+  Command update(double time, double offset, double area);
+
+  // Computes the next command at `time` if the target was not detected
+  Command update(double time);
+
+  // True while the target was seen within the lost lock timeout
+  bool locked() const { return locked_; }
+  // True if the latest detection was aligned and close enough
+  bool arrived() const { return arrived_; }
+
+ private:
+  // Moves the previous command towards `desired` within the acceleration limits
+  Command limit(double time, const Command& desired);
+
+  Parameters parameters_;
+  Command command_;
+  double last_time_ = 0.0;
+  double last_seen_ = 0.0;
+  bool has_time_ = false;
+  bool locked_ = false;
+  bool arrived_ = false;
+};
+
+}  // namespace ev3
+}  // namespace isaac
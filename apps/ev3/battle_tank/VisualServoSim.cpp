@@ -0,0 +1,329 @@
+// Drives VisualServo with a simulated Pixy2 looking at a block and a differential base which
+// follows the commands with a lag. Checks that the servo reaches the block, that its commands stay
+// within the speed and acceleration limits and that it stops after losing the block. Also runs the
+// goal stepping of the "goal" control mode, a goal 0.2 m ahead at +-45 deg while misaligned and
+// 0.5 m ahead once aligned, against a goal follower with the same limits, and compares the time
+// until the tank shoots. Exits with 1 if a check fails.
+//
+//   visual_servo_sim
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+#include "VisualServo.hpp"
+
+using namespace isaac::ev3;
+
+namespace
+{
+
+constexpr double kStep = 0.001;
+constexpr double kTimeout = 60.0;
+// Pixy2 blocks at the rate BattleTank ticks
+constexpr double kCameraRate = 30.0;
+constexpr double kHorizontalFov = 60.0 * M_PI / 180.0;
+constexpr double kVerticalFov = 40.0 * M_PI / 180.0;
+constexpr double kCameraRange = 3.0;
+// Edge length of the block in meters
+constexpr double kBlockSize = 0.1;
+// Time constant of the base following a speed command
+constexpr double kBaseLag = 0.1;
+
+// Thresholds of battle_tank.app.json
+constexpr double kCenterThreshold = 0.3;
+constexpr double kAreaThreshold = 0.1;
+
+struct Pose
+{
+  double x = 0.0, y = 0.0, heading = 0.0;
+};
+
+// A block which moves with constant speed and is hidden during [hidden_from, hidden_to)
+struct Block
+{
+  double x, y;
+  double speed_x = 0.0, speed_y = 0.0;
+  double hidden_from = kTimeout, hidden_to = kTimeout;
+
+  Block at(double time) const
+  {
+    Block moved = *this;
+    moved.x += speed_x * time;
+    moved.y += speed_y * time;
+    return moved;
+  }
+};
+
+struct Scenario
+{
+  const char *name;
+  Block block;
+};
+
+// Position of the block in the image like BattleTank computes it from a Pixy2 block, false if the
+// block is not visible
+bool observe(const Pose &pose, const Block &block, double time, double &offset, double &area)
+{
+  if (time >= block.hidden_from && time < block.hidden_to)
+  {
+    return false;
+  }
+  const Block moved = block.at(time);
+  const double dx = moved.x - pose.x;
+  const double dy = moved.y - pose.y;
+  const double c = std::cos(pose.heading), s = std::sin(pose.heading);
+  const double forward = c * dx + s * dy;
+  const double left = -s * dx + c * dy;
+  if (forward <= 0.0 || std::hypot(forward, left) > kCameraRange)
+  {
+    return false;
+  }
+  const double half_width = std::tan(kHorizontalFov / 2);
+  // positive to the right of the image center
+  offset = -left / forward / (2.0 * half_width);
+  if (std::abs(offset) > 0.5)
+  {
+    return false;
+  }
+  const double width = kBlockSize / (2.0 * forward * half_width);
+  const double height = kBlockSize / (2.0 * forward * std::tan(kVerticalFov / 2));
+  area = std::min(1.0, width) * std::min(1.0, height);
+  return true;
+}
+
+// A differential base which follows speed commands with a first order lag
+struct Base
+{
+  Pose pose;
+  double linear = 0.0, angular = 0.0;
+
+  void step(double linear_command, double angular_command)
+  {
+    linear += (linear_command - linear) * kStep / kBaseLag;
+    angular += (angular_command - angular) * kStep / kBaseLag;
+    pose.heading += angular * kStep;
+    pose.x += linear * std::cos(pose.heading) * kStep;
+    pose.y += linear * std::sin(pose.heading) * kStep;
+  }
+};
+
+VisualServo::Parameters servoParameters()
+{
+  VisualServo::Parameters parameters;
+  parameters.center_threshold = kCenterThreshold;
+  parameters.area_threshold = kAreaThreshold;
+  return parameters;
+}
+
+// Outcome of driving towards a block
+struct Run
+{
+  // time of the shot, or kTimeout
+  double shot = kTimeout;
+  // commands which exceeded a speed or acceleration limit
+  int limit_violations = 0;
+  // time at which the servo lost the lock and stopped, or kTimeout
+  double stopped = kTimeout;
+  // commands with a linear speed above the one before while the block was not visible
+  int blind_accelerations = 0;
+};
+
+Run runServo(const Block &block)
+{
+  const VisualServo::Parameters parameters = servoParameters();
+  VisualServo servo(parameters);
+  Base base;
+  Run run;
+  VisualServo::Command command, previous;
+  double next_frame = 0.0, previous_time = 0.0;
+  for (double t = 0.0; t < kTimeout; t += kStep)
+  {
+    if (t >= next_frame)
+    {
+      double offset, area;
+      const bool visible = observe(base.pose, block, t, offset, area);
+      command = visible ? servo.update(t, offset, area) : servo.update(t);
+      if (servo.arrived())
+      {
+        run.shot = t;
+        break;
+      }
+      // the command is reset to zero on arrival and on a lost lock, everything else is limited
+      const double dt = t - previous_time;
+      const bool stop = command.linear_speed == 0.0 && command.angular_speed == 0.0;
+      if (std::abs(command.linear_speed) > parameters.max_linear_speed + 1e-9 ||
+          std::abs(command.angular_speed) > parameters.max_angular_speed + 1e-9 ||
+          (!stop && (std::abs(command.linear_speed - previous.linear_speed) >
+                         parameters.max_linear_acceleration * dt + 1e-9 ||
+                     std::abs(command.angular_speed - previous.angular_speed) >
+                         parameters.max_angular_acceleration * dt + 1e-9)))
+      {
+        run.limit_violations++;
+      }
+      if (!visible && command.linear_speed > previous.linear_speed + 1e-12)
+      {
+        run.blind_accelerations++;
+      }
+      if (!servo.locked())
+      {
+        if (!stop)
+        {
+          run.limit_violations++;
+        }
+        run.stopped = std::min(run.stopped, t);
+        // BattleTank hands the base back to the planner here
+        break;
+      }
+      previous = command;
+      previous_time = t;
+      next_frame += 1.0 / kCameraRate;
+    }
+    base.step(command.linear_speed, command.angular_speed);
+  }
+  return run;
+}
+
+// The goal follower which stands in for the planner: turns towards the goal, drives once facing
+// it and stops within the goal tolerance, with the same limits as the servo
+struct GoalFollower
+{
+  Pose goal;
+  bool active = false;
+  double linear = 0.0, angular = 0.0;
+
+  void command(const Pose &pose, double &linear_command, double &angular_command)
+  {
+    const VisualServo::Parameters limits = servoParameters();
+    double desired_linear = 0.0, desired_angular = 0.0;
+    const double dx = goal.x - pose.x, dy = goal.y - pose.y;
+    if (active && std::hypot(dx, dy) > 0.1)
+    {
+      double bearing = std::atan2(dy, dx) - pose.heading;
+      bearing = std::atan2(std::sin(bearing), std::cos(bearing));
+      desired_angular = std::max(-limits.max_angular_speed, std::min(limits.max_angular_speed, 2.0 * bearing));
+      desired_linear = std::abs(bearing) < 0.3 ? std::min(limits.max_linear_speed, std::hypot(dx, dy)) : 0.0;
+    }
+    const double max_linear_change = limits.max_linear_acceleration * kStep;
+    const double max_angular_change = limits.max_angular_acceleration * kStep;
+    linear += std::max(-max_linear_change, std::min(max_linear_change, desired_linear - linear));
+    angular += std::max(-max_angular_change, std::min(max_angular_change, desired_angular - angular));
+    linear_command = linear;
+    angular_command = angular;
+  }
+};
+
+// Goal at `distance` ahead of `pose` after turning by `angle`, like Pose2d::Rotation * Translation
+Pose goalAhead(const Pose &pose, double angle, double distance)
+{
+  Pose goal;
+  goal.heading = pose.heading + angle;
+  goal.x = pose.x + distance * std::cos(goal.heading);
+  goal.y = pose.y + distance * std::sin(goal.heading);
+  return goal;
+}
+
+// The "goal" control mode of BattleTank in kStateDetected
+Run runGoalStepping(const Block &block)
+{
+  Base base;
+  GoalFollower follower;
+  Run run;
+  bool prev_rotation = false, prev_translation = false;
+  double next_frame = 0.0;
+  for (double t = 0.0; t < kTimeout; t += kStep)
+  {
+    if (t >= next_frame)
+    {
+      double offset, area;
+      if (observe(base.pose, block, t, offset, area))
+      {
+        bool rotation = false, translation = false;
+        Pose goal;
+        if (std::abs(offset) > kCenterThreshold)
+        {
+          goal = goalAhead(base.pose, offset < 0.0 ? M_PI_4 : -M_PI_4, 0.2);
+          rotation = true;
+        }
+        else if (area > kAreaThreshold)
+        {
+          run.shot = t;
+          break;
+        }
+        else
+        {
+          goal = goalAhead(base.pose, 0.0, 0.5);
+          translation = true;
+        }
+        if ((rotation && !prev_rotation) || (translation && !prev_translation))
+        {
+          prev_rotation = rotation;
+          prev_translation = translation;
+          follower.goal = goal;
+          follower.active = true;
+        }
+      }
+      else
+      {
+        prev_rotation = false;
+        prev_translation = false;
+      }
+      next_frame += 1.0 / kCameraRate;
+    }
+    double linear, angular;
+    follower.command(base.pose, linear, angular);
+    base.step(linear, angular);
+  }
+  return run;
+}
+
+std::string format(double shot)
+{
+  char text[16];
+  std::snprintf(text, sizeof(text), "%.2f", shot);
+  return shot < kTimeout ? text : "-";
+}
+
+} // namespace
+
+int main()
+{
+  // blocks in view of the robot at the origin, which looks along x
+  const Scenario scenarios[] = {
+      {"ahead 1.2 m", Block{1.2, 0.0}},
+      {"left 1.0 m", Block{1.0, 0.4}},
+      {"right 0.9 m", Block{0.9, -0.45}},
+      {"far 2.5 m", Block{2.5, 0.6}},
+      {"crossing", Block{1.2, 0.3, 0.0, -0.03}},
+      {"occluded 0.3 s", Block{1.2, 0.2, 0.0, 0.0, 2.0, 2.3}},
+  };
+  int failures = 0;
+  std::printf("time to shot in s, - if the tank did not shoot within %.0f s\n", kTimeout);
+  std::printf("%-16s %8s %8s\n", "block", "servo", "goals");
+  for (const Scenario &scenario : scenarios)
+  {
+    const Run servo = runServo(scenario.block);
+    const Run goals = runGoalStepping(scenario.block);
+    std::printf("%-16s %8s %8s\n", scenario.name, format(servo.shot).c_str(), format(goals.shot).c_str());
+    if (servo.shot >= kTimeout || servo.limit_violations > 0 || servo.blind_accelerations > 0)
+    {
+      std::printf("  FAILED: shot %.2f, %d limit violations, %d blind accelerations\n", servo.shot,
+                  servo.limit_violations, servo.blind_accelerations);
+      failures++;
+    }
+  }
+
+  // the block disappears for good, the servo must stop after the lost lock timeout
+  Block lost{1.2, 0.2, 0.0, 0.0, 2.0, kTimeout};
+  const Run run = runServo(lost);
+  const double latest_stop = lost.hidden_from + servoParameters().lost_lock_timeout + 1.0 / kCameraRate;
+  std::printf("lost block: stopped %.2f s after it disappeared\n", run.stopped - lost.hidden_from);
+  if (run.stopped > latest_stop || run.limit_violations > 0 || run.blind_accelerations > 0)
+  {
+    std::printf("  FAILED: stopped at %.2f, %d limit violations, %d blind accelerations\n", run.stopped,
+                run.limit_violations, run.blind_accelerations);
+    failures++;
+  }
+  return failures == 0 ? 0 : 1;
+}
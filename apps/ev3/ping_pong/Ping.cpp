@@ -18,6 +18,9 @@ void Ping::start() {
 }
 
 void Ping::tick() {
+  const auto timer = tick_latency_.measure();
+  tick_latency_.report(getTickTime(), [this](const char* tag, double value) { show(tag, value); });
+
   // Create and publish a ping message
   auto proto = tx_ping().initProto();
   // We send a different ping each time we tick. `getTickCount()` will give us the number of times
@@ -28,4 +31,8 @@ void Ping::tick() {
   LOG_INFO("Sent a ping");
 }
 
+void Ping::stop() {
+  tick_latency_.dump(full_name());
+}
+
 }  // namespace isaac
@@ -13,6 +13,7 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 
 #include "engine/alice/alice.hpp"
 #include "messages/messages.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
 
 namespace isaac {
 
@@ -23,9 +24,14 @@ class Ping : public alice::Codelet {
   void start() override;
   // Has whatever needs to be run repeatedly
   void tick() override;
+  // Writes the tick latency histogram to disk
+  void stop() override;
 
   // An outgoing message channel on which pings are sent
   ISAAC_PROTO_TX(PingProto, ping);
+
+ private:
+  ev3::TickLatency tick_latency_;
 };
 
 }  // namespace isaac
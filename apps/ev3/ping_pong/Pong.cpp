@@ -10,18 +10,22 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 
 #include "Pong.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <memory>
 #include <string>
 
 #include "ping.capnp.h"
 #include <capnp/ez-rpc.h>
 #include <capnp/message.h>
-#include <iostream>
 
 namespace isaac
 {
 
 void Pong::start()
 {
+  stopping_ = false;
+  client_thread_ = std::thread(&Pong::runClient, this, get_address() + ":" + std::to_string(get_port()));
   // By using tickOnMessage instead of tickPeriodically we instruct the codelet to only tick when
   // a new message is received on the incoming data channel `trigger`.
   tickOnMessage(rx_trigger());
@@ -31,28 +35,87 @@ void Pong::tick()
 {
   // This function will now only be executed whenever we receive a new message. This is guaranteed
   // by the Isaac Robot Engine.
+  const auto timer = tick_latency_.measure();
+  tick_latency_.report(getTickTime(), [this](const char *tag, double value) { show(tag, value); });
 
-  // Parse the message we received
-  auto proto = rx_trigger().getProto();
-  const std::string message = proto.getMessage();
-
-  capnp::EzRpcClient client(get_address()+":"+std::to_string(get_port()));
-  Ev3Ping::Client ping = client.getMain<Ev3Ping>();
-  auto &waitScope = client.getWaitScope();
+  // Hand the ping to the client thread, the tick does not wait for the brick. The brick speaks a
+  // fixed phrase rather than the numbered message, thus it plays from its speech cache.
   {
-    std::cout << "Sending ping... ";
-    std::cout.flush();
-
-    auto request = ping.pingRequest();
-    request.setPing("Ping");
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (static_cast<int>(pending_.size()) >= std::max(1, get_max_pending()))
+    {
+      pending_.pop_front();
+      dropped_++;
+    }
+    pending_.push_back("Ping");
+  }
+  condition_.notify_one();
 
-    // Send it, which returns a promise for the result (without blocking).
-    auto pingPromise = request.send();
+  show("rtt (ms)", 1e-6 * last_round_trip_.load());
+  show("rtt p50 (ms)", 1e-6 * round_trip_.percentile(50.0));
+  show("rtt p99 (ms)", 1e-6 * round_trip_.percentile(99.0));
+  show("failures", static_cast<double>(failures_.load()));
+  show("dropped", static_cast<double>(dropped_.load()));
+}
 
-    auto response = pingPromise.wait(waitScope);
-    std::cout << response.getValue().cStr() << std::endl;
+void Pong::runClient(std::string address)
+{
+  std::unique_ptr<capnp::EzRpcClient> client;
+  while (true)
+  {
+    std::string ping_text;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+      if (stopping_)
+      {
+        return;
+      }
+      ping_text = std::move(pending_.front());
+      pending_.pop_front();
+    }
+    try
+    {
+      if (!client)
+      {
+        client = std::make_unique<capnp::EzRpcClient>(address);
+      }
+      Ev3Ping::Client ping = client->getMain<Ev3Ping>();
+      auto request = ping.pingRequest();
+      request.setPing(ping_text);
+      const auto begin = std::chrono::steady_clock::now();
+      auto response = request.send().wait(client->getWaitScope());
+      const auto round_trip = std::chrono::steady_clock::now() - begin;
+      round_trip_.record(round_trip);
+      last_round_trip_ = std::chrono::duration_cast<std::chrono::nanoseconds>(round_trip).count();
+      LOG_DEBUG("%s after %.2f ms", response.getValue().cStr(), 1e-6 * last_round_trip_.load());
+    }
+    catch (const kj::Exception &exception)
+    {
+      failures_++;
+      LOG_ERROR("ping failed: %s", exception.getDescription().cStr());
+      // connect again for the next ping
+      client.reset();
+    }
   }
+}
 
+void Pong::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    pending_.clear();
+  }
+  condition_.notify_one();
+  if (client_thread_.joinable())
+  {
+    client_thread_.join();
+  }
+  tick_latency_.dump(full_name());
+  std::string name = full_name();
+  std::replace(name.begin(), name.end(), '/', '.');
+  round_trip_.writeToFile(("/tmp/ping_rtt_" + name + ".txt").c_str());
 }
 
 } // namespace isaac
@@ -9,22 +9,53 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 */
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
 #include "engine/alice/alice.hpp"
 #include "messages/messages.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
 
 namespace isaac {
 
-// A simple C++ codelet which receives a ping and reacts to it
+// A simple C++ codelet which receives a ping and reacts to it by pinging the EV3.
+//
+// The kj event loop of a Cap'n Proto client belongs to the thread which created it, while ticks may
+// run on any worker thread. Thus one client thread keeps a connection open for the lifetime of the
+// codelet and sends the pings queued by tick; it reconnects after errors. The round trip time of
+// every ping is measured.
 class Pong : public alice::Codelet {
  public:
   void start() override;
   void tick() override;
+  void stop() override;
 
   // An incoming message channel on which we receive pings.
   ISAAC_PROTO_RX(PingProto, trigger);
 
   ISAAC_PARAM(std::string, address, "localhost");
   ISAAC_PARAM(int, port, 9000);
+  // Pings waiting for the client thread, older ones are dropped
+  ISAAC_PARAM(int, max_pending, 8);
+
+ private:
+  // Sends the queued pings over a persistent connection
+  void runClient(std::string address);
+
+  ev3::TickLatency tick_latency_;
+  ev3::LatencyHistogram round_trip_;
+  std::thread client_thread_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<std::string> pending_;
+  bool stopping_ = false;
+  std::atomic<uint64_t> last_round_trip_{0};
+  std::atomic<uint64_t> failures_{0};
+  std::atomic<uint64_t> dropped_{0};
 };
 
 }  // namespace isaac
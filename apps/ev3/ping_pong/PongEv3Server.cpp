@@ -2,37 +2,48 @@
 #include <capnp/ez-rpc.h>
 #include <capnp/message.h>
 #include <iostream>
-#include "ev3dev.h"
 
+#include "SpeechWorker.hpp"
+
+// Answers pings and speaks them. Speech runs on a worker thread, thus the event loop keeps serving
+// requests while the brick talks.
 class PongEv3Server final: public Ev3Ping::Server {
   public:
+    explicit PongEv3Server(isaac::ev3::SpeechWorker& speech) : speech(speech) {}
+
     ::kj::Promise<void> ping(PingContext context) override {
       auto message = context.getParams().getPing();
       std::cout << message.cStr() << std::endl;
-      ev3dev::sound::speak(message.cStr(), true);
+      if (!speech.say(message.cStr())) {
+        std::cout << "speech queue full, dropped the oldest phrase" << std::endl;
+      }
       context.getResults().setValue("Pong!");
       return kj::READY_NOW;
     }
+
+  private:
+    isaac::ev3::SpeechWorker& speech;
 };
 
 
 int main(int argc, const char* argv[]) {
   // We expect one argument specifying the address to which
-  // to bind and accept connections.
-  if (argc != 2) {
-    std::cerr << "usage: " << argv[0] << " ADDRESS[:PORT]"
+  // to bind and accept connections, optionally followed by the directory of the speech cache.
+  if (argc != 2 && argc != 3) {
+    std::cerr << "usage: " << argv[0] << " ADDRESS[:PORT] [CACHE_DIRECTORY]"
               << std::endl;
     return 1;
   }
+  isaac::ev3::SpeechWorker speech(argc == 3 ? argv[2] : "/tmp/ev3_speech_cache");
 
   // Set up the EzRpcServer, binding to port 5923 unless a
   // different port was specified by the user.  Note that the
   // first parameter here can be any "Client" object or anything
   // that can implicitly cast to a "Client" object.  You can even
   // re-export a capability imported from another server.
-  capnp::EzRpcServer server(kj::heap<PongEv3Server>(), argv[1], 5923);
+  capnp::EzRpcServer server(kj::heap<PongEv3Server>(speech), argv[1], 5923);
   auto& waitScope = server.getWaitScope();
 
 //   // Run forever, accepting connections and handling requests.
   kj::NEVER_DONE.wait(waitScope);
-}
\ No newline at end of file
+}
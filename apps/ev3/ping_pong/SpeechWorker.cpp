@@ -0,0 +1,177 @@
+#include "SpeechWorker.hpp"
+
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+extern char **environ;
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+
+// Runs a program with arguments and waits for it, without a shell so the text needs no escaping
+bool Run(const std::vector<std::string> &arguments)
+{
+  std::vector<char *> argv;
+  for (const auto &argument : arguments)
+  {
+    argv.push_back(const_cast<char *>(argument.c_str()));
+  }
+  argv.push_back(nullptr);
+  pid_t pid;
+  if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+  {
+    return false;
+  }
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0)
+  {
+    if (errno != EINTR)
+    {
+      return false;
+    }
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool FileExists(const std::string &path)
+{
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && info.st_size > 0;
+}
+
+} // namespace
+
+uint64_t Fnv1a(const std::string &text)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (const char c : text)
+  {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+SpeechWorker::SpeechWorker(std::string cache_directory, size_t capacity, std::string espeak_options)
+    : cache_directory_(std::move(cache_directory)), capacity_(capacity > 0 ? capacity : 1),
+      espeak_options_(std::move(espeak_options))
+{
+  mkdir(cache_directory_.c_str(), 0755);
+  thread_ = std::thread([this] { run(); });
+}
+
+SpeechWorker::~SpeechWorker()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_one();
+  thread_.join();
+}
+
+bool SpeechWorker::say(const std::string &text)
+{
+  bool dropped = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.size() >= capacity_)
+    {
+      queue_.pop_front();
+      stats_.dropped++;
+      dropped = true;
+    }
+    queue_.push_back(text);
+  }
+  condition_.notify_one();
+  return !dropped;
+}
+
+SpeechWorker::Stats SpeechWorker::stats() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+std::string SpeechWorker::cachePath(const std::string &text) const
+{
+  char name[32];
+  // the options change the waveform, thus they are part of the key
+  std::snprintf(name, sizeof(name), "/%016llx.wav",
+                static_cast<unsigned long long>(Fnv1a(espeak_options_ + '\n' + text)));
+  return cache_directory_ + name;
+}
+
+bool SpeechWorker::synthesize(const std::string &text, const std::string &path, bool &cached)
+{
+  cached = FileExists(path);
+  if (cached)
+  {
+    return true;
+  }
+  // write to a temporary file first, an interrupted synthesis must not end up in the cache
+  const std::string temporary = path + ".tmp";
+  std::vector<std::string> arguments{"espeak"};
+  std::istringstream options(espeak_options_);
+  for (std::string option; options >> option;)
+  {
+    arguments.push_back(option);
+  }
+  arguments.push_back("-w");
+  arguments.push_back(temporary);
+  arguments.push_back(text);
+  if (!Run(arguments))
+  {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+void SpeechWorker::run()
+{
+  while (true)
+  {
+    std::string text;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_)
+      {
+        return;
+      }
+      text = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    const std::string path = cachePath(text);
+    bool cached = false;
+    const bool ok = synthesize(text, path, cached) && Run({"aplay", "-q", path});
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ok)
+    {
+      stats_.spoken++;
+      stats_.cache_hits += cached ? 1 : 0;
+    }
+    else
+    {
+      stats_.failures++;
+      std::cerr << "Could not speak '" << text << "'" << std::endl;
+    }
+  }
+}
+
+} // namespace ev3
+} // namespace isaac
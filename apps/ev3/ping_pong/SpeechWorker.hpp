@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace isaac {
+namespace ev3 {
+
+// Speaks phrases on a thread of its own, so that callers like RPC handlers return immediately.
+//
+// Phrases wait in a bounded queue; if it is full the oldest waiting phrase is dropped, a robot
+// should say what is current. Every phrase is synthesized once with espeak into a wav file in the
+// cache directory, named after a hash of the text and the voice options; repeated phrases are
+// played straight from the cache with aplay.
+class SpeechWorker {
+ public:
+  struct Stats {
+    uint64_t spoken = 0;
+    uint64_t dropped = 0;
+    uint64_t cache_hits = 0;
+    uint64_t failures = 0;
+  };
+
+  explicit SpeechWorker(std::string cache_directory, size_t capacity = 4,
+                        std::string espeak_options = "-a 200 -s 130");
+  ~SpeechWorker();
+
+  SpeechWorker(const SpeechWorker&) = delete;
+  SpeechWorker& operator=(const SpeechWorker&) = delete;
+
+  // Queues a phrase, returns false if an older phrase had to be dropped for it
+  bool say(const std::string& text);
+
+  Stats stats() const;
+
+  // Path of the cached waveform of a phrase
+  std::string cachePath(const std::string& text) const;
+
+ private:
+  void run();
+  // Synthesizes a phrase into the cache unless it is there, false on failure
+  bool synthesize(const std::string& text, const std::string& path, bool& cached);
+
+  const std::string cache_directory_;
+  const size_t capacity_;
+  const std::string espeak_options_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<std::string> queue_;
+  Stats stats_;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+// 64 bit FNV-1a hash, stable across runs and platforms for cache file names
+uint64_t Fnv1a(const std::string& text);
+
+}  // namespace ev3
+}  // namespace isaac
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+
+namespace isaac {
+
+// A differential drive robot with the limits of the EV3: commands reach the wheels after a delay,
+// every wheel follows its speed command with a first order lag and wheel speeds saturate at the
+// maximum tacho speed of the motors. Used to simulate controllers offline.
+class DifferentialDrivePlant {
+ public:
+  struct Parameters {
+    // Distance between the wheels in meters
+    double base_length = 0.156;
+    // Maximum wheel speed in m/s, max_speed * tacho_to_speed of kEv3Tank
+    double max_wheel_speed = 900 * 0.00026;
+    // Time constant of the wheel speed in seconds
+    double time_constant = 0.08;
+    // Delay from sending a command until the wheels start following it, in seconds
+    double delay = 0.05;
+  };
+
+  explicit DifferentialDrivePlant(const Parameters& parameters) : parameters_(parameters) {}
+
+  // Sends a body speed command at time `time`
+  void command(double time, double linear_speed, double angular_speed) {
+    const double half = 0.5 * angular_speed * parameters_.base_length;
+    pending_.push_back(Command{time + parameters_.delay, clamp(linear_speed - half), clamp(linear_speed + half)});
+  }
+
+  // Advances the robot to `time` by `dt` seconds
+  void advance(double time, double dt) {
+    while (!pending_.empty() && pending_.front().due <= time) {
+      left_target_ = pending_.front().left;
+      right_target_ = pending_.front().right;
+      pending_.pop_front();
+    }
+    const double alpha = 1.0 - std::exp(-dt / parameters_.time_constant);
+    left_ += (left_target_ - left_) * alpha;
+    right_ += (right_target_ - right_) * alpha;
+    const double linear = 0.5 * (left_ + right_);
+    const double angular = (right_ - left_) / parameters_.base_length;
+    x_ += linear * std::cos(heading_) * dt;
+    y_ += linear * std::sin(heading_) * dt;
+    heading_ += angular * dt;
+  }
+
+  double x() const { return x_; }
+  double y() const { return y_; }
+  double heading() const { return heading_; }
+  double linearSpeed() const { return 0.5 * (left_ + right_); }
+
+ private:
+  struct Command {
+    double due;
+    double left;
+    double right;
+  };
+
+  double clamp(double speed) const {
+    return std::max(-parameters_.max_wheel_speed, std::min(parameters_.max_wheel_speed, speed));
+  }
+
+  Parameters parameters_;
+  std::deque<Command> pending_;
+  double left_target_ = 0.0;
+  double right_target_ = 0.0;
+  double left_ = 0.0;
+  double right_ = 0.0;
+  double x_ = 0.0;
+  double y_ = 0.0;
+  double heading_ = 0.0;
+};
+
+}  // namespace isaac
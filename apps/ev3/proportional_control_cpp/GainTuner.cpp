@@ -0,0 +1,193 @@
+// Tunes the gain of ProportionalControlCpp offline. Every gain of a log-spaced sweep drives many
+// episodes of a simulated EV3 to a reference; episodes randomize the delay, the wheel time constant,
+// the start and the reference. Rise time, overshoot and settling time are averaged per gain and the
+// gains which are not beaten in all three by another gain, the Pareto front, are printed.
+//
+//   gain_tuner [GAINS [EPISODES [MIN_GAIN MAX_GAIN [CSV]]]]
+//
+// CSV optionally receives the scores of all gains.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "DifferentialDrivePlant.hpp"
+#include "ProportionalControlLaw.hpp"
+#include "packages/utils/ParallelFor.hpp"
+
+using namespace isaac;
+
+namespace
+{
+
+// Tick period of the codelet in the app
+constexpr double kControlPeriod = 0.01;
+constexpr double kPlantStep = 0.001;
+constexpr double kEpisodeDuration = 15.0;
+// The settling band is 2% of the step but not narrower than the odometry is accurate
+constexpr double kSettlingBand = 0.02;
+constexpr double kMinSettlingBand = 0.005;
+
+struct Metrics
+{
+  double rise_time = 0.0;
+  // in percent of the step
+  double overshoot = 0.0;
+  double settling_time = 0.0;
+};
+
+struct Score
+{
+  double gain = 0.0;
+  Metrics mean;
+  // episodes which did not rise or settle within the episode
+  int failures = 0;
+  bool pareto = false;
+};
+
+Metrics runEpisode(double gain, std::mt19937 &rng)
+{
+  DifferentialDrivePlant::Parameters parameters;
+  parameters.delay = std::uniform_real_distribution<double>(0.02, 0.15)(rng);
+  parameters.time_constant = std::uniform_real_distribution<double>(0.05, 0.15)(rng);
+  DifferentialDrivePlant plant(parameters);
+  const double start = 0.0;
+  const double reference = std::uniform_real_distribution<double>(0.2, 1.5)(rng) *
+                           (std::bernoulli_distribution(0.5)(rng) ? 1.0 : -1.0);
+  const double step = reference - start;
+  const double band = std::max(kMinSettlingBand, kSettlingBand * std::abs(step));
+
+  const double inf = std::numeric_limits<double>::infinity();
+  double t10 = inf, t90 = inf, last_outside = 0.0, peak = 0.0;
+  double next_control = 0.0;
+  for (double t = 0.0; t < kEpisodeDuration; t += kPlantStep)
+  {
+    if (t >= next_control)
+    {
+      plant.command(t, ProportionalControl(gain, reference, plant.x()), 0.0);
+      next_control += kControlPeriod;
+    }
+    plant.advance(t, kPlantStep);
+    // progress towards the reference as a fraction of the step
+    const double progress = (plant.x() - start) / step;
+    if (t10 == inf && progress >= 0.1)
+      t10 = t;
+    if (t90 == inf && progress >= 0.9)
+      t90 = t;
+    peak = std::max(peak, progress);
+    if (std::abs(plant.x() - reference) > band)
+      last_outside = t;
+  }
+  Metrics metrics;
+  metrics.rise_time = t90 - t10;
+  metrics.overshoot = 100.0 * std::max(0.0, peak - 1.0);
+  // still outside at the end means it never settled
+  metrics.settling_time = last_outside + kPlantStep >= kEpisodeDuration ? inf : last_outside;
+  return metrics;
+}
+
+Score scoreGain(double gain, int episodes, unsigned seed)
+{
+  // the same seed for every gain, all gains see the same episodes
+  std::mt19937 rng(seed);
+  Score score;
+  score.gain = gain;
+  int counted = 0;
+  for (int i = 0; i < episodes; i++)
+  {
+    const Metrics metrics = runEpisode(gain, rng);
+    if (!std::isfinite(metrics.rise_time) || !std::isfinite(metrics.settling_time))
+    {
+      score.failures++;
+      continue;
+    }
+    score.mean.rise_time += metrics.rise_time;
+    score.mean.overshoot += metrics.overshoot;
+    score.mean.settling_time += metrics.settling_time;
+    counted++;
+  }
+  if (counted > 0)
+  {
+    score.mean.rise_time /= counted;
+    score.mean.overshoot /= counted;
+    score.mean.settling_time /= counted;
+  }
+  else
+  {
+    // never reached the reference, worse than any gain which did
+    const double inf = std::numeric_limits<double>::infinity();
+    score.mean = Metrics{inf, inf, inf};
+  }
+  return score;
+}
+
+// true if `a` is at least as good as `b` in all metrics and better in one
+bool dominates(const Score &a, const Score &b)
+{
+  const bool no_worse = a.failures <= b.failures && a.mean.rise_time <= b.mean.rise_time &&
+                        a.mean.overshoot <= b.mean.overshoot && a.mean.settling_time <= b.mean.settling_time;
+  const bool better = a.failures < b.failures || a.mean.rise_time < b.mean.rise_time ||
+                      a.mean.overshoot < b.mean.overshoot || a.mean.settling_time < b.mean.settling_time;
+  return no_worse && better;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const int gains = argc > 1 ? std::atoi(argv[1]) : 200;
+  const int episodes = argc > 2 ? std::atoi(argv[2]) : 200;
+  const double min_gain = argc > 4 ? std::atof(argv[3]) : 0.1;
+  const double max_gain = argc > 4 ? std::atof(argv[4]) : 20.0;
+  const char *csv_path = argc > 5 ? argv[5] : nullptr;
+  if (gains < 1 || episodes < 1 || min_gain <= 0.0 || max_gain < min_gain)
+  {
+    std::fprintf(stderr, "usage: gain_tuner [GAINS [EPISODES [MIN_GAIN MAX_GAIN [CSV]]]]\n");
+    return 1;
+  }
+
+  std::vector<Score> scores(gains);
+  ev3::parallelFor(gains, 0, [&](size_t i) {
+    const double gain = gains == 1 ? min_gain : min_gain * std::pow(max_gain / min_gain, double(i) / (gains - 1));
+    scores[i] = scoreGain(gain, episodes, 1234);
+  });
+
+  for (auto &score : scores)
+  {
+    score.pareto = std::none_of(scores.begin(), scores.end(),
+                                [&](const Score &other) { return dominates(other, score); });
+  }
+
+  if (csv_path != nullptr)
+  {
+    FILE *csv = std::fopen(csv_path, "w");
+    if (csv == nullptr)
+    {
+      std::fprintf(stderr, "Could not write %s\n", csv_path);
+      return 1;
+    }
+    std::fprintf(csv, "gain,rise_time,overshoot,settling_time,failures,pareto\n");
+    for (const auto &score : scores)
+    {
+      std::fprintf(csv, "%f,%f,%f,%f,%d,%d\n", score.gain, score.mean.rise_time, score.mean.overshoot,
+                   score.mean.settling_time, score.failures, score.pareto ? 1 : 0);
+    }
+    std::fclose(csv);
+  }
+
+  std::printf("%d gains x %d episodes, Pareto front:\n", gains, episodes);
+  std::printf("%10s %14s %14s %16s %10s\n", "gain", "rise time (s)", "overshoot (%)", "settling (s)", "failures");
+  for (const auto &score : scores)
+  {
+    if (score.pareto)
+    {
+      std::printf("%10.3f %14.3f %14.2f %16.3f %10d\n", score.gain, score.mean.rise_time, score.mean.overshoot,
+                  score.mean.settling_time, score.failures);
+    }
+  }
+  return 0;
+}
@@ -9,6 +9,8 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 */
 #include "ProportionalControlCpp.hpp"
 
+#include "ProportionalControlLaw.hpp"
+
 #include "engine/gems/state/io.hpp"
 #include "messages/math.hpp"
 #include "messages/state/differential_base.hpp"
@@ -30,6 +32,8 @@ void ProportionalControlCpp::start() {
 
 void ProportionalControlCpp::tick() {
   // This part will be run at every tick. We are ticking periodically in this example.
+  const auto timer = tick_latency_.measure();
+  tick_latency_.report(getTickTime(), [this](const char* tag, double value) { show(tag, value); });
 
   // Nothing to do if we haven't received odometry data yet
   if (!rx_odometry().available()) {
@@ -45,8 +49,8 @@ void ProportionalControlCpp::tick() {
   const Pose2d odometry_T_robot = FromProto(odom_reader.getOdomTRobot());
   const double position = odometry_T_robot.translation.x();
 
-  // Compute the control action
-  const double control = gain * (reference - position);
+  // Compute the control action, see ProportionalControlLaw.hpp
+  const double control = ProportionalControl(gain, reference, position);
 
   // Show some data in Sight
   show("reference (m)", reference);
@@ -62,4 +66,8 @@ void ProportionalControlCpp::tick() {
   tx_cmd().publish();
 }
 
+void ProportionalControlCpp::stop() {
+  tick_latency_.dump(full_name());
+}
+
 }  // namespace isaac
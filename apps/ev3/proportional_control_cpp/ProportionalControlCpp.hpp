@@ -11,6 +11,7 @@ license agreement from NVIDIA CORPORATION is strictly prohibited.
 
 #include "engine/alice/alice.hpp"
 #include "messages/messages.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
 
 namespace isaac {
 
@@ -18,13 +19,15 @@ namespace isaac {
 //
 // We receive odometry information, from which we extract the x position. Then, using refence and
 // gain parameters that are provided by the user, we compute and publish a linear speed command
-// using `control = gain * (reference - position)`
+// using `control = gain * (reference - position)`. The gain can be tuned offline with gain_tuner.
 class ProportionalControlCpp : public alice::Codelet {
  public:
   // Has whatever needs to be run in the beginning of the program
   void start() override;
   // Has whatever needs to be run repeatedly
   void tick() override;
+  // Writes the tick latency histogram to disk
+  void stop() override;
 
   // List of messages this codelet recevies
   ISAAC_PROTO_RX(Odometry2Proto, odometry);
@@ -35,6 +38,9 @@ class ProportionalControlCpp : public alice::Codelet {
   ISAAC_PARAM(double, gain, 1.0);
   // Reference for the controller
   ISAAC_PARAM(double, desired_position_meters, 1.0);
+
+ private:
+  ev3::TickLatency tick_latency_;
 };
 
 }  // namespace isaac
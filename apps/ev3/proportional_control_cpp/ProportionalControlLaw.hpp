@@ -0,0 +1,12 @@
+#pragma once
+
+namespace isaac {
+
+// The control law of ProportionalControlCpp, shared with the gain tuner so that tuned gains carry
+// over to the codelet. Returns the linear speed command for the robot at `position` to reach
+// `reference`, both in meters along the x axis of the odometry frame.
+inline double ProportionalControl(double gain, double reference, double position) {
+  return gain * (reference - position);
+}
+
+}  // namespace isaac
@@ -1,46 +1,197 @@
 #include "VoiceControlGoalGenerator.hpp"
 
+#include <algorithm>
+#include <cmath>
+
+#include "engine/core/time.hpp"
+#include "engine/gems/state/io.hpp"
 #include "messages/math.hpp"
+#include "messages/state/differential_base.hpp"
 
 namespace isaac
 {
 
+namespace
+{
+
+// Speed at time `t` of a trapezoidal profile covering `distance` with the given limits, 0 after
+// the end. The profile is triangular if the distance is too short to reach the maximum speed.
+double TrapezoidSpeed(double distance, double max_speed, double acceleration, double t)
+{
+  const double length = std::abs(distance);
+  if (length == 0.0 || max_speed <= 0.0 || acceleration <= 0.0 || t < 0.0)
+  {
+    return 0.0;
+  }
+  const double peak = std::min(max_speed, std::sqrt(length * acceleration));
+  const double ramp = peak / acceleration;
+  const double cruise = (length - peak * ramp) / peak;
+  const double end = 2.0 * ramp + cruise;
+  double speed = 0.0;
+  if (t < ramp)
+    speed = acceleration * t;
+  else if (t < ramp + cruise)
+    speed = peak;
+  else if (t < end)
+    speed = acceleration * (end - t);
+  return std::copysign(speed, distance);
+}
+
+} // namespace
+
 void VoiceControlGoalGenerator::start()
 {
-  tickOnMessage(rx_detected_command());
+  ASSERT(get_action_ids().size() == get_action_goals().size(), "action_ids and action_goals differ in size");
+  // the profile is sampled and navigation commands are forwarded on every tick
+  tickPeriodically();
+}
+
+void VoiceControlGoalGenerator::stop()
+{
+  tick_latency_.dump(full_name());
+  std::string name = full_name();
+  std::replace(name.begin(), name.end(), '/', '.');
+  latency_.writeToFile("/tmp/latency_voice_" + name + ".txt");
 }
 
-void VoiceControlGoalGenerator::publish_goal(Pose2d pose)
+void VoiceControlGoalGenerator::publish_goal(Pose2d pose, int64_t acqtime)
 {
   auto goal_proto = tx_goal().initProto();
   goal_proto.setStopRobot(false);
   goal_proto.setTolerance(0.1);
   goal_proto.setGoalFrame("robot");
   ToProto(pose, goal_proto.initGoal());
-  tx_goal().publish();
+  // the goal is relative to the robot at the time of the detection, the robot may already be
+  // turning by the time the planner gets it
+  tx_goal().publish(acqtime);
 }
 
-void VoiceControlGoalGenerator::tick()
+void VoiceControlGoalGenerator::publishCommand(double linear_speed, double angular_speed)
 {
+  messages::DifferentialBaseControl command;
+  command.linear_speed() = linear_speed;
+  command.angular_speed() = angular_speed;
+  ToProto(command, tx_command().initProto(), tx_command().buffers());
+  tx_command().publish();
+}
+
+void VoiceControlGoalGenerator::handleCommand(int id, int64_t detection_time)
+{
+  const std::vector<int> ids = get_action_ids();
+  const auto it = std::find(ids.begin(), ids.end(), id);
+  if (it == ids.end())
+  {
+    return;
+  }
+  const Vector3d goal = get_action_goals()[it - ids.begin()];
+  LOG_INFO("Command %d: goal (%f, %f, %f)", id, goal[0], goal[1], goal[2]);
+  publish_goal(Pose2d::FromXYA(goal[0], goal[1], goal[2]), detection_time);
+
+  const int64_t now = node()->clock()->timestamp();
+  latency_.record(kDetectionToGoal, now - detection_time);
+  pending_detection_ = detection_time;
+  pending_command_ = true;
+  pending_motion_ = true;
 
-  if (rx_detected_command().available())
+  profile_running_ = get_immediate_reaction();
+  if (profile_running_)
   {
-    auto proto = rx_detected_command().getProto();
-    int id = proto.getCommandId();
-    switch (id)
+    profile_start_ = now;
+    profile_angle_ = goal[2];
+    // sideways offsets are left to the planner
+    profile_distance_ = goal[0];
+  }
+}
+
+void VoiceControlGoalGenerator::updateCommand(int64_t now)
+{
+  if (profile_running_)
+  {
+    bool planner_active = false;
+    if (rx_navigation_command().available() && rx_navigation_command().acqtime() > profile_start_)
     {
-    case 1:
-      LOG_INFO("Go Left");
-      publish_goal(Pose2d::Rotation(M_PI_2));
-      break;
-    case 2:
-      LOG_INFO("Go Right");
-      publish_goal(Pose2d::Rotation(-M_PI_2));
-      break;
-    default:
-      break;
+      messages::DifferentialBaseControl navigation;
+      if (FromProto(rx_navigation_command().getProto(), rx_navigation_command().buffers(), navigation))
+      {
+        planner_active = std::abs(navigation.linear_speed()) > get_handoff_linear_speed() ||
+                         std::abs(navigation.angular_speed()) > get_handoff_angular_speed();
+      }
     }
+    const double t = ToSeconds(now - profile_start_);
+    const double angular =
+        TrapezoidSpeed(profile_angle_, get_max_angular_speed(), get_max_angular_acceleration(), t);
+    const double linear =
+        TrapezoidSpeed(profile_distance_, get_max_linear_speed(), get_max_linear_acceleration(), t);
+    if (planner_active || (angular == 0.0 && linear == 0.0))
+    {
+      // the planner took over or the profile ended
+      profile_running_ = false;
+      show("handoff time (s)", t);
+    }
+    else
+    {
+      publishCommand(linear, angular);
+      if (pending_command_)
+      {
+        latency_.record(kDetectionToCommand, now - pending_detection_);
+        pending_command_ = false;
+      }
+      return;
+    }
+  }
+
+  // forward every new navigation command
+  rx_navigation_command().processLatestNewMessage([this, now](auto proto, int64_t pubtime, int64_t acqtime) {
+    messages::DifferentialBaseControl navigation;
+    if (!FromProto(proto, rx_navigation_command().buffers(), navigation))
+    {
+      return;
+    }
+    publishCommand(navigation.linear_speed(), navigation.angular_speed());
+    if (pending_command_ && (std::abs(navigation.linear_speed()) > get_handoff_linear_speed() ||
+                             std::abs(navigation.angular_speed()) > get_handoff_angular_speed()))
+    {
+      latency_.record(kDetectionToCommand, now - pending_detection_);
+      pending_command_ = false;
+    }
+  });
+}
+
+void VoiceControlGoalGenerator::updateMotion(int64_t now)
+{
+  if (!pending_motion_)
+  {
+    return;
+  }
+  rx_base_state().processLatestNewMessage([this, now](auto proto, int64_t pubtime, int64_t acqtime) {
+    messages::DifferentialBaseDynamics state;
+    if (!FromProto(proto, rx_base_state().buffers(), state))
+    {
+      return;
+    }
+    if (std::abs(state.linear_speed()) > get_motion_linear_speed() ||
+        std::abs(state.angular_speed()) > get_motion_angular_speed())
+    {
+      latency_.record(kDetectionToMotion, now - pending_detection_);
+      pending_motion_ = false;
+    }
+  });
+}
+
+void VoiceControlGoalGenerator::tick()
+{
+  const auto timer = tick_latency_.measure();
+  tick_latency_.report(getTickTime(), [this](const char *tag, double value) { show(tag, value); });
+  latency_.report(getTickTime(), [this](const char *tag, double value) { show(tag, value); });
+
+  const int64_t now = node()->clock()->timestamp();
+  if (rx_detected_command().available() && rx_detected_command().acqtime() != last_detection_acqtime_)
+  {
+    last_detection_acqtime_ = rx_detected_command().acqtime();
+    handleCommand(rx_detected_command().getProto().getCommandId(), last_detection_acqtime_);
   }
+  updateCommand(now);
+  updateMotion(now);
 
   // Process feedback
   rx_feedback().processLatestNewMessage(
@@ -1,26 +1,93 @@
 #pragma once
 
+#include <cmath>
 #include <string>
+#include <vector>
 
 #include "engine/alice/alice.hpp"
 #include "messages/messages.hpp"
+#include "packages/instrumentation/LatencyBreakdown.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
 
 namespace isaac
 {
 
+// Turns voice commands into navigation goals. What a command does is configured with the parallel
+// lists action_ids and action_goals, like the command lists of VoiceCommandConstruction.
+//
+// Navigation commands are routed through this codelet. In immediate reaction mode a detected
+// command also starts a speed profile towards the goal right away, which moves the robot while the
+// planner still works on the new goal; once the planner commands motion it takes over again.
 class VoiceControlGoalGenerator : public alice::Codelet
 {
 public:
   void start() override;
   void tick() override;
+  void stop() override;
 
   ISAAC_PROTO_RX(VoiceCommandDetectionProto, detected_command);
-  
+
   ISAAC_PROTO_TX(Goal2Proto, goal);
   ISAAC_PROTO_RX(Goal2FeedbackProto, feedback);
 
+  // Commands of the navigation stack, forwarded to command unless a profile is running
+  ISAAC_PROTO_RX(StateProto, navigation_command);
+  // Speeds reported by the base, used to measure when the robot starts moving
+  ISAAC_PROTO_RX(StateProto, base_state);
+  // Commands for the base
+  ISAAC_PROTO_TX(StateProto, command);
+
+  // Voice command ids which trigger an action
+  ISAAC_PARAM(std::vector<int>, action_ids, std::vector<int>({1, 2}));
+  // Goal of every action as (x, y, angle) in the robot frame
+  ISAAC_PARAM(std::vector<Vector3d>, action_goals,
+              std::vector<Vector3d>({Vector3d(0.0, 0.0, M_PI_2), Vector3d(0.0, 0.0, -M_PI_2)}));
+  // If enabled a speed profile towards the goal starts immediately
+  ISAAC_PARAM(bool, immediate_reaction, true);
+  // Limits of the immediate profile
+  ISAAC_PARAM(double, max_angular_speed, 0.6);
+  ISAAC_PARAM(double, max_angular_acceleration, 2.0);
+  ISAAC_PARAM(double, max_linear_speed, 0.2);
+  ISAAC_PARAM(double, max_linear_acceleration, 0.5);
+  // Navigation commands with a speed above these take over from the profile
+  ISAAC_PARAM(double, handoff_linear_speed, 0.01);
+  ISAAC_PARAM(double, handoff_angular_speed, 0.02);
+  // The base is considered moving above these speeds
+  ISAAC_PARAM(double, motion_linear_speed, 0.01);
+  ISAAC_PARAM(double, motion_angular_speed, 0.05);
+
 private:
-  void publish_goal(Pose2d);
+  // Hops of the detection to motion latency
+  enum LatencyHop
+  {
+    kDetectionToGoal,
+    kDetectionToCommand,
+    kDetectionToMotion
+  };
+
+  // Starts the action of a detected command
+  void handleCommand(int id, int64_t detection_time);
+  void publish_goal(Pose2d, int64_t acqtime);
+  // Publishes a speed command
+  void publishCommand(double linear_speed, double angular_speed);
+  // Publishes the profile or forwards the navigation command
+  void updateCommand(int64_t now);
+  // Records when the robot started moving after a detection
+  void updateMotion(int64_t now);
+
+  int64_t last_detection_acqtime_ = -1;
+  // running profile, rotation and forward motion are independent trapezoids
+  bool profile_running_ = false;
+  int64_t profile_start_ = 0;
+  double profile_angle_ = 0.0;
+  double profile_distance_ = 0.0;
+  // detection whose latency is still being measured
+  int64_t pending_detection_ = -1;
+  bool pending_command_ = false;
+  bool pending_motion_ = false;
+
+  ev3::LatencyBreakdown latency_{{"detection to goal", "detection to command", "detection to motion"}};
+  ev3::TickLatency tick_latency_;
 };
 
 } // namespace isaac
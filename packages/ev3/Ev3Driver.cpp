@@ -1,4 +1,10 @@
 #include "Ev3Driver.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
 #include "packages/ev3/ev3dev/ev3control.capnp.h"
 #include "engine/alice/components/Failsafe.hpp"
 #include "engine/gems/state/io.hpp"
@@ -7,16 +13,52 @@
 namespace isaac
 {
 
-::kj::Promise<void> sendCommand(double linearSpeed, double angularSpeed, Ev3Control::Client *ev3Control);
+using OnApplied = std::function<void(Applied::Reader)>;
+
+// Sends a speed command. If `trace_id` is not 0 the trace is attached to the command and
+// `on_applied` is called with the reply of the brick.
+::kj::Promise<void> sendCommand(double linearSpeed, double angularSpeed, Ev3Control::Client *ev3Control,
+                                uint64_t trace_id = 0, int64_t origin_time = 0, int64_t sent_time = 0,
+                                OnApplied on_applied = nullptr);
 
 void Ev3Driver::start()
 {
     failsafe_ = node()->getComponent<alice::Failsafe>();
+    if (!get_record_path().empty())
+    {
+        if (recorder_.open(get_record_path()))
+        {
+            LOG_INFO("Recording EV3 traffic to %s", get_record_path().c_str());
+        }
+        else
+        {
+            LOG_ERROR("Could not create %s, not recording", get_record_path().c_str());
+        }
+    }
     tickBlocking();
 }
 
 void Ev3Driver::tick()
 {
+    const auto timer = tick_latency_.measure();
+    tick_latency_.report(getTickTime(), [this](const char *tag, double value) { show(tag, value); });
+    if (get_enable_tracing())
+    {
+        trace_latency_.report(getTickTime(), [this](const char *tag, double value) { show(tag, value); });
+    }
+    // every new scan starts a trace, a scan which was not reacted to yet is dropped
+    if (rx_trace_scan().available() && rx_trace_scan().acqtime() != trace_acqtime_)
+    {
+        trace_id_++;
+        trace_open_ = true;
+        trace_acqtime_ = rx_trace_scan().acqtime();
+        trace_pubtime_ = rx_trace_scan().pubtime();
+        if (recorder_.isOpen())
+        {
+            recordScan();
+        }
+    }
+
     capnp::EzRpcClient client(get_address(), get_port());
     Ev3Control::Client ev3Control = client.getMain<Ev3Control>();
     auto &waitScope = client.getWaitScope();
@@ -29,10 +71,36 @@ void Ev3Driver::tick()
         // {
         //     LOG_DEBUG("CMD available ls=%F as=%F", command.linear_speed(), command.angular_speed());
         // }
+        if (recorder_.isOpen())
+        {
+            const ev3::CommandRecord record{command.linear_speed(), command.angular_speed()};
+            recorder_.append(ev3::kCommandRecord, node()->clock()->timestamp(), &record, sizeof(record));
+        }
 
-        auto safeCmdPromise = sendCommand(command.linear_speed(), command.angular_speed(), &ev3Control);
-
-        safeCmdPromise.wait(waitScope);
+        // the command is sent on every tick until the next one arrives; only one published after
+        // the scan can be a reaction to it, older ones were computed from earlier scans
+        const int64_t command_pubtime = rx_ev3_cmd().pubtime();
+        if (get_enable_tracing() && trace_open_ && command_pubtime >= trace_pubtime_ &&
+            rx_ev3_cmd().acqtime() >= trace_acqtime_)
+        {
+            trace_open_ = false;
+            const uint64_t id = trace_id_;
+            const int64_t acqtime = trace_acqtime_;
+            const int64_t pubtime = trace_pubtime_;
+            const int64_t sent_time = node()->clock()->timestamp();
+            auto safeCmdPromise = sendCommand(command.linear_speed(), command.angular_speed(), &ev3Control,
+                                              id, acqtime, sent_time,
+                                              [=](Applied::Reader applied) {
+                                                  recordTrace(id, acqtime, pubtime, command_pubtime, sent_time,
+                                                              applied);
+                                              });
+            safeCmdPromise.wait(waitScope);
+        }
+        else
+        {
+            auto safeCmdPromise = sendCommand(command.linear_speed(), command.angular_speed(), &ev3Control);
+            safeCmdPromise.wait(waitScope);
+        }
     }
 
     {
@@ -48,6 +116,12 @@ void Ev3Driver::tick()
 
                 ToProto(ev3_state, tx_ev3_state().initProto(), tx_ev3_state().buffers());
                 tx_ev3_state().publish();
+                if (recorder_.isOpen())
+                {
+                    const ev3::StateRecord record{ev3_state.linear_speed(), ev3_state.angular_speed(),
+                                                  ev3_state.linear_acceleration(), ev3_state.angular_acceleration()};
+                    recorder_.append(ev3::kStateRecord, node()->clock()->timestamp(), &record, sizeof(record));
+                }
                 return; },[](kj::Exception &&exception) {
                                                       LOG_ERROR("state %s", exception.getDescription());
                                                       return;
@@ -56,6 +130,13 @@ void Ev3Driver::tick()
         safeStatePromise.wait(waitScope);
     }
 
+    updateWheelGains(ev3Control, waitScope);
+    if (tracking_supported_ && get_tracking_period() > 0.0 && getTickTime() >= next_tracking_time_)
+    {
+        next_tracking_time_ = getTickTime() + get_tracking_period();
+        showTracking(ev3Control, waitScope);
+    }
+
     // stop robot if the failsafe is triggered
     if (!failsafe_->isAlive())
     {
@@ -64,7 +145,104 @@ void Ev3Driver::tick()
     }
 }
 
-::kj::Promise<void> sendCommand(double linearSpeed, double angularSpeed, Ev3Control::Client *ev3Control)
+void Ev3Driver::updateWheelGains(Ev3Control::Client &ev3Control, kj::WaitScope &waitScope)
+{
+    const std::vector<double> gains = get_wheel_gains();
+    if (gains.empty() || gains == wheel_gains_)
+    {
+        return;
+    }
+    wheel_gains_ = gains;
+    if (gains.size() != 5)
+    {
+        LOG_ERROR("wheel_gains needs 5 values [kp, ki, kff, friction, integral_limit], got %zu", gains.size());
+        return;
+    }
+    auto request = ev3Control.setGainsRequest();
+    auto builder = request.initGains();
+    builder.setKp(gains[0]);
+    builder.setKi(gains[1]);
+    builder.setKff(gains[2]);
+    builder.setFriction(gains[3]);
+    builder.setIntegralLimit(gains[4]);
+    request.send()
+        .then([](capnp::Response<Ev3Control::SetGainsResults> response) {
+            auto applied = response.getGains();
+            LOG_INFO("Wheel gains kp=%f ki=%f kff=%f friction=%f integral_limit=%f", applied.getKp(),
+                     applied.getKi(), applied.getKff(), applied.getFriction(), applied.getIntegralLimit());
+        },
+              [](kj::Exception &&exception) { LOG_ERROR("setGains %s", exception.getDescription()); })
+        .wait(waitScope);
+}
+
+void Ev3Driver::showTracking(Ev3Control::Client &ev3Control, kj::WaitScope &waitScope)
+{
+    auto request = ev3Control.trackingRequest();
+    request.setReset(true);
+    request.send()
+        .then([this](capnp::Response<Ev3Control::TrackingResults> response) {
+            auto tracking = response.getTracking();
+            show("wheel.left.rms_error", tracking.getLeft().getRmsError());
+            show("wheel.left.max_error", tracking.getLeft().getMaxError());
+            show("wheel.left.duty", tracking.getLeft().getDuty());
+            show("wheel.right.rms_error", tracking.getRight().getRmsError());
+            show("wheel.right.max_error", tracking.getRight().getMaxError());
+            show("wheel.right.duty", tracking.getRight().getDuty());
+            show("wheel.overruns", static_cast<double>(tracking.getOverruns()));
+        },
+              [this](kj::Exception &&exception) {
+                  LOG_WARNING("No wheel velocity loop on the brick, not showing tracking: %s",
+                              exception.getDescription());
+                  tracking_supported_ = false;
+              })
+        .wait(waitScope);
+}
+
+void Ev3Driver::recordScan()
+{
+    auto scan = rx_trace_scan().getProto();
+    auto ranges = scan.getRanges();
+    auto angles = scan.getAngles();
+    const uint32_t count = std::min(ranges.size(), angles.size());
+    // ranges first, then angles, as one payload
+    scan_buffer_.resize(2 * count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        scan_buffer_[i] = ranges[i];
+        scan_buffer_[count + i] = angles[i];
+    }
+    const ev3::FlatscanRecord record{trace_acqtime_, scan.getInvalidRangeThreshold(), scan.getOutOfRangeThreshold(),
+                                     count, 0};
+    recorder_.append(ev3::kFlatscanRecord, node()->clock()->timestamp(), &record, sizeof(record),
+                     scan_buffer_.data(), scan_buffer_.size() * sizeof(float));
+}
+
+void Ev3Driver::recordTrace(uint64_t id, int64_t origin_time, int64_t scan_published, int64_t command_published,
+                            int64_t sent_time, Applied::Reader applied)
+{
+    if (id == last_recorded_trace_ || applied.getTraceId() != id)
+    {
+        return;
+    }
+    last_recorded_trace_ = id;
+    const int64_t received_time = node()->clock()->timestamp();
+    // the brick has its own clock, only durations measured on it are comparable with ours
+    const int64_t apply = applied.getAppliedTime() - applied.getReceivedTime();
+    // half of the round trip which was not spent on the brick
+    const int64_t link = std::max<int64_t>(0, (received_time - sent_time - apply) / 2);
+    // lidar driver and LidarAngleChanger
+    trace_latency_.record(kScanToPublish, scan_published - origin_time);
+    // local map, planner and controller, up to the command which reacted to the scan
+    trace_latency_.record(kPlanner, command_published - scan_published);
+    // until Ev3Driver picked the command up in its blocking tick
+    trace_latency_.record(kDriverPickup, sent_time - command_published);
+    trace_latency_.record(kLink, link);
+    trace_latency_.record(kApply, apply);
+    trace_latency_.record(kTotal, sent_time - origin_time + link + apply);
+}
+
+::kj::Promise<void> sendCommand(double linearSpeed, double angularSpeed, Ev3Control::Client *ev3Control,
+                                uint64_t trace_id, int64_t origin_time, int64_t sent_time, OnApplied on_applied)
 {
     ::capnp::MallocMessageBuilder message;
 
@@ -73,8 +251,20 @@ void Ev3Driver::tick()
     cmd.setLinearSpeed(linearSpeed);
     cmd.setAngularSpeed(angularSpeed);
     request.setCmd(cmd);
+    if (trace_id != 0)
+    {
+        auto trace = request.initTrace();
+        trace.setId(trace_id);
+        trace.setOriginTime(origin_time);
+        trace.setSentTime(sent_time);
+    }
 
-    auto cmdPromise = request.send().ignoreResult();
+    auto cmdPromise = request.send().then([on_applied](capnp::Response<Ev3Control::CommandResults> response) {
+        if (on_applied)
+        {
+            on_applied(response.getApplied());
+        }
+    });
 
     auto safeCmdPromise = cmdPromise.catch_([](kj::Exception &&exception) {
         LOG_ERROR("command %s", exception.getDescription());
@@ -86,6 +276,14 @@ void Ev3Driver::tick()
 
 void Ev3Driver::stop()
 {
+    tick_latency_.dump(full_name());
+    recorder_.close();
+    if (get_enable_tracing())
+    {
+        std::string name = full_name();
+        std::replace(name.begin(), name.end(), '/', '.');
+        trace_latency_.writeToFile("/tmp/latency_trace_" + name + ".txt");
+    }
     capnp::EzRpcClient client(get_address(), get_port());
     Ev3Control::Client ev3Control = client.getMain<Ev3Control>();
     auto &waitScope = client.getWaitScope();
@@ -4,8 +4,14 @@
 #include "messages/messages.hpp"
 #include <capnp/ez-rpc.h>
 #include <capnp/message.h>
+#include <string>
+#include <vector>
 
 #include "packages/ev3/ev3dev/ev3control.capnp.h"
+#include "packages/ev3/recording/Ev3Records.hpp"
+#include "packages/ev3/recording/RecordLog.hpp"
+#include "packages/instrumentation/LatencyBreakdown.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
 
 namespace isaac
 {
@@ -25,14 +31,67 @@ public:
     void stop() override;
 
     ISAAC_PROTO_RX(StateProto, ev3_cmd);
+    // Scans which start latency traces, e.g. the output of LidarAngleChanger, which keeps the
+    // acquisition time of the lidar scan. They are also recorded if recording is enabled.
+    ISAAC_PROTO_RX(FlatscanProto, trace_scan);
 
     ISAAC_PROTO_TX(StateProto, ev3_state);
 
     ISAAC_PARAM(std::string, address, "localhost");
     ISAAC_PARAM(int, port, 9000);
+    // If enabled the first command published after a trace scan is tagged with it and the latency
+    // from the scan acquisition to the motor setpoint write is reported per hop
+    ISAAC_PARAM(bool, enable_tracing, false);
+    // If not empty commands, states and trace scans are recorded to this file. It can be replayed
+    // with ev3_replay_server and FlatscanReplay.
+    ISAAC_PARAM(std::string, record_path, "");
+    // Gains of the wheel velocity loop on the brick as [kp, ki, kff, friction, integral_limit], see
+    // WheelGains. The brick keeps its defaults if empty.
+    ISAAC_PARAM(std::vector<double>, wheel_gains, std::vector<double>());
+    // Period in seconds at which the tracking of the wheel velocity loop is shown, 0 to disable
+    ISAAC_PARAM(double, tracking_period, 1.0);
 
 private:
+    // Hops of a trace, see recordTrace
+    enum TraceHop {
+        kScanToPublish,
+        kPlanner,
+        kDriverPickup,
+        kLink,
+        kApply,
+        kTotal
+    };
+    // Sends the wheel gains to the brick if they changed
+    void updateWheelGains(Ev3Control::Client &ev3Control, kj::WaitScope &waitScope);
+    // Shows the tracking of the wheel velocity loop and starts a new measurement
+    void showTracking(Ev3Control::Client &ev3Control, kj::WaitScope &waitScope);
+    // Appends the latest trace scan to the recording
+    void recordScan();
+    // Adds the latencies of a command which was applied by the brick
+    void recordTrace(uint64_t id, int64_t origin_time, int64_t scan_published, int64_t command_published,
+                     int64_t sent_time, Applied::Reader applied);
+
     alice::Failsafe* failsafe_;
+    // latest trace scan, a new trace id is given to every new scan
+    uint64_t trace_id_ = 0;
+    int64_t trace_acqtime_ = 0;
+    int64_t trace_pubtime_ = 0;
+    // the trace of the latest scan waits for the first command published after the scan, which is
+    // the earliest one which can react to it
+    bool trace_open_ = false;
+    uint64_t last_recorded_trace_ = 0;
+    // gains last sent to the brick
+    std::vector<double> wheel_gains_;
+    double next_tracking_time_ = 0.0;
+    // false if the server has no velocity loop, e.g. ev3_replay_server
+    bool tracking_supported_ = true;
+    ev3::RecordLogWriter recorder_;
+    std::vector<float> scan_buffer_;
+    ev3::LatencyBreakdown trace_latency_{
+        {"scan to publish", "scan publish to command publish", "command publish to send", "link", "apply",
+         "scan to motor"}};
+    // duration of a command and state round trip
+    ev3::TickLatency tick_latency_;
 };
 } // namespace isaac
 
@@ -0,0 +1,81 @@
+#include "FlatscanReplay.hpp"
+
+#include "packages/ev3/recording/Ev3Records.hpp"
+
+namespace isaac
+{
+
+void FlatscanReplay::start()
+{
+    if (!log_.open(get_path()))
+    {
+        LOG_ERROR("Could not open session log '%s'", get_path().c_str());
+        return;
+    }
+    speed_ = get_speed();
+    ASSERT(speed_ > 0.0, "Replay speed must be positive");
+    origin_ = ev3::SessionOrigin(log_);
+    started_ = false;
+    tickPeriodically();
+}
+
+void FlatscanReplay::tick()
+{
+    const auto timer = tick_latency_.measure();
+    tick_latency_.report(getTickTime(), [this](const char *tag, double value) { show(tag, value); });
+    if (!started_)
+    {
+        if (!rx_ev3_cmd().available())
+        {
+            return;
+        }
+        // Ev3Driver sends the command to ev3_replay_server right after it was published
+        start_time_ = rx_ev3_cmd().pubtime();
+        started_ = true;
+    }
+    const int64_t session_time =
+        ev3::SessionTime(origin_, node()->clock()->timestamp() - start_time_, speed_);
+    for (; next_ < log_.size(); next_++)
+    {
+        const auto record = log_.record(next_);
+        if (record.timestamp > session_time)
+        {
+            break;
+        }
+        if (record.type != ev3::kFlatscanRecord || record.size < sizeof(ev3::FlatscanRecord))
+        {
+            continue;
+        }
+        const auto *scan = reinterpret_cast<const ev3::FlatscanRecord *>(record.data);
+        // ranges and angles follow the header, skip records which are too short for them
+        if (sizeof(ev3::FlatscanRecord) + 2 * sizeof(float) * uint64_t(scan->count) > record.size)
+        {
+            LOG_WARNING("Skipping a flatscan record of %u bytes with %u beams", record.size, scan->count);
+            continue;
+        }
+        const float *ranges = reinterpret_cast<const float *>(record.data + sizeof(ev3::FlatscanRecord));
+        const float *angles = ranges + scan->count;
+
+        auto proto = tx_flatscan().initProto();
+        proto.setInvalidRangeThreshold(scan->invalid_range_threshold);
+        proto.setOutOfRangeThreshold(scan->out_of_range_threshold);
+        auto proto_ranges = proto.initRanges(scan->count);
+        auto proto_angles = proto.initAngles(scan->count);
+        for (uint32_t i = 0; i < scan->count; i++)
+        {
+            proto_ranges.set(i, ranges[i]);
+            proto_angles.set(i, angles[i]);
+        }
+        const int64_t acqtime =
+            start_time_ + static_cast<int64_t>((scan->acqtime - origin_) / speed_);
+        tx_flatscan().publish(acqtime);
+    }
+}
+
+void FlatscanReplay::stop()
+{
+    tick_latency_.dump(full_name());
+    log_.close();
+}
+
+} // namespace isaac
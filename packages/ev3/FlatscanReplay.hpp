@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+
+#include "engine/alice/alice_codelet.hpp"
+#include "messages/messages.hpp"
+#include "packages/ev3/recording/RecordLog.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
+
+namespace isaac
+{
+// Publishes the flatscans of a session recorded by Ev3Driver, for example together with
+// ev3_replay_server to run the stack without the robot. Like ev3_replay_server the session starts at
+// the first record of the log when the first command is published, thus `ev3_cmd` has to receive the
+// commands sent to Ev3Driver. It runs `speed` times faster than recorded; acquisition times are
+// shifted into the app clock accordingly.
+class FlatscanReplay : public isaac::alice::Codelet
+{
+public:
+    void start() override;
+    void tick() override;
+    void stop() override;
+
+    // Commands for Ev3Driver, the first one starts the session
+    ISAAC_PROTO_RX(StateProto, ev3_cmd);
+    // Recorded scans
+    ISAAC_PROTO_TX(FlatscanProto, flatscan);
+
+    // Session log written by Ev3Driver
+    ISAAC_PARAM(std::string, path, "");
+    // Replay speed relative to the recording
+    ISAAC_PARAM(double, speed, 1.0);
+
+private:
+    ev3::RecordLogReader log_;
+    size_t next_ = 0;
+    // recorded time of the session start, see SessionOrigin
+    int64_t origin_ = 0;
+    // app time of the first command
+    int64_t start_time_ = 0;
+    bool started_ = false;
+    double speed_ = 1.0;
+    ev3::TickLatency tick_latency_;
+};
+} // namespace isaac
+
+ISAAC_ALICE_REGISTER_CODELET(isaac::FlatscanReplay);
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+namespace isaac {
+namespace ev3 {
+
+// Geometry of a differential base driven by two EV3 large motors. Wheel speeds are in tacho
+// counts per second.
+struct Ev3Geometry {
+  // Meters travelled by a wheel per tacho count
+  float tacho_to_speed;
+  // Distance between the wheels in meters
+  float base_length;
+  // Fastest wheel speed
+  int max_speed;
+};
+
+// The tank run by ev3_control_server and the robot simulated by ev3_mock_server
+constexpr Ev3Geometry kEv3Tank{0.00026f, 0.156f, 900};
+constexpr Ev3Geometry kEv3Mock{0.000255f, 0.38f, 900};
+
+// Wheel speeds, e.g. the targets of a command
+struct WheelSpeeds {
+  int left;
+  int right;
+};
+
+// Speeds of the base
+struct BodySpeed {
+  float linear;
+  float angular;
+};
+
+// Wheel speed for a speed in m/s, truncated towards zero and not limited
+inline int SiToTacho(float speed, const Ev3Geometry& geometry) {
+  return static_cast<int>(speed / geometry.tacho_to_speed);
+}
+
+// Wheel speed limited to max_speed
+inline int LimitTacho(int speed, const Ev3Geometry& geometry) {
+  return std::abs(speed) > geometry.max_speed ? (speed < 0 ? -geometry.max_speed : geometry.max_speed)
+                                              : speed;
+}
+
+// Speed in m/s of a wheel speed
+inline float TachoToSi(int speed, const Ev3Geometry& geometry) {
+  return geometry.tacho_to_speed * speed;
+}
+
+// Wheel speeds which drive the base at the given speeds, not limited
+inline WheelSpeeds BodyToWheels(float linear, float angular, const Ev3Geometry& geometry) {
+  const float speed_diff = angular * geometry.base_length;
+  return {SiToTacho(linear - speed_diff / 2, geometry), SiToTacho(linear + speed_diff / 2, geometry)};
+}
+
+// Wheel speed from the change of its position over `elapsed_ms` milliseconds
+inline float TachoRate(int position_delta, float elapsed_ms) {
+  return position_delta / elapsed_ms * 1000;
+}
+
+// Speeds of the base for the given wheel speeds. The wheel speeds are truncated to whole tacho
+// counts first, like ev3_control_server always did.
+inline BodySpeed WheelsToBody(float left, float right, const Ev3Geometry& geometry) {
+  return {TachoToSi(static_cast<int>(right - (right - left) / 2), geometry),
+          TachoToSi(static_cast<int>(right - left), geometry) / geometry.base_length};
+}
+
+// Fixed-point versions of the conversions above for the ARM926EJ-S of the brick, which has no FPU:
+// every float operation there is a call into the soft-float library. ARMv5 has no divide
+// instruction either and 64-bit divisions are calls into __aeabi_ldivmod, thus these work on 32-bit
+// words: 32 x 32 bit products with a 64-bit result, which are a single SMULL, shifts, adds and one
+// 32-bit division per state request for the reciprocal of the elapsed time. The constants of a
+// geometry are normalized at compile time. Wheel speeds are within one tacho count of the float
+// versions, which kinematics_benchmark checks. ev3_control_server uses these.
+
+// A Q16.16 fixed-point number
+using Q16 = int32_t;
+
+// A positive constant as value * 2^-shift, with value in [2^29, 2^30)
+struct FixedConstant {
+  int32_t value;
+  int shift;
+};
+
+// Shift which brings `value` into [2^29, 2^30)
+constexpr int NormalizingShift(double value) {
+  int shift = 0;
+  while (value >= 1073741824.0) {
+    value /= 2.0;
+    shift--;
+  }
+  while (value < 536870912.0) {
+    value *= 2.0;
+    shift++;
+  }
+  return shift;
+}
+
+// `value` * 2^shift rounded to the nearest integer
+constexpr int32_t ScaleToInt32(double value, int shift) {
+  for (; shift > 0; shift--) {
+    value *= 2.0;
+  }
+  for (; shift < 0; shift++) {
+    value /= 2.0;
+  }
+  return static_cast<int32_t>(value + 0.5);
+}
+
+constexpr FixedConstant ToFixedConstant(double value) {
+  return {ScaleToInt32(value, NormalizingShift(value)), NormalizingShift(value)};
+}
+
+// Constants of an Ev3Geometry in fixed point
+struct Ev3FixedGeometry {
+  // Tacho counts of a wheel per meter of the base and per radian of its turn, both scaled by
+  // 2^wheel_shift, which normalizes the larger one
+  int32_t tacho_per_meter;
+  int32_t tacho_per_radian;
+  int wheel_shift;
+  // Meters per tacho count and radians of turn per tacho count of difference between the wheels
+  FixedConstant meters_per_tacho;
+  FixedConstant radians_per_tacho;
+  int max_speed;
+};
+
+constexpr double TachoPerMeter(const Ev3Geometry& geometry) {
+  return 1.0 / static_cast<double>(geometry.tacho_to_speed);
+}
+
+constexpr double TachoPerRadian(const Ev3Geometry& geometry) {
+  return static_cast<double>(geometry.base_length) / 2.0 / static_cast<double>(geometry.tacho_to_speed);
+}
+
+constexpr int WheelShift(const Ev3Geometry& geometry) {
+  return NormalizingShift(TachoPerMeter(geometry) > TachoPerRadian(geometry) ? TachoPerMeter(geometry)
+                                                                             : TachoPerRadian(geometry));
+}
+
+constexpr Ev3FixedGeometry ToFixed(const Ev3Geometry& geometry) {
+  return {ScaleToInt32(TachoPerMeter(geometry), WheelShift(geometry)),
+          ScaleToInt32(TachoPerRadian(geometry), WheelShift(geometry)), WheelShift(geometry),
+          ToFixedConstant(geometry.tacho_to_speed),
+          ToFixedConstant(static_cast<double>(geometry.tacho_to_speed) / geometry.base_length),
+          geometry.max_speed};
+}
+
+constexpr Ev3FixedGeometry kEv3TankFixed = ToFixed(kEv3Tank);
+
+// Product of two words, a single SMULL on ARMv5
+inline int64_t Multiply(int32_t a, int32_t b) {
+  return static_cast<int64_t>(a) * b;
+}
+
+// Shifts right with truncation towards zero like an integer division, an arithmetic shift rounds
+// negative values down
+inline int32_t ShiftTowardsZero(int32_t value, int shift) {
+  return value < 0 ? -(-value >> shift) : value >> shift;
+}
+
+inline int64_t ShiftTowardsZero(int64_t value, int shift) {
+  return value < 0 ? -(-value >> shift) : value >> shift;
+}
+
+// Converts a double, e.g. a capnp Float64 field, to Q16.16 by taking its bits apart, using the top
+// 32 bits of the mantissa. Rounds to nearest and saturates; NaN becomes 0.
+inline Q16 Q16FromDouble(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const uint32_t high = static_cast<uint32_t>(bits >> 32);
+  const uint32_t low = static_cast<uint32_t>(bits);
+  const int biased = static_cast<int>((high >> 20) & 0x7ff);
+  if (biased == 0x7ff && ((high & 0xfffff) | low) != 0) {
+    return 0;
+  }
+  // the value is mantissa * 2^(biased - 1054), in Q16.16 it is mantissa * 2^(biased - 1038)
+  const uint32_t mantissa = 0x80000000u | ((high & 0xfffff) << 11) | (low >> 21);
+  const int shift = 1038 - biased;
+  uint32_t magnitude;
+  if (biased == 0 || shift > 32) {
+    magnitude = 0;
+  } else if (shift == 32) {
+    // at least half of the least significant bit
+    magnitude = 1;
+  } else if (shift <= 0) {
+    // 2^15 or more does not fit
+    magnitude = 0x7fffffff;
+  } else {
+    // the bits below the rounding bit only matter for ties, which round up anyway
+    const uint32_t half_bits = mantissa >> (shift - 1);
+    magnitude = std::min<uint32_t>((half_bits >> 1) + (half_bits & 1), 0x7fffffff);
+  }
+  return static_cast<Q16>(high >> 31 ? 0u - magnitude : magnitude);
+}
+
+// Converts `value` * 2^-fraction_bits to a double, exactly for magnitudes below 2^53, by putting
+// its bits together
+inline double FixedToDouble(int64_t value, int fraction_bits) {
+  if (value == 0) {
+    return 0.0;
+  }
+  const uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+  uint32_t high = static_cast<uint32_t>(magnitude >> 32);
+  uint32_t low = static_cast<uint32_t>(magnitude);
+  // move the leading one to bit 31 of high, the position is a single CLZ instruction on ARMv5
+  int top;
+  if (high != 0) {
+    const int lead = __builtin_clz(high);
+    top = 63 - lead;
+    if (lead > 0) {
+      high = (high << lead) | (low >> (32 - lead));
+      low <<= lead;
+    }
+  } else {
+    const int lead = __builtin_clz(low);
+    top = 31 - lead;
+    high = low << lead;
+    low = 0;
+  }
+  const uint32_t sign = value < 0 ? 0x80000000u : 0u;
+  const uint32_t exponent = static_cast<uint32_t>(top - fraction_bits + 1023);
+  const uint64_t bits = static_cast<uint64_t>(sign | (exponent << 20) | ((high >> 11) & 0xfffff)) << 32 |
+                        ((high << 21) | (low >> 11));
+  double result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+inline double Q16ToDouble(Q16 value) {
+  return FixedToDouble(value, 16);
+}
+
+inline int LimitTachoFixed(int speed, const Ev3FixedGeometry& geometry) {
+  return std::abs(speed) > geometry.max_speed ? (speed < 0 ? -geometry.max_speed : geometry.max_speed)
+                                              : speed;
+}
+
+// See BodyToWheels. The products are below 2^61, thus their sum does not overflow.
+inline WheelSpeeds BodyToWheelsFixed(Q16 linear, Q16 angular, const Ev3FixedGeometry& geometry) {
+  const int64_t forward = Multiply(linear, geometry.tacho_per_meter);
+  const int64_t turn = Multiply(angular, geometry.tacho_per_radian);
+  const int shift = 16 + geometry.wheel_shift;
+  return {static_cast<int>(ShiftTowardsZero(forward - turn, shift)),
+          static_cast<int>(ShiftTowardsZero(forward + turn, shift))};
+}
+
+// Microseconds from `from` to `to`, two times of clock_gettime, 0 if the clock went backwards and
+// saturated at 2^32 - 1. The fields are 32 bits on the brick, thus no 64-bit division is involved.
+inline uint32_t ElapsedUs(const timespec& from, const timespec& to) {
+  const long seconds = to.tv_sec - from.tv_sec;
+  const long nanoseconds = to.tv_nsec - from.tv_nsec;
+  if (seconds < 0 || (seconds == 0 && nanoseconds <= 0)) {
+    return 0;
+  }
+  if (seconds >= 4294) {
+    return 0xffffffffu;
+  }
+  return static_cast<uint32_t>(seconds) * 1000000u + static_cast<int32_t>(nanoseconds / 1000);
+}
+
+// Tacho counts per second in Q16.16 per tacho count of position change over an elapsed time,
+// factor * 2^-shift with factor in [2^30, 2^31)
+struct TachoRateScale {
+  int32_t factor;
+  int shift;
+};
+
+// The scale of TachoRateFixed for `elapsed_us`, computed once per state request for both wheels.
+// 2^31 / elapsed_us is extended by long division to 31 significant bits, thus these are the only
+// divisions: one call to __aeabi_uidivmod and one to __aeabi_uidiv on ARMv5. The factor is rounded
+// up, which keeps whole tacho counts per second whole when TachoRateFixed truncates. Times below
+// 64 us count as 64 us.
+inline TachoRateScale ToTachoRateScale(uint32_t elapsed_us) {
+  const uint32_t divisor = std::max<uint32_t>(elapsed_us, 64);
+  const uint32_t quotient = 0x80000000u / divisor;
+  const uint32_t remainder = 0x80000000u % divisor;
+  // extra quotient bits, the remainder stays below 2^32 and the reciprocal below 2^31
+  const int extra = quotient == 0 ? __builtin_clz(divisor)
+                                  : std::min(__builtin_clz(divisor), __builtin_clz(quotient) - 1);
+  // 2^(31 + extra) / divisor
+  const uint32_t reciprocal = (quotient << extra) + (remainder << extra) / divisor;
+  const int64_t factor = Multiply(static_cast<int32_t>(reciprocal), 1000000);
+  // normalize the factor to 31 bits
+  const uint32_t high = static_cast<uint32_t>(factor >> 32);
+  const int down = high != 0 ? 33 - __builtin_clz(high) : (static_cast<uint32_t>(factor) >> 31 ? 1 : 0);
+  return {static_cast<int32_t>((factor >> down) + 1), 15 + extra - down};
+}
+
+// Fastest wheel speed TachoRateFixed reports in Q16.16. The EV3 large motor turns at about 1050
+// tacho counts per second, 16384 keeps the difference of two speeds in Q16.16.
+constexpr int64_t kMaxTachoRate = 16384 * 65536 - 1;
+
+// Wheel speed in Q16.16 tacho counts per second from the change of its position over the elapsed
+// time of `scale`, see TachoRate. Saturates at 16384 counts per second.
+inline Q16 TachoRateFixed(int position_delta, const TachoRateScale& scale) {
+  const int64_t rate = ShiftTowardsZero(Multiply(position_delta, scale.factor), scale.shift);
+  return static_cast<Q16>(std::max(-kMaxTachoRate, std::min(kMaxTachoRate, rate)));
+}
+
+// Speeds of the base in m/s and rad/s scaled by 2^shift of meters_per_tacho and radians_per_tacho
+struct BodySpeedFixed {
+  int64_t linear;
+  int64_t angular;
+};
+
+// See WheelsToBody
+inline BodySpeedFixed WheelsToBodyFixed(Q16 left, Q16 right, const Ev3FixedGeometry& geometry) {
+  // whole tacho counts, like the float version
+  const int32_t forward = ShiftTowardsZero(right - (right - left) / 2, 16);
+  const int32_t turn = ShiftTowardsZero(right - left, 16);
+  return {Multiply(forward, geometry.meters_per_tacho.value), Multiply(turn, geometry.radians_per_tacho.value)};
+}
+
+}  // namespace ev3
+}  // namespace isaac
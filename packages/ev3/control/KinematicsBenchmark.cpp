@@ -0,0 +1,216 @@
+// Measures the conversions which ev3_control_server does on every command and state request:
+// body speeds to limited wheel targets, and wheel positions to body speeds, in float and in fixed
+// point. The inputs are a fixed drive of 20 s with commands at 10 Hz and state requests at 100 Hz.
+// Exits with 1 if the fixed-point versions are more than one tacho count away from the float
+// versions. Build it with --config=ev3dev, which is arm-linux-gnueabi with soft-float, and run it
+// on the brick to see the cost of soft-float there.
+//
+//   kinematics_benchmark [--benchmark_out=PATH]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Ev3Kinematics.hpp"
+#include "packages/utils/Benchmark.hpp"
+
+using namespace isaac::ev3;
+
+namespace
+{
+
+constexpr int kCommands = 200;
+constexpr int kStates = 2000;
+
+// A command as it arrives in the Float64 fields of Control
+struct Command
+{
+  double linear, angular;
+};
+
+// Body speeds of a drive: a ramp, a hold, turns which exceed the wheel limit and a stop
+std::vector<Command> makeCommands()
+{
+  std::vector<Command> commands(kCommands);
+  for (int i = 0; i < kCommands; i++)
+  {
+    const double t = i / 10.0;
+    const double linear = t < 2.0 ? 0.1 * t : (t < 18.0 ? 0.2 : 0.0);
+    const double angular = t > 6.0 && t < 14.0 ? 2.5 * std::sin(0.8 * (t - 6.0)) : 0.0;
+    commands[i] = Command{linear, angular};
+  }
+  return commands;
+}
+
+// Position changes of both wheels between state requests and the time between them, with the
+// jitter of the scheduler
+struct PositionSample
+{
+  int left, right;
+  uint32_t elapsed_us;
+};
+
+std::vector<PositionSample> makeSamples(const std::vector<Command> &commands)
+{
+  std::vector<PositionSample> samples(kStates);
+  for (int i = 0; i < kStates; i++)
+  {
+    const Command &command = commands[i / 10];
+    const uint32_t elapsed_us = 10000 + int(700 * std::sin(1.3 * i));
+    const WheelSpeeds wheels = BodyToWheels(command.linear, command.angular, kEv3Tank);
+    samples[i] = PositionSample{int(LimitTacho(wheels.left, kEv3Tank) * int64_t(elapsed_us) / 1000000),
+                                int(LimitTacho(wheels.right, kEv3Tank) * int64_t(elapsed_us) / 1000000),
+                                elapsed_us};
+  }
+  return samples;
+}
+
+// Compares the fixed-point conversions with the float ones over the range the robot drives in.
+// Returns the number of failed checks.
+int checkFixedPoint()
+{
+  int failures = 0;
+  // conversions of capnp fields, exact up to rounding to nearest
+  int conversion_errors = 0;
+  for (int i = -200000; i <= 200000; i++)
+  {
+    const double value = i * 0.000123456789;
+    const Q16 fixed = Q16FromDouble(value);
+    conversion_errors += std::abs(fixed - std::lround(value * 65536.0)) > 0;
+    conversion_errors += Q16ToDouble(fixed) != fixed / 65536.0;
+    conversion_errors += FixedToDouble(int64_t(i) * 1234567891, 40) != i * 1234567891.0 / 1099511627776.0;
+  }
+  conversion_errors += Q16FromDouble(1e9) != 0x7fffffff || Q16FromDouble(-1e9) != -0x7fffffff;
+  conversion_errors += Q16FromDouble(std::nan("")) != 0 || Q16FromDouble(1e-30) != 0;
+  std::printf("double <-> Q16.16: %d errors\n", conversion_errors);
+  failures += conversion_errors > 0;
+
+  // wheel targets of commands in the range of the robot
+  size_t samples = 0, exact = 0;
+  int max_error = 0;
+  for (int i = -500; i <= 500; i++)
+  {
+    for (int j = -400; j <= 400; j++)
+    {
+      const double linear = 0.001 * i + 0.0000123 * j;
+      const double angular = 0.01 * j;
+      const WheelSpeeds reference = BodyToWheels(linear, angular, kEv3Tank);
+      const WheelSpeeds fixed = BodyToWheelsFixed(Q16FromDouble(linear), Q16FromDouble(angular), kEv3TankFixed);
+      const int error = std::max(std::abs(reference.left - fixed.left), std::abs(reference.right - fixed.right));
+      max_error = std::max(max_error, error);
+      exact += error == 0;
+      samples++;
+    }
+  }
+  std::printf("wheel targets: %zu of %zu identical, at most %d tacho counts apart\n", exact, samples, max_error);
+  failures += max_error > 1;
+
+  // body speeds of wheel positions, also over long times between state requests
+  samples = 0;
+  exact = 0;
+  double max_linear = 0.0, max_angular = 0.0;
+  std::vector<uint32_t> elapsed_times;
+  for (uint32_t elapsed_us = 8000; elapsed_us <= 12000; elapsed_us += 37)
+  {
+    elapsed_times.push_back(elapsed_us);
+  }
+  for (uint32_t elapsed_us = 100000; elapsed_us <= 2000000; elapsed_us += 100003)
+  {
+    elapsed_times.push_back(elapsed_us);
+  }
+  for (const uint32_t elapsed_us : elapsed_times)
+  {
+    const float elapsed_ms = elapsed_us / 1000.0f;
+    const TachoRateScale scale = ToTachoRateScale(elapsed_us);
+    // positions for up to 1000 tacho counts per second
+    const int range = std::max<int>(15, elapsed_us / 1000);
+    const int step = std::max(1, range / 15);
+    for (int left = -range; left <= range; left += step)
+    {
+      for (int right = -range; right <= range; right += step)
+      {
+        const BodySpeed reference =
+            WheelsToBody(TachoRate(left, elapsed_ms), TachoRate(right, elapsed_ms), kEv3Tank);
+        const BodySpeedFixed fixed = WheelsToBodyFixed(TachoRateFixed(left, scale),
+                                                       TachoRateFixed(right, scale), kEv3TankFixed);
+        const double linear =
+            std::abs(FixedToDouble(fixed.linear, kEv3TankFixed.meters_per_tacho.shift) - reference.linear);
+        const double angular =
+            std::abs(FixedToDouble(fixed.angular, kEv3TankFixed.radians_per_tacho.shift) - reference.angular);
+        // in tacho counts
+        max_linear = std::max(max_linear, linear / kEv3Tank.tacho_to_speed);
+        max_angular = std::max(max_angular, angular * kEv3Tank.base_length / kEv3Tank.tacho_to_speed);
+        // the same whole counts, up to the rounding of the float reference
+        exact += linear <= 1e-6 * std::abs(reference.linear) && angular <= 1e-6 * std::abs(reference.angular);
+        samples++;
+      }
+    }
+  }
+  std::printf("body speeds: %zu of %zu the same, at most %.2f and %.2f tacho counts apart\n", exact, samples,
+              max_linear, max_angular);
+  failures += max_linear > 1.01 || max_angular > 1.01;
+  return failures;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const std::string json_path = ParseBenchmarkOut(argc, argv);
+  const int failures = checkFixedPoint();
+  const std::vector<Command> commands = makeCommands();
+  const std::vector<PositionSample> samples = makeSamples(commands);
+
+  std::vector<BenchmarkResult> results;
+  results.push_back(RunBenchmark("si_to_tacho command",
+                                 [&] {
+                                   for (const Command &command : commands)
+                                   {
+                                     const WheelSpeeds wheels = BodyToWheels(command.linear, command.angular, kEv3Tank);
+                                     DoNotOptimize(LimitTacho(wheels.left, kEv3Tank));
+                                     DoNotOptimize(LimitTacho(wheels.right, kEv3Tank));
+                                   }
+                                 },
+                                 kCommands));
+  results.push_back(RunBenchmark("si_to_tacho command fixed",
+                                 [&] {
+                                   for (const Command &command : commands)
+                                   {
+                                     const WheelSpeeds wheels =
+                                         BodyToWheelsFixed(Q16FromDouble(command.linear),
+                                                           Q16FromDouble(command.angular), kEv3TankFixed);
+                                     DoNotOptimize(LimitTachoFixed(wheels.left, kEv3TankFixed));
+                                     DoNotOptimize(LimitTachoFixed(wheels.right, kEv3TankFixed));
+                                   }
+                                 },
+                                 kCommands));
+  results.push_back(RunBenchmark("tacho_to_si state",
+                                 [&] {
+                                   for (const PositionSample &sample : samples)
+                                   {
+                                     const float elapsed_ms = sample.elapsed_us / 1000.0f;
+                                     const BodySpeed body =
+                                         WheelsToBody(TachoRate(sample.left, elapsed_ms),
+                                                      TachoRate(sample.right, elapsed_ms), kEv3Tank);
+                                     DoNotOptimize(double(body.linear));
+                                     DoNotOptimize(double(body.angular));
+                                   }
+                                 },
+                                 kStates));
+  results.push_back(RunBenchmark("tacho_to_si state fixed",
+                                 [&] {
+                                   for (const PositionSample &sample : samples)
+                                   {
+                                     const TachoRateScale scale = ToTachoRateScale(sample.elapsed_us);
+                                     const BodySpeedFixed body =
+                                         WheelsToBodyFixed(TachoRateFixed(sample.left, scale),
+                                                           TachoRateFixed(sample.right, scale), kEv3TankFixed);
+                                     DoNotOptimize(FixedToDouble(body.linear, kEv3TankFixed.meters_per_tacho.shift));
+                                     DoNotOptimize(FixedToDouble(body.angular, kEv3TankFixed.radians_per_tacho.shift));
+                                   }
+                                 },
+                                 kStates));
+  const bool written = ReportBenchmarks(results, argv[0], json_path);
+  return failures == 0 && written ? 0 : 1;
+}
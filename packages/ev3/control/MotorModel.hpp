@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+#include "WheelVelocityLoop.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// A first order model of an EV3 large motor driven by a duty cycle: static friction eats part of
+// the duty cycle and the speed follows the rest with a time constant. Speeds are in tacho counts
+// per second.
+class MotorModel {
+ public:
+  struct Parameters {
+    // Speed per percent of duty cycle above friction
+    float gain = 10.5f;
+    float time_constant = 0.08f;
+    // Duty cycle lost to static friction and load
+    float friction = 5.0f;
+  };
+
+  MotorModel() = default;
+  explicit MotorModel(const Parameters& parameters) : parameters_(parameters) {}
+
+  void setDuty(float duty) { duty_ = std::max(-100.0f, std::min(100.0f, duty)); }
+
+  // Advances the motor by `dt` seconds
+  void advance(float dt) {
+    const float effective = std::copysign(std::max(0.0f, std::abs(duty_) - parameters_.friction), duty_);
+    const float steady = parameters_.gain * effective;
+    speed_ += (steady - speed_) * (1.0f - std::exp(-dt / parameters_.time_constant));
+    position_ += speed_ * dt;
+  }
+
+  float speed() const { return speed_; }
+  double position() const { return position_; }
+
+ private:
+  Parameters parameters_;
+  float duty_ = 0.0f;
+  float speed_ = 0.0f;
+  double position_ = 0.0;
+};
+
+// Two simulated motors as the wheels of a WheelVelocityLoop. In simulations `advance` is called
+// between the steps of the loop; with `real_time` the motors advance by the wall time that passed
+// whenever the speeds are read, e.g. in ev3_mock_server. Thread-safe.
+class SimulatedWheels : public WheelIo {
+ public:
+  explicit SimulatedWheels(bool real_time = false, const MotorModel::Parameters& left = {},
+                           const MotorModel::Parameters& right = {})
+      : real_time_(real_time), left_(left), right_(right), last_(std::chrono::steady_clock::now()) {}
+
+  void readSpeeds(float& left, float& right) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (real_time_) {
+      const auto now = std::chrono::steady_clock::now();
+      advanceLocked(std::chrono::duration<float>(now - last_).count());
+      last_ = now;
+    }
+    left = left_.speed();
+    right = right_.speed();
+  }
+
+  void writeDuty(float left, float right) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    left_.setDuty(left);
+    right_.setDuty(right);
+  }
+
+  void advance(float dt) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    advanceLocked(dt);
+  }
+
+  // Positions in tacho counts, rounded like the encoders
+  void positions(int& left, int& right) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    left = static_cast<int>(std::floor(left_.position()));
+    right = static_cast<int>(std::floor(right_.position()));
+  }
+
+ private:
+  void advanceLocked(float dt) {
+    left_.advance(dt);
+    right_.advance(dt);
+  }
+
+  const bool real_time_;
+  mutable std::mutex mutex_;
+  MotorModel left_;
+  MotorModel right_;
+  std::chrono::steady_clock::time_point last_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
@@ -0,0 +1,178 @@
+#include "WheelVelocityLoop.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+
+constexpr float kMaxDuty = 100.0f;
+
+} // namespace
+
+float WheelTracking::rmsError() const
+{
+  return samples == 0 ? 0.0f : static_cast<float>(std::sqrt(squared_error_sum / samples));
+}
+
+float WheelVelocityController::update(float target, float measured, float dt)
+{
+  tracking_.target = target;
+  tracking_.measured = measured;
+  const float error = target - measured;
+  tracking_.squared_error_sum += double(error) * error;
+  tracking_.max_error = std::max(tracking_.max_error, std::abs(error));
+  tracking_.samples++;
+
+  if (target == 0.0f)
+  {
+    integral_ = 0.0f;
+    tracking_.duty = 0.0f;
+    return 0.0f;
+  }
+  const float feed_forward = gains_.kff * target + std::copysign(gains_.friction, target);
+  const float unclamped = feed_forward + gains_.kp * error + integral_;
+  const float duty = std::max(-kMaxDuty, std::min(kMaxDuty, unclamped));
+  const bool saturated = duty != unclamped;
+  // only integrate if it does not push further into saturation
+  if (!saturated || (unclamped > 0.0f) != (error > 0.0f))
+  {
+    integral_ += gains_.ki * error * dt;
+    integral_ = std::max(-gains_.integral_limit, std::min(gains_.integral_limit, integral_));
+  }
+  if (saturated)
+  {
+    tracking_.saturated++;
+  }
+  tracking_.duty = duty;
+  return duty;
+}
+
+void WheelVelocityController::resetTracking()
+{
+  const WheelTracking last = tracking_;
+  tracking_ = WheelTracking();
+  tracking_.target = last.target;
+  tracking_.measured = last.measured;
+  tracking_.duty = last.duty;
+}
+
+WheelVelocityLoop::WheelVelocityLoop(WheelIo &io, double rate, double command_timeout)
+    : io_(io), period_(1.0 / rate), command_timeout_(command_timeout)
+{
+}
+
+void WheelVelocityLoop::start()
+{
+  if (running_)
+  {
+    return;
+  }
+  running_ = true;
+  thread_ = std::thread([this] { run(); });
+}
+
+void WheelVelocityLoop::stop()
+{
+  if (!running_)
+  {
+    return;
+  }
+  running_ = false;
+  thread_.join();
+  io_.writeDuty(0.0f, 0.0f);
+}
+
+void WheelVelocityLoop::setTargets(float left, float right)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  left_target_ = left;
+  right_target_ = right;
+  new_command_ = true;
+}
+
+void WheelVelocityLoop::setGains(const WheelGains &gains)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  left_.setGains(gains);
+  right_.setGains(gains);
+}
+
+WheelGains WheelVelocityLoop::gains() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return left_.gains();
+}
+
+WheelVelocityLoop::Tracking WheelVelocityLoop::tracking(bool reset)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  Tracking tracking{left_.tracking(), right_.tracking(), overruns_};
+  if (reset)
+  {
+    left_.resetTracking();
+    right_.resetTracking();
+    overruns_ = 0;
+  }
+  return tracking;
+}
+
+void WheelVelocityLoop::step(double dt, double now)
+{
+  // read the motors outside of the lock, on the brick this is sysfs and slow
+  float left_speed, right_speed;
+  io_.readSpeeds(left_speed, right_speed);
+  float left_duty, right_duty;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (new_command_)
+    {
+      command_time_ = now;
+      new_command_ = false;
+    }
+    // stop if the commands stopped, like run_timed did before
+    if (now - command_time_ > command_timeout_)
+    {
+      left_target_ = 0.0f;
+      right_target_ = 0.0f;
+    }
+    left_duty = left_.update(left_target_, left_speed, static_cast<float>(dt));
+    right_duty = right_.update(right_target_, right_speed, static_cast<float>(dt));
+  }
+  io_.writeDuty(left_duty, right_duty);
+}
+
+void WheelVelocityLoop::run()
+{
+  using Clock = std::chrono::steady_clock;
+  const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(period_));
+  const Clock::time_point begin = Clock::now();
+  Clock::time_point last = begin;
+  Clock::time_point next = begin;
+  while (running_)
+  {
+    const Clock::time_point now = Clock::now();
+    step(std::chrono::duration<double>(now - last).count(), std::chrono::duration<double>(now - begin).count());
+    last = now;
+    next += period;
+    const Clock::time_point after = Clock::now();
+    if (after > next)
+    {
+      // skip the missed iterations instead of running them back to back
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        overruns_++;
+      }
+      next = after;
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
+
+} // namespace ev3
+} // namespace isaac
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace isaac {
+namespace ev3 {
+
+// Gains of the velocity controller of one wheel. Speeds are in tacho counts per second and the
+// output is a duty cycle in percent.
+struct WheelGains {
+  float kp = 0.04f;
+  float ki = 0.6f;
+  // Feed-forward from the target speed, about 100 / no-load speed at full duty
+  float kff = 0.095f;
+  // Duty cycle added in the direction of motion to overcome static friction
+  float friction = 4.0f;
+  // Bound of the integral term
+  float integral_limit = 30.0f;
+};
+
+// Tracking of one wheel since the last reset
+struct WheelTracking {
+  float target = 0.0f;
+  float measured = 0.0f;
+  float duty = 0.0f;
+  double squared_error_sum = 0.0;
+  float max_error = 0.0f;
+  uint64_t samples = 0;
+  // Number of steps in which the duty cycle saturated
+  uint64_t saturated = 0;
+
+  float rmsError() const;
+};
+
+// A PI velocity controller of one wheel with feed-forward from the target speed and conditional
+// integration as anti-windup. A zero target stops the wheel and clears the integral, so the robot
+// does not creep while standing.
+class WheelVelocityController {
+ public:
+  void setGains(const WheelGains& gains) { gains_ = gains; }
+  const WheelGains& gains() const { return gains_; }
+
+  // Computes the duty cycle for the measured speed, `dt` is the time since the last update
+  float update(float target, float measured, float dt);
+  void reset() { integral_ = 0.0f; }
+
+  const WheelTracking& tracking() const { return tracking_; }
+  void resetTracking();
+
+ private:
+  WheelGains gains_;
+  float integral_ = 0.0f;
+  WheelTracking tracking_;
+};
+
+// Wheel speeds and motor outputs of the brick or of a simulation
+class WheelIo {
+ public:
+  virtual ~WheelIo() = default;
+  // Measured speeds in tacho counts per second
+  virtual void readSpeeds(float& left, float& right) = 0;
+  // Duty cycles in percent
+  virtual void writeDuty(float left, float right) = 0;
+};
+
+// Runs a WheelVelocityController per wheel at a fixed rate on its own thread, so that the speed
+// loop does not depend on commands arriving over the network. Targets which are not refreshed
+// within `command_timeout` seconds are set to zero. All methods are thread-safe.
+class WheelVelocityLoop {
+ public:
+  struct Tracking {
+    WheelTracking left;
+    WheelTracking right;
+    // Loop iterations which started later than one period after the previous one
+    uint64_t overruns = 0;
+  };
+
+  WheelVelocityLoop(WheelIo& io, double rate = 100.0, double command_timeout = 0.5);
+  ~WheelVelocityLoop() { stop(); }
+
+  void start();
+  void stop();
+
+  // Sets the target speeds in tacho counts per second
+  void setTargets(float left, float right);
+  void setGains(const WheelGains& gains);
+  WheelGains gains() const;
+  // Tracking since the last reset, optionally starting a new measurement
+  Tracking tracking(bool reset);
+
+  // Runs one iteration, `now` is in seconds. Used by the thread and by simulations.
+  void step(double dt, double now);
+
+ private:
+  void run();
+
+  WheelIo& io_;
+  const double period_;
+  const double command_timeout_;
+  mutable std::mutex mutex_;
+  WheelVelocityController left_;
+  WheelVelocityController right_;
+  float left_target_ = 0.0f;
+  float right_target_ = 0.0f;
+  double command_time_ = -1e9;
+  // set by setTargets, the loop stamps the command with its own clock
+  bool new_command_ = false;
+  uint64_t overruns_ = 0;
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
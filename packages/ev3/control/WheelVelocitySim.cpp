@@ -0,0 +1,96 @@
+// Runs WheelVelocityLoop against simulated motors with a command profile like the one of the
+// navigation stack, new targets at 10 Hz, and compares its tracking with feed-forward only. The
+// two motors differ in friction and gain like worn real ones do. Exits with 1 if the closed loop
+// does not track better than the feed-forward, so it can be used as a check of gain changes.
+//
+//   wheel_velocity_sim [KP KI KFF]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "MotorModel.hpp"
+#include "WheelVelocityLoop.hpp"
+
+using namespace isaac::ev3;
+
+namespace
+{
+
+constexpr double kLoopRate = 100.0;
+constexpr double kCommandRate = 10.0;
+constexpr double kDuration = 20.0;
+// Simulation steps per loop iteration
+constexpr int kSubsteps = 10;
+
+// Wheel targets in tacho counts per second at time `t`: a ramp, a hold, turns and a stop
+void profile(double t, float &left, float &right)
+{
+  const float forward = t < 2.0 ? 300.0f * t : 600.0f;
+  const float turn = t > 6.0 && t < 14.0 ? 250.0f * std::sin(0.8 * (t - 6.0)) : 0.0f;
+  const bool stopped = t > 17.0;
+  left = stopped ? 0.0f : forward - turn;
+  right = stopped ? 0.0f : forward + turn;
+}
+
+WheelVelocityLoop::Tracking simulate(const WheelGains &gains)
+{
+  MotorModel::Parameters left_motor, right_motor;
+  left_motor.friction = 5.0f;
+  right_motor.friction = 9.0f;
+  right_motor.gain = 9.0f;
+  SimulatedWheels wheels(false, left_motor, right_motor);
+  WheelVelocityLoop loop(wheels, kLoopRate);
+  loop.setGains(gains);
+
+  const double dt = 1.0 / kLoopRate;
+  double next_command = 0.0;
+  for (double t = 0.0; t < kDuration; t += dt)
+  {
+    if (t >= next_command)
+    {
+      float left, right;
+      profile(t, left, right);
+      loop.setTargets(left, right);
+      next_command += 1.0 / kCommandRate;
+    }
+    loop.step(dt, t);
+    for (int i = 0; i < kSubsteps; i++)
+    {
+      wheels.advance(static_cast<float>(dt / kSubsteps));
+    }
+  }
+  return loop.tracking(false);
+}
+
+void print(const char *name, const WheelVelocityLoop::Tracking &tracking)
+{
+  std::printf("%-14s rms %7.1f %7.1f   max %7.1f %7.1f   saturated %5llu %5llu\n", name,
+              tracking.left.rmsError(), tracking.right.rmsError(), tracking.left.max_error,
+              tracking.right.max_error, static_cast<unsigned long long>(tracking.left.saturated),
+              static_cast<unsigned long long>(tracking.right.saturated));
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  WheelGains gains;
+  if (argc == 4)
+  {
+    gains.kp = std::atof(argv[1]);
+    gains.ki = std::atof(argv[2]);
+    gains.kff = std::atof(argv[3]);
+  }
+  WheelGains feed_forward = gains;
+  feed_forward.kp = 0.0f;
+  feed_forward.ki = 0.0f;
+
+  std::printf("tracking error in tacho counts/s, left and right wheel\n");
+  const auto closed = simulate(gains);
+  const auto open = simulate(feed_forward);
+  print("PI + FF", closed);
+  print("FF only", open);
+  const bool better = closed.left.rmsError() < open.left.rmsError() && closed.right.rmsError() < open.right.rmsError();
+  return better ? 0 : 1;
+}
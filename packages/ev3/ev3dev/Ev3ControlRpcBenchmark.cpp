@@ -0,0 +1,145 @@
+// Measures Ev3Control round trips in-process over a loopback pipe, thus only the cost of capnp and
+// of the handlers is measured and not the WiFi. The server converts commands and states without
+// motors, once in float like ev3_mock_server and once in fixed point like ev3_control_server. The commands are a
+// fixed drive with turns.
+//
+//   ev3_control_rpc_benchmark [--benchmark_out=PATH]
+
+#include "packages/ev3/ev3dev/ev3control.capnp.h"
+#include "packages/ev3/control/Ev3Kinematics.hpp"
+#include "packages/utils/Benchmark.hpp"
+#include <capnp/rpc-twoparty.h>
+#include <kj/async-io.h>
+#include <cmath>
+#include <vector>
+
+using namespace isaac::ev3;
+
+// Keeps the targets of the latest command and reports them as the measured wheel speeds. Converts
+// in float like ev3_mock_server.
+class LoopbackServer final : public Ev3Control::Server
+{
+public:
+    ::kj::Promise<void> command(CommandContext context) override
+    {
+        auto cmd = context.getParams().getCmd();
+        const WheelSpeeds wheels = BodyToWheels(cmd.getLinearSpeed(), cmd.getAngularSpeed(), kEv3Tank);
+        left = LimitTacho(wheels.left, kEv3Tank);
+        right = LimitTacho(wheels.right, kEv3Tank);
+        auto applied = context.getResults().initApplied();
+        applied.setTraceId(context.getParams().getTrace().getId());
+        return kj::READY_NOW;
+    }
+
+    ::kj::Promise<void> state(StateContext context) override
+    {
+        const BodySpeed body = WheelsToBody(left, right, kEv3Tank);
+        Dynamics::Builder state = context.getResults().initState();
+        state.setLinearSpeed(body.linear);
+        state.setAngularSpeed(body.angular);
+        state.setLinearAcceleration(0.0);
+        state.setAngularAcceleration(0.0);
+        return kj::READY_NOW;
+    }
+
+private:
+    int left = 0;
+    int right = 0;
+};
+
+// The same with the fixed-point conversions of ev3_control_server, see Ev3Kinematics.hpp
+class FixedLoopbackServer final : public Ev3Control::Server
+{
+public:
+    ::kj::Promise<void> command(CommandContext context) override
+    {
+        auto cmd = context.getParams().getCmd();
+        const WheelSpeeds wheels = BodyToWheelsFixed(Q16FromDouble(cmd.getLinearSpeed()),
+                                                     Q16FromDouble(cmd.getAngularSpeed()), kEv3TankFixed);
+        left = LimitTachoFixed(wheels.left, kEv3TankFixed);
+        right = LimitTachoFixed(wheels.right, kEv3TankFixed);
+        auto applied = context.getResults().initApplied();
+        applied.setTraceId(context.getParams().getTrace().getId());
+        return kj::READY_NOW;
+    }
+
+    ::kj::Promise<void> state(StateContext context) override
+    {
+        const BodySpeedFixed body = WheelsToBodyFixed(left * 65536, right * 65536, kEv3TankFixed);
+        Dynamics::Builder state = context.getResults().initState();
+        state.setLinearSpeed(FixedToDouble(body.linear, kEv3TankFixed.meters_per_tacho.shift));
+        state.setAngularSpeed(FixedToDouble(body.angular, kEv3TankFixed.radians_per_tacho.shift));
+        state.setLinearAcceleration(0.0);
+        state.setAngularAcceleration(0.0);
+        return kj::READY_NOW;
+    }
+
+private:
+    int left = 0;
+    int right = 0;
+};
+
+int main(int argc, char **argv)
+{
+    const std::string json_path = ParseBenchmarkOut(argc, argv);
+
+    // body speeds of a drive at 10 Hz: a ramp, a hold and turns
+    std::vector<BodySpeed> commands(200);
+    for (size_t i = 0; i < commands.size(); i++) {
+        const float t = i / 10.0f;
+        commands[i] = BodySpeed{t < 2.0f ? 0.1f * t : 0.2f,
+                                t > 6.0f && t < 14.0f ? 2.5f * std::sin(0.8f * (t - 6.0f)) : 0.0f};
+    }
+    size_t next = 0;
+
+    auto io = kj::setupAsyncIo();
+    auto &waitScope = io.waitScope;
+    capnp::TwoPartyServer server(kj::heap<LoopbackServer>());
+    auto pipe = io.provider->newTwoWayPipe();
+    server.accept(kj::mv(pipe.ends[0]));
+    capnp::TwoPartyClient client(*pipe.ends[1]);
+    Ev3Control::Client ev3Control = client.bootstrap().castAs<Ev3Control>();
+
+    capnp::TwoPartyServer fixedServer(kj::heap<FixedLoopbackServer>());
+    auto fixedPipe = io.provider->newTwoWayPipe();
+    fixedServer.accept(kj::mv(fixedPipe.ends[0]));
+    capnp::TwoPartyClient fixedClient(*fixedPipe.ends[1]);
+    Ev3Control::Client fixedControl = fixedClient.bootstrap().castAs<Ev3Control>();
+
+    auto sendCommand = [&](Ev3Control::Client &target) {
+        const BodySpeed &command = commands[next++ % commands.size()];
+        auto request = target.commandRequest();
+        auto cmd = request.initCmd();
+        cmd.setLinearSpeed(command.linear);
+        cmd.setAngularSpeed(command.angular);
+        DoNotOptimize(request.send().wait(waitScope).getApplied().getTraceId());
+    };
+    auto requestState = [&](Ev3Control::Client &target) {
+        DoNotOptimize(target.stateRequest().send().wait(waitScope).getState().getLinearSpeed());
+    };
+
+    std::vector<BenchmarkResult> results;
+    results.push_back(RunBenchmark("Ev3Control command", [&] { sendCommand(ev3Control); }));
+    results.push_back(RunBenchmark("Ev3Control state", [&] { requestState(ev3Control); }));
+    // what Ev3Driver does every tick
+    results.push_back(RunBenchmark("Ev3Control command + state", [&] {
+        sendCommand(ev3Control);
+        requestState(ev3Control);
+    }));
+    results.push_back(RunBenchmark("Ev3Control fixed command", [&] { sendCommand(fixedControl); }));
+    results.push_back(RunBenchmark("Ev3Control fixed state", [&] { requestState(fixedControl); }));
+    results.push_back(RunBenchmark("Ev3Control fixed command + state", [&] {
+        sendCommand(fixedControl);
+        requestState(fixedControl);
+    }));
+    // Ev3Driver connects anew every tick, this is the cost of that without the network
+    results.push_back(RunBenchmark("Ev3Control connect + command + state", [&] {
+        auto tickPipe = io.provider->newTwoWayPipe();
+        server.accept(kj::mv(tickPipe.ends[0]));
+        capnp::TwoPartyClient tickClient(*tickPipe.ends[1]);
+        Ev3Control::Client tickControl = tickClient.bootstrap().castAs<Ev3Control>();
+        sendCommand(tickControl);
+        requestState(tickControl);
+    }));
+    return ReportBenchmarks(results, argv[0], json_path) ? 0 : 1;
+}
@@ -1,88 +1,72 @@
-#include "packages/ev3/ev3dev/ev3control.capnp.h"
-#include <capnp/ez-rpc.h>
+#include "packages/ev3/ev3dev/Ev3ControlServer.hpp"
 #include <capnp/message.h>
+#include <capnp/rpc-twoparty.h>
+#include <kj/async-io.h>
+#include <kj/async-unix.h>
 #include <iostream>
 #include "ev3dev.h"
-#include <thread>
-#include <chrono>
-#include <math.h>
-
-const int MAX_SPEED = 900;
-const float TACHO_TO_SPEED = 0.00026;
-const float BASE_LENGHT = 0.156;
-ev3dev::large_motor l_motor(ev3dev::OUTPUT_B);
-ev3dev::large_motor r_motor(ev3dev::OUTPUT_C);
-
-int si_to_tacho(float speed_in_mps) {
-    int whish_speed = speed_in_mps/TACHO_TO_SPEED;
-    if(std::abs(whish_speed) > MAX_SPEED) {
-        //limit to MAX_SPEED
-        std::cerr << "MAX_SPEED exceeded! " << whish_speed << std::endl;
-        return std::copysign(MAX_SPEED, whish_speed);
-    }
-    return whish_speed;
-}
-float tacho_to_si(int speed_in_tachosps){
-    return TACHO_TO_SPEED * speed_in_tachosps;
-}
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+#include <fcntl.h>
+
+// A large motor which exposes the sysfs directory of its attributes
+class Ev3Motor : public ev3dev::large_motor
+{
+public:
+    using ev3dev::large_motor::large_motor;
+    const std::string &path() const { return _path; }
+};
+Ev3Motor l_motor(ev3dev::OUTPUT_B);
+Ev3Motor r_motor(ev3dev::OUTPUT_C);
 
-class Ev3ControlServer final : public Ev3Control::Server
+// The motors as wheels of the velocity loop. The motors run in direct mode, the duty cycle is
+// applied as soon as it is written.
+class Ev3devWheels final : public isaac::ev3::WheelIo
 {
-public:    
-    
-    ::kj::Promise<void> command(CommandContext context) override
+public:
+    void readSpeeds(float &left, float &right) override
     {
-        auto cmd = context.getParams().getCmd();
-
-        float speed_diff = cmd.getAngularSpeed() * BASE_LENGHT;
-
-        if(cmd.getLinearSpeed() || cmd.getAngularSpeed()) {
-            std::cout << cmd.getLinearSpeed() << " " << cmd.getAngularSpeed()  << " move L " << si_to_tacho(cmd.getLinearSpeed() - speed_diff/2) << " R " <<  si_to_tacho(cmd.getLinearSpeed() + speed_diff/2) << std::endl;
-        }
-        l_motor.set_speed_sp(si_to_tacho(cmd.getLinearSpeed() - speed_diff/2)).set_time_sp(500).run_timed();  // tacho counts per second
-        r_motor.set_speed_sp(si_to_tacho(cmd.getLinearSpeed() + speed_diff/2)).set_time_sp(500).run_timed();  // tacho counts per second
-        
-        return kj::READY_NOW;
+        left = l_speed.read();
+        right = r_speed.read();
     }
+    void writeDuty(float left, float right) override
+    {
+        l_duty.write(static_cast<int>(std::lround(left)));
+        r_duty.write(static_cast<int>(std::lround(right)));
+    }
+    bool isOpen() const { return l_speed.isOpen() && r_speed.isOpen() && l_duty.isOpen() && r_duty.isOpen(); }
 
-    ::kj::Promise<void> state(StateContext context) override {
-        ::capnp::MallocMessageBuilder message;
-
-        Dynamics::Builder state = message.initRoot<Dynamics>();
-
-        auto  end = std::chrono::high_resolution_clock::now();
-        int l_position_end = l_motor.position();
-        int r_position_end = r_motor.position();
-        
-        std::chrono::duration<float, std::milli> elapsed = end-start;
-        
-        float l_speed = (l_position_end - l_position_start)/elapsed.count() * 1000;
-        float r_speed = (r_position_end - r_position_start)/elapsed.count() * 1000;
-
-        //restart count
-        start = std::chrono::high_resolution_clock::now();
-        l_position_start = l_motor.position();
-        r_position_start = r_motor.position();
-
-        state.setLinearSpeed(tacho_to_si(r_speed - (r_speed-l_speed)/2));
-
-        state.setAngularSpeed(tacho_to_si(r_speed-l_speed)/BASE_LENGHT);
-        
-        state.setLinearAcceleration(0.0);
-        state.setAngularAcceleration(0.0);
-        context.getResults().setState(state);
+private:
+    SysfsAttribute l_speed{l_motor.path() + "speed", O_RDONLY};
+    SysfsAttribute r_speed{r_motor.path() + "speed", O_RDONLY};
+    SysfsAttribute l_duty{l_motor.path() + "duty_cycle_sp", O_WRONLY};
+    SysfsAttribute r_duty{r_motor.path() + "duty_cycle_sp", O_WRONLY};
+};
 
-        if(state.getLinearSpeed() || state.getAngularSpeed()) {
-            std::cout << "state " << state.getLinearSpeed() << " " << state.getAngularSpeed() << std::endl;;
+// Zero duty and a stop of both motors. In direct mode the motors keep the last duty cycle when
+// nobody writes a new one, thus this also runs at exit and on std::terminate.
+void stopMotors() noexcept
+{
+    for (auto *motor : {&l_motor, &r_motor})
+    {
+        try
+        {
+            motor->set_duty_cycle_sp(0);
+            motor->stop();
+        }
+        catch (...)
+        {
         }
-
-        return kj::READY_NOW;
     }
-    private:
-        std::chrono::time_point<std::chrono::high_resolution_clock> start = std::chrono::high_resolution_clock::now();
-        int l_position_start = l_motor.position();
-        int r_position_start = r_motor.position();
-};
+}
+
+void terminateHandler()
+{
+    stopMotors();
+    std::abort();
+}
 
 //---------------------------------------------------------------------------
 void precondition(bool cond, const std::string &msg) {
@@ -93,29 +77,59 @@ int main(int argc, const char *argv[])
 {
     // We expect one argument specifying the address to which
     // to bind and accept connections.
-    if (argc != 2)
+    // An optional second argument is the rate of the wheel velocity loop in Hz.
+    if (argc != 2 && argc != 3)
     {
         std::cerr << "usage: "
                   << "ev3_control_server"
-                  << " ADDRESS[:PORT]"
+                  << " ADDRESS[:PORT] [LOOP_RATE]"
                   << std::endl;
         return 1;
     }
+    const double loop_rate = argc == 3 ? std::atof(argv[2]) : 100.0;
+    precondition(loop_rate > 0.0, "Loop rate must be positive");
+
+    // SIGINT and SIGTERM end the event loop below so that the motors are stopped. They have to be
+    // captured before the velocity loop starts its thread, which inherits the signal mask.
+    kj::UnixEventPort::captureSignal(SIGINT);
+    kj::UnixEventPort::captureSignal(SIGTERM);
+    std::atexit([] { stopMotors(); });
+    std::set_terminate(terminateHandler);
 
     precondition(l_motor.connected(), "Left motor not connected");
     precondition(r_motor.connected(), "Right motor not connected");
 
-    // Set up the EzRpcServer, binding to port 5923 unless a
-    // different port was specified by the user.  Note that the
-    // first parameter here can be any "Client" object or anything
-    // that can implicitly cast to a "Client" object.  You can even
-    // re-export a capability imported from another server.
-    capnp::EzRpcServer server(kj::heap<Ev3ControlServer>(), argv[1], 5923);
+    for (auto *motor : {&l_motor, &r_motor})
+    {
+        motor->set_duty_cycle_sp(0);
+        motor->set_stop_action(ev3dev::motor::stop_action_brake);
+        motor->run_direct();
+    }
+    Ev3devWheels wheels;
+    precondition(wheels.isOpen(), "Could not open the motor attributes");
+    isaac::ev3::WheelVelocityLoop loop(wheels, loop_rate);
+    loop.start();
+
+    // Set up the server, binding to port 5923 unless a different port was specified by the user.
+    // Like EzRpcServer, but on an event loop of our own which also waits for the signals.
+    auto io = kj::setupAsyncIo();
+    auto handlers = kj::heap<Ev3ControlServer>(loop, l_motor.path(), r_motor.path());
+    precondition(handlers->isOpen(), "Could not open the motor positions");
+    capnp::TwoPartyServer server(kj::mv(handlers));
+    auto listener = io.provider->getNetwork().parseAddress(argv[1], 5923).wait(io.waitScope)->listen();
 
-    auto &waitScope = server.getWaitScope();
     std::cout << "running on "
                   << argv[1]
                   << std::endl;
-    //   // Run forever, accepting connections and handling requests.
-    kj::NEVER_DONE.wait(waitScope);
+    // Accept connections and handle requests until a signal arrives
+    auto signal = io.unixEventPort.onSignal(SIGINT).exclusiveJoin(io.unixEventPort.onSignal(SIGTERM));
+    const siginfo_t info = server.listen(*listener)
+                               .then([]() -> siginfo_t { KJ_FAIL_REQUIRE("listening stopped"); })
+                               .exclusiveJoin(kj::mv(signal))
+                               .wait(io.waitScope);
+    std::cout << "stopping on signal " << info.si_signo << std::endl;
+
+    loop.stop();
+    stopMotors();
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "packages/ev3/ev3dev/ev3control.capnp.h"
+#include "packages/ev3/control/Ev3Kinematics.hpp"
+#include "packages/ev3/control/WheelVelocityLoop.hpp"
+#include "packages/ev3/ev3dev/ServerLog.hpp"
+#include "packages/ev3/ev3dev/WheelLoopRpc.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+constexpr isaac::ev3::Ev3FixedGeometry kControlServerGeometry = isaac::ev3::kEv3TankFixed;
+
+// An integer attribute of a motor which is kept open. The accessors of ev3dev-lang-cpp build the
+// path and open a stream on every call, which allocates in the handlers and the velocity loop.
+class SysfsAttribute
+{
+public:
+    SysfsAttribute(const std::string &path, int flags) : fd(open(path.c_str(), flags)) {}
+    ~SysfsAttribute()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+    SysfsAttribute(const SysfsAttribute &) = delete;
+    SysfsAttribute &operator=(const SysfsAttribute &) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+    int read() const
+    {
+        char buffer[32];
+        const ssize_t size = pread(fd, buffer, sizeof(buffer) - 1, 0);
+        buffer[size > 0 ? size : 0] = '\0';
+        return std::atoi(buffer);
+    }
+    void write(int value) const
+    {
+        char buffer[32];
+        const int size = std::snprintf(buffer, sizeof(buffer), "%d", value);
+        (void)!pwrite(fd, buffer, size, 0);
+    }
+
+private:
+    int fd;
+};
+
+// Runs the wheel velocity loop on the brick; commands only set its targets, with feed-forward from
+// the commanded body speed, so the loop keeps tracking between commands sent over WiFi. The state
+// is computed from the tacho positions in the sysfs directories of the two motors.
+// The handlers write straight into the results and do not allocate; the brick has 64 MB.
+// ev3_server_allocations checks that. The conversions and the speed estimation are in fixed point,
+// the brick has no FPU, see Ev3Kinematics.hpp.
+class Ev3ControlServer : public Ev3Control::Server
+{
+public:
+    // `left_path` and `right_path` are the sysfs directories of the motors, ending with a slash
+    Ev3ControlServer(isaac::ev3::WheelVelocityLoop &loop, const std::string &left_path, const std::string &right_path)
+        : loop(loop), l_position(left_path + "position", O_RDONLY), r_position(right_path + "position", O_RDONLY)
+    {
+    }
+
+    bool isOpen() const { return l_position.isOpen() && r_position.isOpen(); }
+
+    ::kj::Promise<void> command(CommandContext context) override
+    {
+        const int64_t receivedTime = isaac::ev3::NowNs();
+        auto cmd = context.getParams().getCmd();
+
+        // tacho counts per second, the loop stops the motors if commands stop arriving
+        const isaac::ev3::Q16 linear = isaac::ev3::Q16FromDouble(cmd.getLinearSpeed());
+        const isaac::ev3::Q16 angular = isaac::ev3::Q16FromDouble(cmd.getAngularSpeed());
+        const auto wheels = isaac::ev3::BodyToWheelsFixed(linear, angular, kControlServerGeometry);
+        const int l_target = limit_tacho(wheels.left);
+        const int r_target = limit_tacho(wheels.right);
+        if(linear != 0 || angular != 0) {
+            motion_log.print("%f %f move L %d R %d", cmd.getLinearSpeed(), cmd.getAngularSpeed(), l_target, r_target);
+        }
+        loop.setTargets(l_target, r_target);
+        calls++;
+        if (soak_log.due())
+            soak_log.print("%llu calls, rss %ld kB", calls, isaac::ev3::ResidentSetKb());
+
+        auto applied = context.getResults().initApplied();
+        applied.setTraceId(context.getParams().getTrace().getId());
+        applied.setReceivedTime(receivedTime);
+        applied.setAppliedTime(isaac::ev3::NowNs());
+
+        return kj::READY_NOW;
+    }
+
+    ::kj::Promise<void> state(StateContext context) override {
+        Dynamics::Builder state = context.getResults().initState();
+
+        const timespec end = Now();
+        int l_position_end = l_position.read();
+        int r_position_end = r_position.read();
+
+        const auto scale = isaac::ev3::ToTachoRateScale(isaac::ev3::ElapsedUs(start, end));
+        const isaac::ev3::Q16 l_speed = isaac::ev3::TachoRateFixed(l_position_end - l_position_start, scale);
+        const isaac::ev3::Q16 r_speed = isaac::ev3::TachoRateFixed(r_position_end - r_position_start, scale);
+
+        //restart count
+        start = end;
+        l_position_start = l_position_end;
+        r_position_start = r_position_end;
+
+        const auto body = isaac::ev3::WheelsToBodyFixed(l_speed, r_speed, kControlServerGeometry);
+        state.setLinearSpeed(isaac::ev3::FixedToDouble(body.linear, kControlServerGeometry.meters_per_tacho.shift));
+
+        state.setAngularSpeed(isaac::ev3::FixedToDouble(body.angular, kControlServerGeometry.radians_per_tacho.shift));
+
+        state.setLinearAcceleration(0.0);
+        state.setAngularAcceleration(0.0);
+
+        if(body.linear != 0 || body.angular != 0) {
+            motion_log.print("state %f %f", state.getLinearSpeed(), state.getAngularSpeed());
+        }
+        calls++;
+        if (soak_log.due())
+            soak_log.print("%llu calls, rss %ld kB", calls, isaac::ev3::ResidentSetKb());
+
+        return kj::READY_NOW;
+    }
+
+    ::kj::Promise<void> setGains(SetGainsContext context) override
+    {
+        loop.setGains(isaac::ev3::FromCapnp(context.getParams().getGains()));
+        isaac::ev3::ToCapnp(loop.gains(), context.getResults().initGains());
+        return kj::READY_NOW;
+    }
+
+    ::kj::Promise<void> tracking(TrackingContext context) override
+    {
+        isaac::ev3::ToCapnp(loop.tracking(context.getParams().getReset()), context.getResults().initTracking());
+        return kj::READY_NOW;
+    }
+
+    private:
+        static timespec Now() {
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            return now;
+        }
+
+        int limit_tacho(int whish_speed) {
+            const int speed = isaac::ev3::LimitTachoFixed(whish_speed, kControlServerGeometry);
+            if(speed != whish_speed) {
+                limit_log.print("MAX_SPEED exceeded! %d", whish_speed);
+            }
+            return speed;
+        }
+
+        isaac::ev3::WheelVelocityLoop &loop;
+        SysfsAttribute l_position;
+        SysfsAttribute r_position;
+        timespec start = Now();
+        int l_position_start = l_position.read();
+        int r_position_start = r_position.read();
+        unsigned long long calls = 0;
+        // logging of the handlers, throttled and without allocations
+        isaac::ev3::ThrottledLog limit_log;
+        isaac::ev3::ThrottledLog motion_log;
+        // calls and memory use, to watch for leaks and heap growth over long runs
+        isaac::ev3::ThrottledLog soak_log{10.0};
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "packages/ev3/ev3dev/ev3control.capnp.h"
+#include "packages/ev3/control/Ev3Kinematics.hpp"
+#include "packages/ev3/control/WheelVelocityLoop.hpp"
+#include "packages/ev3/ev3dev/ServerLog.hpp"
+#include "packages/ev3/ev3dev/WheelLoopRpc.hpp"
+
+constexpr isaac::ev3::Ev3Geometry kMockServerGeometry = isaac::ev3::kEv3Mock;
+
+// Runs the wheel velocity loop of the brick against simulated motors, thus the reported state
+// follows the commands like the robot does. The handlers write straight into the results and do
+// not allocate, like the ones of ev3_control_server. ev3_server_allocations checks that.
+class Ev3MockServer : public Ev3Control::Server
+{
+public:
+    explicit Ev3MockServer(isaac::ev3::WheelVelocityLoop &loop) : loop(loop) {}
+    
+    ::kj::Promise<void> command(CommandContext context) override
+    {
+        const int64_t receivedTime = isaac::ev3::NowNs();
+        auto cmd = context.getParams().getCmd();
+
+        const auto wheels =
+            isaac::ev3::BodyToWheels(cmd.getLinearSpeed(), cmd.getAngularSpeed(), kMockServerGeometry);
+        const int l_target = limit_tacho(wheels.left);
+        const int r_target = limit_tacho(wheels.right);
+        if(cmd.getLinearSpeed() || cmd.getAngularSpeed()) {
+            motion_log.print("%f %f move L %d R %d", cmd.getLinearSpeed(), cmd.getAngularSpeed(), l_target, r_target);
+        }
+        loop.setTargets(l_target, r_target);
+        calls++;
+        if (soak_log.due())
+            soak_log.print("%llu calls, rss %ld kB", calls, isaac::ev3::ResidentSetKb());
+
+        auto applied = context.getResults().initApplied();
+        applied.setTraceId(context.getParams().getTrace().getId());
+        applied.setReceivedTime(receivedTime);
+        applied.setAppliedTime(isaac::ev3::NowNs());
+
+        return kj::READY_NOW;
+    }
+
+    ::kj::Promise<void> state(StateContext context) override {
+        Dynamics::Builder state = context.getResults().initState();
+
+        // speeds measured by the loop in its latest iteration
+        const auto tracking = loop.tracking(false);
+        float l_speed = tracking.left.measured;
+        float r_speed = tracking.right.measured;
+
+        const auto body = isaac::ev3::WheelsToBody(l_speed, r_speed, kMockServerGeometry);
+        state.setLinearSpeed(body.linear);
+
+        state.setAngularSpeed(body.angular);
+        
+        state.setLinearAcceleration(0.0);
+        state.setAngularAcceleration(0.0);
+
+        if(state.getLinearSpeed() || state.getAngularSpeed()) {
+            motion_log.print("state %f %f", state.getLinearSpeed(), state.getAngularSpeed());
+        }
+        calls++;
+        if (soak_log.due())
+            soak_log.print("%llu calls, rss %ld kB", calls, isaac::ev3::ResidentSetKb());
+
+        return kj::READY_NOW;
+    }
+
+    ::kj::Promise<void> setGains(SetGainsContext context) override
+    {
+        loop.setGains(isaac::ev3::FromCapnp(context.getParams().getGains()));
+        isaac::ev3::ToCapnp(loop.gains(), context.getResults().initGains());
+        return kj::READY_NOW;
+    }
+
+    ::kj::Promise<void> tracking(TrackingContext context) override
+    {
+        isaac::ev3::ToCapnp(loop.tracking(context.getParams().getReset()), context.getResults().initTracking());
+        return kj::READY_NOW;
+    }
+
+private:
+    int limit_tacho(int whish_speed) {
+        const int speed = isaac::ev3::LimitTacho(whish_speed, kMockServerGeometry);
+        if(speed != whish_speed) {
+            limit_log.print("MAX_SPEED exceeded! %d", whish_speed);
+        }
+        return speed;
+    }
+
+    isaac::ev3::WheelVelocityLoop &loop;
+    unsigned long long calls = 0;
+    // logging of the handlers, throttled and without allocations
+    isaac::ev3::ThrottledLog limit_log;
+    isaac::ev3::ThrottledLog motion_log;
+    // calls and memory use, to watch for leaks and heap growth over long runs
+    isaac::ev3::ThrottledLog soak_log{10.0};
+};
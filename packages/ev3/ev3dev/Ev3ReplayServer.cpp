@@ -0,0 +1,131 @@
+#include "packages/ev3/ev3dev/ev3control.capnp.h"
+#include "packages/ev3/recording/Ev3Records.hpp"
+#include "packages/ev3/recording/RecordLog.hpp"
+#include <capnp/ez-rpc.h>
+#include <capnp/message.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using isaac::ev3::RecordLogReader;
+
+// steady clock in nanoseconds, used to report when commands were applied
+int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Serves the states of a recorded session instead of talking to motors. The session starts at the
+// first record of the log when the first command arrives, the same signal FlatscanReplay waits for,
+// and runs `speed` times faster than real time. Every state request gets the latest state recorded
+// before the current session time, the robot is at rest until the session started. Commands are only
+// counted.
+class Ev3ReplayServer final : public Ev3Control::Server
+{
+public:
+    Ev3ReplayServer(const RecordLogReader &log, double speed)
+        : speed(speed), origin(isaac::ev3::SessionOrigin(log))
+    {
+        for (size_t i = 0; i < log.size(); i++) {
+            const auto record = log.record(i);
+            if (record.type == isaac::ev3::kStateRecord && record.size >= sizeof(isaac::ev3::StateRecord)) {
+                states.push_back({record.timestamp, *reinterpret_cast<const isaac::ev3::StateRecord *>(record.data)});
+            } else if (record.type == isaac::ev3::kCommandRecord) {
+                commands++;
+            }
+        }
+        std::cout << "replaying " << states.size() << " states and " << commands << " commands at "
+                  << speed << "x" << std::endl;
+    }
+
+    ::kj::Promise<void> command(CommandContext context) override
+    {
+        const int64_t receivedTime = now_ns();
+        if (start == 0) {
+            start = receivedTime;
+            std::cout << "first command, starting the session" << std::endl;
+        }
+        commands_received++;
+        auto applied = context.getResults().initApplied();
+        applied.setTraceId(context.getParams().getTrace().getId());
+        applied.setReceivedTime(receivedTime);
+        applied.setAppliedTime(now_ns());
+        return kj::READY_NOW;
+    }
+
+    ::kj::Promise<void> state(StateContext context) override {
+        // states are in time order, the session only moves forward
+        if (start != 0) {
+            const int64_t time = isaac::ev3::SessionTime(origin, now_ns() - start, speed);
+            while (next < states.size() && states[next].timestamp <= time) {
+                next++;
+            }
+        }
+        Dynamics::Builder state = context.getResults().initState();
+        if (next > 0) {
+            const isaac::ev3::StateRecord &record = states[next - 1].state;
+            state.setLinearSpeed(record.linear_speed);
+            state.setAngularSpeed(record.angular_speed);
+            state.setLinearAcceleration(record.linear_acceleration);
+            state.setAngularAcceleration(record.angular_acceleration);
+        }
+        if (next == states.size() && !finished) {
+            finished = true;
+            std::cout << "end of recording after " << commands_received << " commands, holding last state"
+                      << std::endl;
+        }
+        return kj::READY_NOW;
+    }
+
+private:
+    struct TimedState {
+        int64_t timestamp;
+        isaac::ev3::StateRecord state;
+    };
+
+    double speed;
+    // recorded time of the session start, see SessionOrigin
+    int64_t origin;
+    std::vector<TimedState> states;
+    size_t commands = 0;
+    size_t commands_received = 0;
+    size_t next = 0;
+    // steady clock time of the first command, 0 until then
+    int64_t start = 0;
+    bool finished = false;
+};
+
+int main(int argc, const char *argv[])
+{
+    if (argc != 3 && argc != 4)
+    {
+        std::cerr << "usage: "
+                  << "ev3_replay_server"
+                  << " LOG ADDRESS[:PORT] [SPEED]"
+                  << std::endl
+                  << "Serves the EV3 states recorded by Ev3Driver in LOG, SPEED times faster than recorded."
+                  << std::endl;
+        return 1;
+    }
+    RecordLogReader log;
+    if (!log.open(argv[1]))
+    {
+        std::cerr << "Could not open " << argv[1] << std::endl;
+        return 1;
+    }
+    const double speed = argc == 4 ? std::atof(argv[3]) : 1.0;
+    if (speed <= 0.0)
+    {
+        std::cerr << "SPEED must be positive" << std::endl;
+        return 1;
+    }
+
+    capnp::EzRpcServer server(kj::heap<Ev3ReplayServer>(log, speed), argv[2], 5923);
+
+    auto &waitScope = server.getWaitScope();
+    std::cout << "running on "
+                  << argv[2]
+                  << std::endl;
+    kj::NEVER_DONE.wait(waitScope);
+}
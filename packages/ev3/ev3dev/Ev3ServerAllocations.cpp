@@ -0,0 +1,314 @@
+// Checks that the command and state handlers of ev3_control_server and ev3_mock_server do not
+// allocate. Both servers are driven in-process over a loopback pipe like in
+// ev3_control_rpc_benchmark, with malloc and operator new replaced by counters which only count
+// inside the handlers and only after a warm-up. capnp itself allocates the promise a handler
+// returns, that share is measured with empty handlers and subtracted. Afterwards the handlers are
+// called CALLS times and the growth of the resident set is reported. Exits with 1 if a handler
+// allocates.
+//
+//   ev3_server_allocations [CALLS]
+
+#include "packages/ev3/ev3dev/Ev3ControlServer.hpp"
+#include "packages/ev3/ev3dev/Ev3MockServer.hpp"
+#include "packages/ev3/control/MotorModel.hpp"
+#include <capnp/rpc-twoparty.h>
+#include <kj/async-io.h>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+extern "C" void __libc_free(void *pointer);
+
+namespace
+{
+
+// set once the warm-up is done
+std::atomic<bool> counting{false};
+// set while a handler of the current thread runs
+thread_local bool in_handler = false;
+std::atomic<unsigned long> allocations{0};
+
+void countAllocation()
+{
+    if (in_handler && counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+extern "C" void *malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void *pointer)
+{
+    __libc_free(pointer);
+}
+
+void *operator new(size_t size)
+{
+    void *pointer = malloc(size);
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return malloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return malloc(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+namespace
+{
+
+// Counts the allocations of the command and state handlers of `Server`. The results are
+// initialized before counting, the message which holds them belongs to the RPC system.
+template <typename Server>
+class Counted final : public Server
+{
+public:
+    using Server::Server;
+
+    ::kj::Promise<void> command(typename Server::CommandContext context) override
+    {
+        context.getResults();
+        in_handler = true;
+        auto promise = Server::command(context);
+        in_handler = false;
+        return promise;
+    }
+
+    ::kj::Promise<void> state(typename Server::StateContext context) override
+    {
+        context.getResults();
+        in_handler = true;
+        auto promise = Server::state(context);
+        in_handler = false;
+        return promise;
+    }
+};
+
+// Handlers which do nothing, thus only capnp allocates in them
+class EmptyServer : public Ev3Control::Server
+{
+public:
+    ::kj::Promise<void> command(CommandContext) override { return kj::READY_NOW; }
+    ::kj::Promise<void> state(StateContext) override { return kj::READY_NOW; }
+};
+
+// Sysfs attributes of a motor, the position of which does not change
+class FakeMotor
+{
+public:
+    FakeMotor()
+    {
+        char pattern[] = "/tmp/ev3_server_allocations.XXXXXX";
+        if (mkdtemp(pattern) != nullptr)
+        {
+            dir = pattern;
+            FILE *file = std::fopen((dir + "/position").c_str(), "w");
+            if (file != nullptr)
+            {
+                std::fputs("0\n", file);
+                std::fclose(file);
+            }
+        }
+    }
+    ~FakeMotor()
+    {
+        if (!dir.empty())
+        {
+            unlink((dir + "/position").c_str());
+            rmdir(dir.c_str());
+        }
+    }
+
+    std::string path() const { return dir + "/"; }
+
+private:
+    std::string dir;
+};
+
+struct Allocations
+{
+    double command = 0.0;
+    double state = 0.0;
+};
+
+// Calls the handlers of `server` over a loopback pipe
+class Driver
+{
+public:
+    Driver(kj::AsyncIoContext &io, kj::Own<Ev3Control::Server> handlers)
+        : io(io), server(kj::mv(handlers)), pipe(io.provider->newTwoWayPipe())
+    {
+        server.accept(kj::mv(pipe.ends[0]));
+        client = kj::heap<capnp::TwoPartyClient>(*pipe.ends[1]);
+        control = client->bootstrap().castAs<Ev3Control>();
+    }
+
+    void command()
+    {
+        // a drive at 10 Hz with turns, every 100th command beyond the speed limit
+        const float t = (next % 200) / 10.0f;
+        auto request = control.commandRequest();
+        auto cmd = request.initCmd();
+        cmd.setLinearSpeed(next % 100 == 99 ? 5.0f : t < 2.0f ? 0.1f * t : 0.2f);
+        cmd.setAngularSpeed(t > 6.0f && t < 14.0f ? 2.5f * std::sin(0.8f * (t - 6.0f)) : 0.0f);
+        request.initTrace().setId(next++);
+        request.send().wait(io.waitScope);
+    }
+
+    void state() { control.stateRequest().send().wait(io.waitScope); }
+
+    // Allocations per call of the handlers over `calls` calls each
+    Allocations count(int calls)
+    {
+        Allocations result;
+        counting = true;
+        allocations = 0;
+        for (int i = 0; i < calls; i++)
+            command();
+        result.command = double(allocations) / calls;
+        allocations = 0;
+        for (int i = 0; i < calls; i++)
+            state();
+        result.state = double(allocations) / calls;
+        counting = false;
+        return result;
+    }
+
+private:
+    kj::AsyncIoContext &io;
+    capnp::TwoPartyServer server;
+    kj::TwoWayPipe pipe;
+    kj::Own<capnp::TwoPartyClient> client;
+    Ev3Control::Client control = nullptr;
+    uint64_t next = 0;
+};
+
+constexpr int kWarmupCalls = 1000;
+constexpr int kCountedCalls = 1000;
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const long calls = argc > 1 ? std::atol(argv[1]) : 100000;
+    auto io = kj::setupAsyncIo();
+
+    isaac::ev3::SimulatedWheels wheels(true);
+    isaac::ev3::WheelVelocityLoop loop(wheels);
+    loop.start();
+    FakeMotor left, right;
+    auto control_server = kj::heap<Counted<Ev3ControlServer>>(loop, left.path(), right.path());
+    if (!control_server->isOpen())
+    {
+        std::printf("could not create the motor attributes\n");
+        return 1;
+    }
+
+    struct Case
+    {
+        const char *name;
+        kj::Own<Driver> driver;
+    };
+    std::vector<Case> cases;
+    cases.push_back(Case{"empty handlers", kj::heap<Driver>(io, kj::heap<Counted<EmptyServer>>())});
+    cases.push_back(Case{"ev3_control_server", kj::heap<Driver>(io, kj::mv(control_server))});
+    cases.push_back(Case{"ev3_mock_server", kj::heap<Driver>(io, kj::heap<Counted<Ev3MockServer>>(loop))});
+
+    int failures = 0;
+    Allocations baseline;
+    std::printf("allocations per call in the handlers, %d calls after %d warm-up calls\n", kCountedCalls,
+                kWarmupCalls);
+    std::printf("%-20s %10s %10s\n", "server", "command", "state");
+    for (auto &test : cases)
+    {
+        for (int i = 0; i < kWarmupCalls; i++)
+        {
+            test.driver->command();
+            test.driver->state();
+        }
+        const Allocations counted = test.driver->count(kCountedCalls);
+        std::printf("%-20s %10.2f %10.2f\n", test.name, counted.command, counted.state);
+        if (&test == &cases.front())
+        {
+            baseline = counted;
+        }
+        else if (counted.command > baseline.command || counted.state > baseline.state)
+        {
+            std::printf("  FAILED: the handlers allocate\n");
+            failures++;
+        }
+    }
+
+    // the soak, the resident set should not grow after the warm-up
+    for (auto &test : cases)
+    {
+        const long before = isaac::ev3::ResidentSetKb();
+        for (long i = 0; i < calls; i++)
+        {
+            test.driver->command();
+            test.driver->state();
+        }
+        const long after = isaac::ev3::ResidentSetKb();
+        std::printf("%s: %ld command + state calls, rss %ld kB -> %ld kB (%+ld kB)\n", test.name, calls, before,
+                    after, after - before);
+    }
+    loop.stop();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+namespace isaac
+{
+namespace ev3
+{
+
+// Prints at most one line per period from the RPC handlers. Lines are formatted into a fixed buffer
+// and written with one write call, thus logging does not allocate, unlike streaming to std::cout.
+// Lines dropped in between are counted and the count is appended to the next printed line.
+class ThrottledLog
+{
+public:
+    explicit ThrottledLog(double period = 1.0)
+        : period(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(period))) {}
+
+    // True if the next line would be printed, to skip computing arguments of dropped lines
+    bool due() const { return Clock::now() >= next; }
+
+    __attribute__((format(printf, 2, 3))) void print(const char *format, ...)
+    {
+        const Clock::time_point now = Clock::now();
+        if (now < next)
+        {
+            dropped++;
+            return;
+        }
+        next = now + period;
+        char line[256];
+        va_list args;
+        va_start(args, format);
+        int length = std::vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        length = length < 0 ? 0 : std::min<int>(length, sizeof(line) - 1);
+        if (dropped > 0)
+        {
+            const int extra = std::snprintf(line + length, sizeof(line) - length, " (+%lu)", dropped);
+            length = std::min<int>(length + std::max(extra, 0), sizeof(line) - 1);
+            dropped = 0;
+        }
+        line[length++] = '\n';
+        (void)!write(STDOUT_FILENO, line, length);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    Clock::duration period;
+    Clock::time_point next;
+    unsigned long dropped = 0;
+};
+
+// Steady clock in nanoseconds, used to report when commands were received and applied
+inline int64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Resident set size of this process in kB from /proc/self/statm, -1 if it can not be read. Does not
+// allocate.
+inline long ResidentSetKb()
+{
+    const int fd = open("/proc/self/statm", O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    char buffer[128];
+    const ssize_t size = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (size <= 0)
+    {
+        return -1;
+    }
+    buffer[size] = '\0';
+    // total program size, then resident pages
+    char *end;
+    std::strtol(buffer, &end, 10);
+    const long pages = std::strtol(end, nullptr, 10);
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+} // namespace ev3
+} // namespace isaac
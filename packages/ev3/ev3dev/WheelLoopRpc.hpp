@@ -0,0 +1,46 @@
+#pragma once
+
+#include "packages/ev3/control/WheelVelocityLoop.hpp"
+#include "packages/ev3/ev3dev/ev3control.capnp.h"
+
+namespace isaac {
+namespace ev3 {
+
+// Conversions between the wheel velocity loop and its RPC messages, shared by the servers
+
+inline WheelGains FromCapnp(::WheelGains::Reader reader) {
+  WheelGains gains;
+  gains.kp = reader.getKp();
+  gains.ki = reader.getKi();
+  gains.kff = reader.getKff();
+  gains.friction = reader.getFriction();
+  gains.integral_limit = reader.getIntegralLimit();
+  return gains;
+}
+
+inline void ToCapnp(const WheelGains& gains, ::WheelGains::Builder builder) {
+  builder.setKp(gains.kp);
+  builder.setKi(gains.ki);
+  builder.setKff(gains.kff);
+  builder.setFriction(gains.friction);
+  builder.setIntegralLimit(gains.integral_limit);
+}
+
+inline void ToCapnp(const WheelTracking& tracking, ::WheelTracking::Builder builder) {
+  builder.setTarget(tracking.target);
+  builder.setMeasured(tracking.measured);
+  builder.setDuty(tracking.duty);
+  builder.setRmsError(tracking.rmsError());
+  builder.setMaxError(tracking.max_error);
+  builder.setSamples(tracking.samples);
+  builder.setSaturated(tracking.saturated);
+}
+
+inline void ToCapnp(const WheelVelocityLoop::Tracking& tracking, ::Tracking::Builder builder) {
+  ToCapnp(tracking.left, builder.initLeft());
+  ToCapnp(tracking.right, builder.initRight());
+  builder.setOverruns(tracking.overruns);
+}
+
+}  // namespace ev3
+}  // namespace isaac
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+#include "packages/ev3/recording/RecordLog.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// Types and payloads of the records in an EV3 session log. Timestamps are nanoseconds of the app
+// clock of the recording Ev3Driver.
+enum RecordType : uint32_t {
+  // A speed command sent to the brick, CommandRecord
+  kCommandRecord = 1,
+  // A state received from the brick, StateRecord
+  kStateRecord = 2,
+  // A flatscan, FlatscanRecord followed by `count` ranges and `count` angles as float
+  kFlatscanRecord = 3,
+};
+
+struct CommandRecord {
+  double linear_speed;
+  double angular_speed;
+};
+
+struct StateRecord {
+  double linear_speed;
+  double angular_speed;
+  double linear_acceleration;
+  double angular_acceleration;
+};
+
+struct FlatscanRecord {
+  // Acquisition time of the scan, the record timestamp is the time it was received
+  int64_t acqtime;
+  double invalid_range_threshold;
+  double out_of_range_threshold;
+  uint32_t count;
+  uint32_t reserved;
+};
+
+// Recorded time at which the replay of a session starts, the timestamp of its first record.
+// ev3_replay_server and FlatscanReplay both map their session clock onto this origin, so the states
+// and the scans of a replay stay in step.
+inline int64_t SessionOrigin(const RecordLogReader& log) {
+  return log.size() > 0 ? log.record(0).timestamp : 0;
+}
+
+// Recorded time reached `elapsed` nanoseconds after the start of a replay running `speed` times
+// faster than the recording
+inline int64_t SessionTime(int64_t origin, int64_t elapsed, double speed) {
+  return origin + static_cast<int64_t>(elapsed * speed);
+}
+
+}  // namespace ev3
+}  // namespace isaac
@@ -0,0 +1,316 @@
+#include "RecordLog.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+
+constexpr char kMagic[8] = {'E', 'V', '3', 'L', 'O', 'G', '\0', '\0'};
+constexpr uint32_t kVersion = 1;
+// Initial size of the data file, the index starts at 1/16 of it
+constexpr size_t kInitialCapacity = size_t(1) << 20;
+
+struct FileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  // Bytes of the file holding complete records, including this header
+  uint64_t used;
+  uint64_t records;
+};
+
+struct RecordHeader
+{
+  uint32_t type;
+  uint32_t size;
+  int64_t timestamp;
+};
+
+size_t padded(size_t size)
+{
+  return (size + 7) & ~size_t(7);
+}
+
+} // namespace
+
+struct RecordLogIndexEntry
+{
+  int64_t timestamp;
+  uint64_t offset;
+};
+
+bool RecordLogWriter::openFile(const std::string &path, size_t capacity, MappedFile &file)
+{
+  file.fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (file.fd < 0)
+  {
+    return false;
+  }
+  if (::ftruncate(file.fd, capacity) != 0)
+  {
+    closeFile(file);
+    return false;
+  }
+  void *base = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd, 0);
+  if (base == MAP_FAILED)
+  {
+    closeFile(file);
+    return false;
+  }
+  file.base = static_cast<uint8_t *>(base);
+  file.capacity = capacity;
+  file.used = 0;
+  return true;
+}
+
+bool RecordLogWriter::reserve(MappedFile &file, size_t bytes)
+{
+  if (file.used + bytes <= file.capacity)
+  {
+    return true;
+  }
+  size_t capacity = file.capacity;
+  while (file.used + bytes > capacity)
+  {
+    capacity *= 2;
+  }
+  if (::ftruncate(file.fd, capacity) != 0)
+  {
+    return false;
+  }
+  void *base = ::mremap(file.base, file.capacity, capacity, MREMAP_MAYMOVE);
+  if (base == MAP_FAILED)
+  {
+    return false;
+  }
+  file.base = static_cast<uint8_t *>(base);
+  file.capacity = capacity;
+  return true;
+}
+
+void RecordLogWriter::closeFile(MappedFile &file)
+{
+  if (file.base != nullptr)
+  {
+    ::munmap(file.base, file.capacity);
+    file.base = nullptr;
+  }
+  if (file.fd >= 0)
+  {
+    // drop the unused tail of the last growth
+    if (::ftruncate(file.fd, file.used) != 0)
+    {
+      // the file stays bigger, readers only look at the used part
+    }
+    ::close(file.fd);
+    file.fd = -1;
+  }
+}
+
+bool RecordLogWriter::open(const std::string &path)
+{
+  close();
+  if (!openFile(path, kInitialCapacity, data_) || !openFile(path + ".idx", kInitialCapacity / 16, index_))
+  {
+    close();
+    return false;
+  }
+  FileHeader *header = reinterpret_cast<FileHeader *>(data_.base);
+  std::memcpy(header->magic, kMagic, sizeof(kMagic));
+  header->version = kVersion;
+  header->header_size = sizeof(FileHeader);
+  header->used = sizeof(FileHeader);
+  header->records = 0;
+  data_.used = sizeof(FileHeader);
+  return true;
+}
+
+void RecordLogWriter::close()
+{
+  closeFile(data_);
+  closeFile(index_);
+}
+
+uint64_t RecordLogWriter::records() const
+{
+  return isOpen() ? reinterpret_cast<const FileHeader *>(data_.base)->records : 0;
+}
+
+bool RecordLogWriter::append(uint32_t type, int64_t timestamp, const void *payload, size_t size,
+                             const void *payload2, size_t size2)
+{
+  if (!isOpen())
+  {
+    return false;
+  }
+  const size_t total = size + size2;
+  const size_t bytes = sizeof(RecordHeader) + padded(total);
+  if (!reserve(data_, bytes) || !reserve(index_, sizeof(RecordLogIndexEntry)))
+  {
+    return false;
+  }
+  const uint64_t offset = data_.used;
+  uint8_t *target = data_.base + offset;
+  const RecordHeader record{type, static_cast<uint32_t>(total), timestamp};
+  std::memcpy(target, &record, sizeof(record));
+  target += sizeof(record);
+  if (size > 0)
+  {
+    std::memcpy(target, payload, size);
+  }
+  if (size2 > 0)
+  {
+    std::memcpy(target + size, payload2, size2);
+  }
+  std::memset(target + total, 0, padded(total) - total);
+  data_.used += bytes;
+
+  const RecordLogIndexEntry entry{timestamp, offset};
+  std::memcpy(index_.base + index_.used, &entry, sizeof(entry));
+  index_.used += sizeof(entry);
+
+  // publish the record only once it is complete, the count after the bytes, thus a reader which
+  // sees a count also sees all bytes of the counted records
+  FileHeader *header = reinterpret_cast<FileHeader *>(data_.base);
+  __atomic_store_n(&header->used, data_.used, __ATOMIC_RELEASE);
+  __atomic_store_n(&header->records, header->records + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool RecordLogReader::open(const std::string &path)
+{
+  close();
+  auto map = [](const std::string &filename, uint8_t *&base, size_t &size) {
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      return false;
+    }
+    struct stat info;
+    const bool ok = ::fstat(fd, &info) == 0 && info.st_size > 0;
+    void *mapped = ok ? ::mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+      return false;
+    }
+    base = static_cast<uint8_t *>(mapped);
+    size = info.st_size;
+    return true;
+  };
+  if (!map(path, data_, data_mapped_size_))
+  {
+    return false;
+  }
+  data_size_ = data_mapped_size_;
+  const FileHeader *header = reinterpret_cast<const FileHeader *>(data_);
+  if (data_size_ < sizeof(FileHeader) || std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kVersion)
+  {
+    close();
+    return false;
+  }
+  // only look at complete records, the count first as the writer stores it last
+  const uint64_t records = __atomic_load_n(&header->records, __ATOMIC_ACQUIRE);
+  const uint64_t used = __atomic_load_n(&header->used, __ATOMIC_ACQUIRE);
+  data_size_ = std::min<size_t>(data_size_, used);
+  count_ = records;
+
+  if (map(path + ".idx", index_file_, index_file_size_) && index_file_size_ >= count_ * sizeof(IndexEntry))
+  {
+    index_ = reinterpret_cast<const IndexEntry *>(index_file_);
+    // the file may have been mapped before the writer grew it, drop records beyond the mapping
+    while (count_ > 0 && !fits(index_[count_ - 1].offset))
+    {
+      count_--;
+    }
+  }
+  else
+  {
+    rebuildIndex();
+  }
+  return true;
+}
+
+bool RecordLogReader::fits(uint64_t offset) const
+{
+  if (offset < sizeof(FileHeader) || offset + sizeof(RecordHeader) > data_size_)
+  {
+    return false;
+  }
+  const RecordHeader *record = reinterpret_cast<const RecordHeader *>(data_ + offset);
+  return padded(record->size) <= data_size_ - offset - sizeof(RecordHeader);
+}
+
+void RecordLogReader::rebuildIndex()
+{
+  // count first, then fill, to allocate once; a record which runs past the complete part ends the
+  // log, e.g. a torn or corrupted one
+  size_t count = 0;
+  for (size_t offset = sizeof(FileHeader); fits(offset); count++)
+  {
+    const RecordHeader *record = reinterpret_cast<const RecordHeader *>(data_ + offset);
+    offset += sizeof(RecordHeader) + padded(record->size);
+  }
+  index_storage_ = new IndexEntry[count];
+  size_t offset = sizeof(FileHeader);
+  for (size_t i = 0; i < count; i++)
+  {
+    const RecordHeader *record = reinterpret_cast<const RecordHeader *>(data_ + offset);
+    index_storage_[i] = IndexEntry{record->timestamp, offset};
+    offset += sizeof(RecordHeader) + padded(record->size);
+  }
+  index_ = index_storage_;
+  count_ = count;
+}
+
+void RecordLogReader::close()
+{
+  if (data_ != nullptr)
+  {
+    ::munmap(data_, data_mapped_size_);
+  }
+  if (index_file_ != nullptr)
+  {
+    ::munmap(index_file_, index_file_size_);
+  }
+  delete[] index_storage_;
+  data_ = nullptr;
+  index_file_ = nullptr;
+  index_storage_ = nullptr;
+  index_ = nullptr;
+  data_size_ = 0;
+  data_mapped_size_ = 0;
+  index_file_size_ = 0;
+  count_ = 0;
+}
+
+RecordLogReader::Record RecordLogReader::record(size_t index) const
+{
+  const uint64_t offset = index_[index].offset;
+  const RecordHeader *header = reinterpret_cast<const RecordHeader *>(data_ + offset);
+  return Record{header->type, header->timestamp, data_ + offset + sizeof(RecordHeader), header->size};
+}
+
+size_t RecordLogReader::lowerBound(int64_t timestamp) const
+{
+  const IndexEntry *end = index_ + count_;
+  const IndexEntry *it = std::lower_bound(
+      index_, end, timestamp, [](const IndexEntry &entry, int64_t value) { return entry.timestamp < value; });
+  return it - index_;
+}
+
+} // namespace ev3
+} // namespace isaac
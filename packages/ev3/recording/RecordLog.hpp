@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace isaac {
+namespace ev3 {
+
+// An entry of the index file, defined in RecordLog.cpp
+struct RecordLogIndexEntry;
+
+// An append-only log of timestamped binary records backed by memory-mapped files.
+//
+// The data file starts with a header followed by the records, each one a small record header and
+// its payload padded to 8 bytes. The header holds the number of bytes and records which are
+// complete, thus a log which was not closed properly is still readable up to the last full record.
+// An index file next to it (<path>.idx) holds the timestamp and offset of every record so that a
+// reader can seek without scanning; it is rebuilt from the data file if it is missing or stale.
+//
+// Files grow by doubling, appending a record is a memcpy into the mapping.
+class RecordLogWriter {
+ public:
+  RecordLogWriter() = default;
+  RecordLogWriter(const RecordLogWriter&) = delete;
+  RecordLogWriter& operator=(const RecordLogWriter&) = delete;
+  ~RecordLogWriter() { close(); }
+
+  // Creates a new log, an existing one is overwritten. Returns false on failure.
+  bool open(const std::string& path);
+  // Truncates the files to their used size and unmaps them
+  void close();
+  bool isOpen() const { return data_.base != nullptr; }
+
+  // Appends a record whose payload is the concatenation of up to two buffers, e.g. a header and an
+  // array. Returns false if the files could not be grown.
+  bool append(uint32_t type, int64_t timestamp, const void* payload, size_t size,
+              const void* payload2 = nullptr, size_t size2 = 0);
+
+  // Number of records appended so far
+  uint64_t records() const;
+
+ private:
+  // A file which is mapped in full and grown on demand
+  struct MappedFile {
+    int fd = -1;
+    uint8_t* base = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+  };
+
+  static bool openFile(const std::string& path, size_t capacity, MappedFile& file);
+  static bool reserve(MappedFile& file, size_t bytes);
+  static void closeFile(MappedFile& file);
+
+  MappedFile data_;
+  MappedFile index_;
+};
+
+// Reads a log written by RecordLogWriter, also while it is still being written up to the records
+// which existed when it was opened.
+class RecordLogReader {
+ public:
+  struct Record {
+    uint32_t type;
+    int64_t timestamp;
+    const uint8_t* data;
+    uint32_t size;
+  };
+
+  RecordLogReader() = default;
+  RecordLogReader(const RecordLogReader&) = delete;
+  RecordLogReader& operator=(const RecordLogReader&) = delete;
+  ~RecordLogReader() { close(); }
+
+  // Maps a log, returns false if it does not exist or is not a log
+  bool open(const std::string& path);
+  void close();
+
+  size_t size() const { return count_; }
+  Record record(size_t index) const;
+  // Index of the first record with a timestamp not smaller than `timestamp`, size() if none.
+  // Records are expected to be appended in time order.
+  size_t lowerBound(int64_t timestamp) const;
+
+ private:
+  using IndexEntry = RecordLogIndexEntry;
+
+  // True if a whole record starts at `offset` within the complete part of the data file
+  bool fits(uint64_t offset) const;
+  // Builds the index by walking the records
+  void rebuildIndex();
+
+  uint8_t* data_ = nullptr;
+  // Size of the mapping and of the part holding complete records
+  size_t data_mapped_size_ = 0;
+  size_t data_size_ = 0;
+  uint8_t* index_file_ = nullptr;
+  size_t index_file_size_ = 0;
+  // Points into the index file or into index_storage_ if the index was rebuilt
+  const IndexEntry* index_ = nullptr;
+  IndexEntry* index_storage_ = nullptr;
+  size_t count_ = 0;
+};
+
+}  // namespace ev3
+}  // namespace isaac
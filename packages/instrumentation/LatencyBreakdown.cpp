@@ -0,0 +1,46 @@
+#include "LatencyBreakdown.hpp"
+
+#include <cstdio>
+#include <utility>
+
+namespace isaac
+{
+namespace ev3
+{
+
+LatencyBreakdown::LatencyBreakdown(std::vector<std::string> hops, double report_interval)
+    : hops_(std::move(hops)), report_interval_(report_interval)
+{
+  for (size_t i = 0; i < hops_.size(); i++)
+  {
+    histograms_.emplace_back(new LatencyHistogram());
+  }
+}
+
+void LatencyBreakdown::record(size_t hop, int64_t nanoseconds)
+{
+  histograms_[hop]->record(static_cast<uint64_t>(nanoseconds < 0 ? 0 : nanoseconds));
+}
+
+bool LatencyBreakdown::writeToFile(const std::string &filename) const
+{
+  std::FILE *file = std::fopen(filename.c_str(), "w");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  std::fprintf(file, "%-24s %10s %10s %10s %10s %10s %10s\n", "# hop (ms)", "count", "mean", "p50", "p90", "p99",
+               "max");
+  for (size_t i = 0; i < hops_.size(); i++)
+  {
+    const LatencyHistogram &histogram = *histograms_[i];
+    std::fprintf(file, "%-24s %10llu %10.3f %10.3f %10.3f %10.3f %10.3f\n", hops_[i].c_str(),
+                 static_cast<unsigned long long>(histogram.count()), 1e-6 * histogram.mean(),
+                 1e-6 * histogram.percentile(50.0), 1e-6 * histogram.percentile(90.0),
+                 1e-6 * histogram.percentile(99.0), 1e-6 * histogram.max());
+  }
+  return std::fclose(file) == 0;
+}
+
+} // namespace ev3
+} // namespace isaac
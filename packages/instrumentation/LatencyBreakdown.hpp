@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LatencyHistogram.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// Latency histograms for the hops of a pipeline, for example from a sensor reading to the motor
+// command it caused. Every hop has its own histogram; the last hop is usually the total.
+class LatencyBreakdown {
+ public:
+  explicit LatencyBreakdown(std::vector<std::string> hops, double report_interval = 1.0);
+
+  // Records the duration of a hop in nanoseconds, negative durations are counted as 0
+  void record(size_t hop, int64_t nanoseconds);
+
+  // Calls `show(tag, value)` with p50 and p99 of every hop in milliseconds if the last report is
+  // older than the report interval. `time` is in seconds.
+  template <typename Show>
+  void report(double time, Show&& show) {
+    if (time < next_report_) return;
+    next_report_ = time + report_interval_;
+    for (size_t i = 0; i < hops_.size(); i++) {
+      show((hops_[i] + " p50 (ms)").c_str(), 1e-6 * histograms_[i]->percentile(50.0));
+      show((hops_[i] + " p99 (ms)").c_str(), 1e-6 * histograms_[i]->percentile(99.0));
+    }
+  }
+
+  // Writes a table with count, mean, p50, p90, p99 and max of every hop in milliseconds. Returns
+  // false on failure.
+  bool writeToFile(const std::string& filename) const;
+
+  const std::vector<std::string>& hops() const { return hops_; }
+  const LatencyHistogram& histogram(size_t hop) const { return *histograms_[hop]; }
+
+ private:
+  std::vector<std::string> hops_;
+  std::vector<std::unique_ptr<LatencyHistogram>> histograms_;
+  double report_interval_;
+  double next_report_ = 0.0;
+};
+
+}  // namespace ev3
+}  // namespace isaac
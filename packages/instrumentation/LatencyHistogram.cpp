@@ -0,0 +1,133 @@
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+
+// Index of the highest set bit, value must not be 0
+int highestBit(uint64_t value)
+{
+  return 63 - __builtin_clzll(value);
+}
+
+} // namespace
+
+size_t LatencyHistogram::bucketIndex(uint64_t value)
+{
+  if (value < kSubBucketCount)
+  {
+    return value;
+  }
+  value = std::min(value, (uint64_t(1) << kMaxExponent) - 1);
+  const int exponent = highestBit(value);
+  // the top kSubBucketBits + 1 bits, the leading one is dropped
+  const uint64_t sub_bucket = (value >> (exponent - kSubBucketBits)) - kSubBucketCount;
+  return (exponent - kSubBucketBits + 1) * kSubBucketCount + sub_bucket;
+}
+
+uint64_t LatencyHistogram::bucketLowerBound(size_t index)
+{
+  if (index < kSubBucketCount)
+  {
+    return index;
+  }
+  const int exponent = index / kSubBucketCount + kSubBucketBits - 1;
+  const uint64_t sub_bucket = index % kSubBucketCount;
+  return (kSubBucketCount + sub_bucket) << (exponent - kSubBucketBits);
+}
+
+uint64_t LatencyHistogram::bucketWidth(size_t index)
+{
+  if (index < kSubBucketCount)
+  {
+    return 1;
+  }
+  const int exponent = index / kSubBucketCount + kSubBucketBits - 1;
+  return uint64_t(1) << (exponent - kSubBucketBits);
+}
+
+void LatencyHistogram::reset()
+{
+  for (auto &bucket : buckets_)
+  {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const
+{
+  const uint64_t n = count();
+  return n == 0 ? 0.0 : static_cast<double>(sum_.load(std::memory_order_relaxed)) / n;
+}
+
+uint64_t LatencyHistogram::percentile(double percentile) const
+{
+  const uint64_t n = count();
+  if (n == 0)
+  {
+    return 0;
+  }
+  const double fraction = std::max(0.0, std::min(100.0, percentile)) / 100.0;
+  const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * n)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBucketCount; i++)
+  {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank)
+    {
+      return std::min(max(), bucketLowerBound(i) + bucketWidth(i) / 2);
+    }
+  }
+  // records in flight may make the buckets lag behind the count
+  return max();
+}
+
+void LatencyHistogram::write(std::FILE *file) const
+{
+  const uint64_t n = count();
+  std::fprintf(file, "# count %llu\n", static_cast<unsigned long long>(n));
+  std::fprintf(file, "# mean_ns %.1f\n", mean());
+  const double percentiles[] = {50.0, 90.0, 99.0, 99.9, 100.0};
+  for (double p : percentiles)
+  {
+    std::fprintf(file, "# p%g_ns %llu\n", p, static_cast<unsigned long long>(percentile(p)));
+  }
+  std::fprintf(file, "# max_ns %llu\n", static_cast<unsigned long long>(max()));
+  std::fprintf(file, "# value_ns count cumulative_fraction\n");
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBucketCount; i++)
+  {
+    const uint64_t bucket = buckets_[i].load(std::memory_order_relaxed);
+    if (bucket == 0)
+    {
+      continue;
+    }
+    seen += bucket;
+    std::fprintf(file, "%llu %llu %.6f\n", static_cast<unsigned long long>(bucketLowerBound(i)),
+                 static_cast<unsigned long long>(bucket), n == 0 ? 0.0 : static_cast<double>(seen) / n);
+  }
+}
+
+bool LatencyHistogram::writeToFile(const char *filename) const
+{
+  std::FILE *file = std::fopen(filename, "w");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  write(file);
+  return std::fclose(file) == 0;
+}
+
+} // namespace ev3
+} // namespace isaac
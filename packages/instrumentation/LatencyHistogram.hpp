@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace isaac {
+namespace ev3 {
+
+// A histogram of durations in nanoseconds with a fixed relative precision, in the spirit of
+// HdrHistogram. Values below 32 ns are counted exactly, bigger values fall into one of 32 linear
+// sub-buckets per power of two, which bounds the error to about 3%. Values up to 2^41 ns (about
+// 36 minutes) are tracked, bigger ones are clamped.
+//
+// Recording is lock-free and wait-free apart from the maximum, thus any number of threads can
+// record while another one reads percentiles. Reads are not a consistent snapshot while records
+// are in flight, which is fine for monitoring.
+class LatencyHistogram {
+ public:
+  // Number of sub-buckets per power of two, as a power of two
+  static constexpr int kSubBucketBits = 5;
+  static constexpr uint64_t kSubBucketCount = uint64_t(1) << kSubBucketBits;
+  // Largest tracked value is 2^kMaxExponent - 1
+  static constexpr int kMaxExponent = 41;
+  static constexpr size_t kBucketCount = (kMaxExponent - kSubBucketBits + 1) * kSubBucketCount;
+
+  LatencyHistogram() { reset(); }
+
+  // Records one duration in nanoseconds
+  void record(uint64_t nanoseconds) {
+    buckets_[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(nanoseconds, std::memory_order_relaxed);
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (nanoseconds > max && !max_.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {
+    }
+  }
+  // Records one duration
+  template <typename Rep, typename Period>
+  void record(std::chrono::duration<Rep, Period> duration) {
+    const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    record(static_cast<uint64_t>(nanoseconds < 0 ? 0 : nanoseconds));
+  }
+
+  // Forgets all values. Must not be called while other threads record.
+  void reset();
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+  double mean() const;
+  // Value below which `percentile` percent of the values are, e.g. 99.0. Returns the middle of the
+  // bucket holding that value, but never more than the maximum. Returns 0 if nothing was recorded.
+  uint64_t percentile(double percentile) const;
+
+  // Writes a summary and the non-empty buckets with their cumulative fraction as text
+  void write(std::FILE* file) const;
+  // Writes to a file, returns false on failure
+  bool writeToFile(const char* filename) const;
+
+  // Index of the bucket holding a value and the smallest value of a bucket
+  static size_t bucketIndex(uint64_t value);
+  static uint64_t bucketLowerBound(size_t index);
+  static uint64_t bucketWidth(size_t index);
+
+ private:
+  std::array<std::atomic<uint64_t>, kBucketCount> buckets_;
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+};
+
+// Records the time from construction to destruction into a histogram
+class ScopeTimer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit ScopeTimer(LatencyHistogram& histogram) : histogram_(&histogram), begin_(Clock::now()) {}
+  ScopeTimer(ScopeTimer&& other) : histogram_(other.histogram_), begin_(other.begin_) {
+    other.histogram_ = nullptr;
+  }
+  ScopeTimer(const ScopeTimer&) = delete;
+  ScopeTimer& operator=(const ScopeTimer&) = delete;
+  ScopeTimer& operator=(ScopeTimer&&) = delete;
+  ~ScopeTimer() {
+    if (histogram_ != nullptr) histogram_->record(Clock::now() - begin_);
+  }
+
+ private:
+  LatencyHistogram* histogram_;
+  Clock::time_point begin_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
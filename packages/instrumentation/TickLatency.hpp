@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+
+#include "LatencyHistogram.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// Tick latency of a codelet. Usage:
+//
+//   void MyCodelet::tick() {
+//     const auto timer = tick_latency_.measure();
+//     tick_latency_.report(getTickTime(), [this](const char* tag, double value) { show(tag, value); });
+//     ...
+//   }
+//   void MyCodelet::stop() { tick_latency_.dump(full_name()); }
+//
+// p50, p99 and the maximum are reported in milliseconds once per report interval.
+class TickLatency {
+ public:
+  explicit TickLatency(double report_interval = 1.0) : report_interval_(report_interval) {}
+
+  // Measures until the returned timer goes out of scope
+  ScopeTimer measure() { return ScopeTimer(histogram_); }
+
+  // Calls `show(tag, value)` with the latency statistics if the last report is older than the
+  // report interval. `time` is in seconds, for example the tick time.
+  template <typename Show>
+  void report(double time, Show&& show) {
+    if (time < next_report_) return;
+    next_report_ = time + report_interval_;
+    show("tick p50 (ms)", 1e-6 * histogram_.percentile(50.0));
+    show("tick p99 (ms)", 1e-6 * histogram_.percentile(99.0));
+    show("tick max (ms)", 1e-6 * histogram_.max());
+  }
+
+  // Writes the histogram to <directory>/tick_latency_<name>.txt, slashes in the name are replaced.
+  // Returns false on failure.
+  bool dump(std::string name, const std::string& directory = "/tmp") const {
+    std::replace(name.begin(), name.end(), '/', '.');
+    return histogram_.writeToFile((directory + "/tick_latency_" + name + ".txt").c_str());
+  }
+
+  const LatencyHistogram& histogram() const { return histogram_; }
+
+ private:
+  LatencyHistogram histogram_;
+  double report_interval_;
+  double next_report_ = 0.0;
+};
+
+}  // namespace ev3
+}  // namespace isaac
@@ -1,5 +1,11 @@
 #include "LidarAngleChanger.hpp"
 
+#include <utility>
+
+#include "ScanTransform.hpp"
+#include "engine/core/tensor/tensor.hpp"
+#include "messages/tensor.hpp"
+
 namespace isaac {
 namespace ev3 {
 
@@ -8,30 +14,46 @@ void LidarAngleChanger::start() {
 }
 
 void LidarAngleChanger::stop() {
+  tick_latency_.dump(full_name());
 }
 
 void LidarAngleChanger::tick() {
-
-    auto lidar_proto = rx_scan().getProto();    
-    auto lidar_return_proto = tx_flatscan().initProto();
-    
-    lidar_return_proto.setRanges(lidar_proto.getRanges());
-    lidar_return_proto.setInvalidRangeThreshold(lidar_proto.getInvalidRangeThreshold());
-    lidar_return_proto.setOutOfRangeThreshold(lidar_proto.getOutOfRangeThreshold());
-    if(lidar_proto.getVisibilities().size()>0){
-      lidar_return_proto.setVisibilities(lidar_proto.getVisibilities());
+    const auto timer = tick_latency_.measure();
+    tick_latency_.report(getTickTime(), [this](const char* tag, double value) { show(tag, value); });
+
+    const auto scan = rx_scan().getProto();
+    const bool use_mount_transform = get_use_mount_transform();
+    const bool publish_points = get_publish_points();
+    if (use_mount_transform || publish_points) {
+      const Vector2d offset = get_mount_offset();
+      const LidarMount mount = use_mount_transform
+          ? LidarMount{static_cast<float>(get_mount_angle()), get_mount_flip(),
+                       static_cast<float>(offset.x()), static_cast<float>(offset.y())}
+          : kMirrorMount;
+      if (directions_.update(scan.getAngles(), mount, static_cast<float>(get_angle_tolerance()))) {
+        show("directions.updates", ++directions_updates_);
+      }
     }
-    
-    auto angles = lidar_proto.getAngles();
-    auto changed_angles = lidar_return_proto.initAngles(angles.size());
-    
-    for(uint i = 0; i<angles.size();i++) {
-        changed_angles.set(i,-angles[i]);
-    }    
 
+    if (use_mount_transform) {
+      TransformFlatscan(scan, directions_, tx_flatscan().initProto());
+    } else {
+      MirrorFlatscan(scan, tx_flatscan().initProto());
+    }
 
-    tx_flatscan().publish();
+    // keep the acquisition time of the scan rather than the tick time, consumers see when the lidar
+    // measured and it is the origin of the latency traces of Ev3Driver
+    tx_flatscan().publish(rx_scan().acqtime());
+
+    if (publish_points) {
+      const int count = scan.getRanges().size();
+      Tensor2f points(2, count);
+      float* xs = points.element_wise_begin();
+      ScanToPoints(scan, directions_, xs, xs + count);
+      ToProto(std::move(points), tx_points().initProto(), tx_points().buffers());
+      tx_points().publish(rx_scan().acqtime());
+    }
 }
 
 }  // namespace ev3
-}  // namespace isaac
\ No newline at end of file
+}  // namespace isaac
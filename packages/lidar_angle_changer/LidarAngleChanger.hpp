@@ -4,10 +4,16 @@
 
 #include "engine/alice/alice.hpp"
 #include "messages/messages.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
+#include "packages/lidar_angle_changer/ScanTransform.hpp"
 
 namespace isaac {
 namespace ev3{
 
+// Turns the scans of the YdLidar into the frame of the robot. By default the angles are negated;
+// with `use_mount_transform` the scan is mirrored, rotated and moved as configured by the mount
+// parameters instead. Optionally publishes the beams as points in the robot frame, so that
+// consumers do not need to compute the sines and cosines of the beams themselves.
 class LidarAngleChanger : public isaac::alice::Codelet {
  public:
 
@@ -17,6 +23,27 @@ class LidarAngleChanger : public isaac::alice::Codelet {
 
   ISAAC_PROTO_RX(FlatscanProto, scan);
   ISAAC_PROTO_TX(FlatscanProto, flatscan);
+  // The beams of flatscan as a 2 x N tensor of x in the first and y in the second row, in meters.
+  // Invalid and out of range beams are NaN.
+  ISAAC_PROTO_TX(TensorProto, points);
+
+  // Apply the mount below instead of only negating the angles
+  ISAAC_PARAM(bool, use_mount_transform, false);
+  // Rotation of the lidar on the robot in radians, applied after flipping
+  ISAAC_PARAM(double, mount_angle, 0.0);
+  // Mirror the beams first, the YdLidar measures clockwise
+  ISAAC_PARAM(bool, mount_flip, true);
+  // Position of the lidar on the robot in meters, only applies to points
+  ISAAC_PARAM(Vector2d, mount_offset, Vector2d::Zero());
+  // Publish points
+  ISAAC_PARAM(bool, publish_points, false);
+  // Largest change of the beam angles in radians for which the cached directions are reused
+  ISAAC_PARAM(double, angle_tolerance, 1e-5);
+
+ private:
+  TickLatency tick_latency_;
+  BeamDirections directions_;
+  int directions_updates_ = 0;
 
 };
 
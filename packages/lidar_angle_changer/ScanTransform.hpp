@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace isaac {
+namespace ev3 {
+
+// Copies a flatscan into `changed` with negated angles, which turns the scan of the YdLidar into
+// the frame of the robot. Works on any pair of FlatscanProto reader and builder.
+template <typename Reader, typename Builder>
+void MirrorFlatscan(Reader scan, Builder changed) {
+  changed.setRanges(scan.getRanges());
+  changed.setInvalidRangeThreshold(scan.getInvalidRangeThreshold());
+  changed.setOutOfRangeThreshold(scan.getOutOfRangeThreshold());
+  if (scan.getVisibilities().size() > 0) {
+    changed.setVisibilities(scan.getVisibilities());
+  }
+  auto angles = scan.getAngles();
+  auto changed_angles = changed.initAngles(angles.size());
+  for (unsigned int i = 0; i < angles.size(); i++) {
+    changed_angles.set(i, -angles[i]);
+  }
+}
+
+// Pose of the lidar on the robot. A beam is mirrored first if `flip` is set, which turns the
+// clockwise angles of the YdLidar counter-clockwise, then rotated by `angle` and moved by the
+// offset.
+struct LidarMount {
+  float angle;
+  bool flip;
+  float offset_x;
+  float offset_y;
+};
+
+// The mount which MirrorFlatscan assumes
+constexpr LidarMount kMirrorMount{0.0f, true, 0.0f, 0.0f};
+
+// Directions of the beams of a scan in the robot frame. The sines and cosines are only computed
+// again when the angles of the scan or the mount change, the YdLidar sends the same angles in
+// every scan.
+class BeamDirections {
+ public:
+  // Takes the angles of a scan, a capnp list of floats. Angles which differ by at most `tolerance`
+  // from the ones the directions were computed for count as unchanged. Returns true if the
+  // directions were computed again.
+  template <typename Angles>
+  bool update(Angles angles, const LidarMount& mount, float tolerance = 0.0f) {
+    if (isCached(angles, mount, tolerance)) {
+      return false;
+    }
+    const unsigned int count = angles.size();
+    source_angles_.resize(count);
+    angles_.resize(count);
+    cos_.resize(count);
+    sin_.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+      source_angles_[i] = angles[i];
+      angles_[i] = (mount.flip ? -angles[i] : angles[i]) + mount.angle;
+      cos_[i] = std::cos(angles_[i]);
+      sin_[i] = std::sin(angles_[i]);
+    }
+    mount_ = mount;
+    valid_ = true;
+    return true;
+  }
+
+  // Angles of the beams in the robot frame
+  const std::vector<float>& angles() const { return angles_; }
+  const std::vector<float>& cos() const { return cos_; }
+  const std::vector<float>& sin() const { return sin_; }
+  const LidarMount& mount() const { return mount_; }
+
+ private:
+  template <typename Angles>
+  bool isCached(Angles angles, const LidarMount& mount, float tolerance) const {
+    if (!valid_ || angles.size() != source_angles_.size() || mount.angle != mount_.angle ||
+        mount.flip != mount_.flip || mount.offset_x != mount_.offset_x ||
+        mount.offset_y != mount_.offset_y) {
+      return false;
+    }
+    for (unsigned int i = 0; i < angles.size(); i++) {
+      if (std::abs(angles[i] - source_angles_[i]) > tolerance) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool valid_ = false;
+  LidarMount mount_{};
+  std::vector<float> source_angles_;
+  std::vector<float> angles_;
+  std::vector<float> cos_;
+  std::vector<float> sin_;
+};
+
+// Copies a flatscan into `changed` with the angles of `directions`, which were updated with the
+// angles of the scan. The offset of the mount can not be expressed in a flatscan, it only applies
+// to ScanToPoints.
+template <typename Reader, typename Builder>
+void TransformFlatscan(Reader scan, const BeamDirections& directions, Builder changed) {
+  changed.setRanges(scan.getRanges());
+  changed.setInvalidRangeThreshold(scan.getInvalidRangeThreshold());
+  changed.setOutOfRangeThreshold(scan.getOutOfRangeThreshold());
+  if (scan.getVisibilities().size() > 0) {
+    changed.setVisibilities(scan.getVisibilities());
+  }
+  const std::vector<float>& angles = directions.angles();
+  auto changed_angles = changed.initAngles(angles.size());
+  for (unsigned int i = 0; i < angles.size(); i++) {
+    changed_angles.set(i, angles[i]);
+  }
+}
+
+// Writes the beams of a flatscan as points in the robot frame into the arrays `xs` and `ys`, which
+// hold one element per beam. Beams which are invalid or out of range become NaN, thus the points
+// keep the order of the beams, as do beams without a direction if the scan has fewer angles than
+// ranges.
+template <typename Reader>
+void ScanToPoints(Reader scan, const BeamDirections& directions, float* xs, float* ys) {
+  auto ranges = scan.getRanges();
+  const float min_range = scan.getInvalidRangeThreshold();
+  const float max_range = scan.getOutOfRangeThreshold();
+  const float offset_x = directions.mount().offset_x;
+  const float offset_y = directions.mount().offset_y;
+  const float* cos = directions.cos().data();
+  const float* sin = directions.sin().data();
+  const unsigned int count = directions.cos().size();
+  for (unsigned int i = 0; i < ranges.size(); i++) {
+    const float range = ranges[i];
+    // out of range like in the consumers of flatscans, a range at the threshold is no hit
+    const bool valid = i < count && range >= min_range && range < max_range;
+    xs[i] = valid ? offset_x + range * cos[i] : std::numeric_limits<float>::quiet_NaN();
+    ys[i] = valid ? offset_y + range * sin[i] : std::numeric_limits<float>::quiet_NaN();
+  }
+}
+
+}  // namespace ev3
+}  // namespace isaac
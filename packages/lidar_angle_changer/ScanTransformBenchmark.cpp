@@ -0,0 +1,172 @@
+// Measures the scan transform of LidarAngleChanger::tick, from the received FlatscanProto into a
+// new message like the one of tx_flatscan. The input is a YdLidar X4 scan of 720 beams in a room
+// of 4 x 3 m.
+//
+// Also compares three consumers of a scan, like the local map, gmapping and the scan matcher, which
+// each compute the sines and cosines of the beams, with consumers of the points of
+// LidarAngleChanger, which computes them once per angle set. The cartesian case includes writing
+// the points into a TensorProto like LidarAngleChanger and reading them back like ScanOdometry.
+//
+//   scan_transform_benchmark [--benchmark_out=PATH]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include <capnp/message.h>
+
+#include "ScanTransform.hpp"
+#include "engine/core/tensor/tensor.hpp"
+#include "messages/range_scan.capnp.h"
+#include "messages/tensor.hpp"
+#include "packages/utils/Benchmark.hpp"
+
+using namespace isaac::ev3;
+
+namespace
+{
+
+constexpr int kBeams = 720;
+constexpr int kConsumers = 3;
+
+// A scan from the middle of a rectangular room, with ranges beyond the lidar reported as 0
+void makeScan(FlatscanProto::Builder scan)
+{
+  auto ranges = scan.initRanges(kBeams);
+  auto angles = scan.initAngles(kBeams);
+  for (int i = 0; i < kBeams; i++)
+  {
+    const float angle = -float(M_PI) + 2.0f * float(M_PI) * i / kBeams;
+    const float range = std::min(2.0f / std::max(1e-6f, std::abs(std::cos(angle))),
+                                 1.5f / std::max(1e-6f, std::abs(std::sin(angle))));
+    ranges.set(i, range < 10.0f ? range : 0.0f);
+    angles.set(i, angle);
+  }
+  scan.setInvalidRangeThreshold(0.1);
+  scan.setOutOfRangeThreshold(10.0);
+}
+
+// What a consumer does with a point, here the bounding box of the scan
+struct Bounds
+{
+  float min_x = 0.0f, max_x = 0.0f, min_y = 0.0f, max_y = 0.0f;
+  void add(float x, float y)
+  {
+    min_x = std::min(min_x, x);
+    max_x = std::max(max_x, x);
+    min_y = std::min(min_y, y);
+    max_y = std::max(max_y, y);
+  }
+};
+
+// A consumer of the flatscan of LidarAngleChanger, which turns the beams into points itself
+Bounds consumeFlatscan(FlatscanProto::Reader scan)
+{
+  Bounds bounds;
+  auto ranges = scan.getRanges();
+  auto angles = scan.getAngles();
+  const float min_range = scan.getInvalidRangeThreshold();
+  const float max_range = scan.getOutOfRangeThreshold();
+  for (unsigned int i = 0; i < ranges.size(); i++)
+  {
+    const float range = ranges[i];
+    if (range >= min_range && range < max_range)
+    {
+      bounds.add(range * std::cos(angles[i]), range * std::sin(angles[i]));
+    }
+  }
+  return bounds;
+}
+
+// A consumer of the points of LidarAngleChanger, a 2 x N tensor with NaN for invalid beams
+Bounds consumePoints(const isaac::CpuTensorConstView2f &points)
+{
+  Bounds bounds;
+  const int count = points.dimensions()[1];
+  for (int i = 0; i < count; i++)
+  {
+    if (!std::isnan(points(0, i)))
+    {
+      bounds.add(points(0, i), points(1, i));
+    }
+  }
+  return bounds;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const std::string json_path = ParseBenchmarkOut(argc, argv);
+  capnp::MallocMessageBuilder input;
+  makeScan(input.initRoot<FlatscanProto>());
+  const FlatscanProto::Reader scan = input.getRoot<FlatscanProto>().asReader();
+
+  std::vector<BenchmarkResult> results;
+  // every tick publishes a new message
+  results.push_back(RunBenchmark("LidarAngleChanger transform",
+                                 [&] {
+                                   capnp::MallocMessageBuilder output;
+                                   auto changed = output.initRoot<FlatscanProto>();
+                                   MirrorFlatscan(scan, changed);
+                                   DoNotOptimize(changed.getAngles()[kBeams - 1]);
+                                 },
+                                 kBeams));
+  BeamDirections directions;
+  directions.update(scan.getAngles(), kMirrorMount);
+  results.push_back(RunBenchmark("LidarAngleChanger mount transform",
+                                 [&] {
+                                   capnp::MallocMessageBuilder output;
+                                   auto changed = output.initRoot<FlatscanProto>();
+                                   directions.update(scan.getAngles(), kMirrorMount, 1e-5f);
+                                   TransformFlatscan(scan, directions, changed);
+                                   DoNotOptimize(changed.getAngles()[kBeams - 1]);
+                                 },
+                                 kBeams));
+  // a new angle set, e.g. when the mount is calibrated
+  results.push_back(RunBenchmark("beam directions update",
+                                 [&] {
+                                   BeamDirections fresh;
+                                   fresh.update(scan.getAngles(), kMirrorMount);
+                                   DoNotOptimize(fresh.cos()[kBeams - 1]);
+                                 },
+                                 kBeams));
+
+  // consumers of the flatscan, each computes sines and cosines
+  capnp::MallocMessageBuilder mirrored;
+  MirrorFlatscan(scan, mirrored.initRoot<FlatscanProto>());
+  const FlatscanProto::Reader flatscan = mirrored.getRoot<FlatscanProto>().asReader();
+  results.push_back(RunBenchmark("3 consumers polar",
+                                 [&] {
+                                   for (int i = 0; i < kConsumers; i++)
+                                   {
+                                     DoNotOptimize(consumeFlatscan(flatscan).max_x);
+                                   }
+                                 },
+                                 kBeams));
+  // LidarAngleChanger writes the points once with the cached directions into a new message, the
+  // consumers read them from it
+  results.push_back(RunBenchmark("3 consumers cartesian",
+                                 [&] {
+                                   capnp::MallocMessageBuilder output;
+                                   std::vector<isaac::SharedBuffer> buffers;
+                                   directions.update(scan.getAngles(), kMirrorMount, 1e-5f);
+                                   isaac::Tensor2f points(2, kBeams);
+                                   float *xs = points.element_wise_begin();
+                                   ScanToPoints(scan, directions, xs, xs + kBeams);
+                                   ToProto(std::move(points), output.initRoot<TensorProto>(), buffers);
+                                   for (int i = 0; i < kConsumers; i++)
+                                   {
+                                     isaac::CpuTensorConstView2f received;
+                                     if (!FromProto(output.getRoot<TensorProto>().asReader(), buffers, received))
+                                     {
+                                       std::abort();
+                                     }
+                                     DoNotOptimize(consumePoints(received).max_x);
+                                   }
+                                 },
+                                 kBeams));
+  return ReportBenchmarks(results, argv[0], json_path) ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+#include "LidarSimulator.hpp"
+
+#include <algorithm>
+
+#include "engine/gems/state/io.hpp"
+#include "messages/state/differential_base.hpp"
+#include "packages/map_cache/MapAsset.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+void LidarSimulator::start() {
+  map_loaded_ = loadMap(get_map_config());
+  if (!map_loaded_) {
+    return;
+  }
+  const int count = std::max(1, get_beam_count());
+  const double min_angle = get_min_angle();
+  const double step = (get_max_angle() - min_angle) / count;
+  angles_.resize(count);
+  ranges_.resize(count);
+  for (int i = 0; i < count; i++) {
+    angles_[i] = static_cast<float>(min_angle + i * step);
+  }
+  const Vector3d pose = get_initial_pose();
+  world_T_robot_ = Pose2d::FromXYA(pose[0], pose[1], pose[2]);
+  last_time_ = getTickTime();
+  pool_.reset(new WorkerPool(std::max(0, get_threads())));
+  tickPeriodically();
+}
+
+void LidarSimulator::stop() {
+  pool_.reset();
+  tick_latency_.dump(full_name());
+}
+
+bool LidarSimulator::loadMap(const std::string& config_path) {
+  OccupancyConfig config;
+  if (!LoadOccupancyConfig(config_path, config)) {
+    return false;
+  }
+  const std::string& cache_directory = get_map_cache_directory();
+  if (!cache_directory.empty() && OpenMapCache(config, cache_directory, map_cache_)) {
+    caster_.setDistances(map_cache_.distances(), map_cache_.rows(), map_cache_.cols(),
+                         config.cell_size);
+  } else {
+    std::vector<uint8_t> occupied;
+    int rows, cols;
+    if (!LoadOccupancy(config, occupied, rows, cols)) {
+      return false;
+    }
+    caster_.setMap(occupied.data(), rows, cols, config.cell_size);
+  }
+  LOG_INFO("Simulating lidar in map '%s' with %dx%d cells of %f m", config.filename.c_str(),
+           caster_.rows(), caster_.cols(), config.cell_size);
+  return true;
+}
+
+void LidarSimulator::integrateBaseState(double time) {
+  const double dt = time - last_time_;
+  last_time_ = time;
+  // the speeds of the last state hold until the next one arrives
+  world_T_robot_ = world_T_robot_ *
+                   Pose2d::FromXYA(linear_speed_ * dt, 0.0, angular_speed_ * dt);
+  if (rx_base_state().available()) {
+    messages::DifferentialBaseDynamics state;
+    if (FromProto(rx_base_state().getProto(), rx_base_state().buffers(), state)) {
+      linear_speed_ = state.linear_speed();
+      angular_speed_ = state.angular_speed();
+    }
+  }
+}
+
+void LidarSimulator::tick() {
+  const auto timer = tick_latency_.measure();
+  tick_latency_.report(getTickTime(), [this](const char* tag, double value) { show(tag, value); });
+
+  const double time = getTickTime();
+  integrateBaseState(time);
+  Pose2d world_T_robot = world_T_robot_;
+  if (get_use_pose_tree()) {
+    bool ok;
+    const Pose2d pose = get_world_T_robot(time, ok);
+    if (!ok) {
+      return;
+    }
+    world_T_robot = pose;
+  }
+
+  const float max_range = static_cast<float>(get_max_range());
+  caster_.cast(world_T_robot.translation.x(), world_T_robot.translation.y(),
+               world_T_robot.rotation.angle(), angles_.data(), angles_.size(), max_range,
+               ranges_.data(), *pool_);
+
+  auto proto = tx_flatscan().initProto();
+  proto.setInvalidRangeThreshold(get_min_range());
+  proto.setOutOfRangeThreshold(max_range);
+  auto ranges = proto.initRanges(ranges_.size());
+  auto angles = proto.initAngles(angles_.size());
+  for (size_t i = 0; i < ranges_.size(); i++) {
+    ranges.set(i, ranges_[i]);
+    angles.set(i, angles_[i]);
+  }
+  tx_flatscan().publish();
+
+  show("x", world_T_robot.translation.x());
+  show("y", world_T_robot.translation.y());
+  show("heading", world_T_robot.rotation.angle());
+}
+
+}  // namespace ev3
+}  // namespace isaac
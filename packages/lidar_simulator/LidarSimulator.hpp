@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MapRayCaster.hpp"
+
+#include "engine/alice/alice.hpp"
+#include "messages/messages.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
+#include "packages/map_cache/MapCache.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// Simulates the YdLidar by casting beams into the occupancy map used for navigation, so that the
+// EV3 apps run without the lidar. Scans are published in the same frame as LidarAngleChanger,
+// i.e. counter-clockwise angles in the robot frame.
+//
+// The simulated robot starts at `initial_pose` and integrates the speeds reported on base_state,
+// which also works with ev3_mock_server. If `use_pose_tree` is enabled the robot pose is read from
+// world_T_robot instead, e.g. when another simulator owns the ground truth.
+class LidarSimulator : public isaac::alice::Codelet {
+ public:
+  void start() override;
+  void stop() override;
+  void tick() override;
+
+  // Speeds reported by the base, used to move the simulated robot
+  ISAAC_PROTO_RX(StateProto, base_state);
+  // Simulated scan
+  ISAAC_PROTO_TX(FlatscanProto, flatscan);
+
+  // Map config file as written by the Isaac map editor
+  ISAAC_PARAM(std::string, map_config, "apps/assets/maps/map.config.json");
+  // Directory of the map cache holding the distance transform of the map, which is built on the
+  // first start and again after the map image changed. The map is loaded without cache if empty.
+  ISAAC_PARAM(std::string, map_cache_directory, "/tmp/ev3_map_cache");
+  // Number of beams per scan, spread evenly over [min_angle, max_angle)
+  ISAAC_PARAM(int, beam_count, 720);
+  ISAAC_PARAM(double, min_angle, -M_PI);
+  ISAAC_PARAM(double, max_angle, M_PI);
+  // Beams shorter than min_range are invalid and longer ones are out of range, like the YdLidar X4
+  ISAAC_PARAM(double, min_range, 0.12);
+  ISAAC_PARAM(double, max_range, 10.0);
+  // Threads used to cast a scan, 0 for all cores. They are started once in start().
+  ISAAC_PARAM(int, threads, 1);
+  // Pose of the simulated robot in the map at start as (x, y, heading)
+  ISAAC_PARAM(Vector3d, initial_pose, Vector3d(2.0, 2.0, 0.0));
+  // Read the robot pose from the pose tree instead of integrating base_state
+  ISAAC_PARAM(bool, use_pose_tree, false);
+  ISAAC_POSE2(world, robot);
+
+ private:
+  // Loads the occupancy grid referenced by the map config, false on failure
+  bool loadMap(const std::string& config_path);
+  // Advances the simulated robot to the tick time
+  void integrateBaseState(double time);
+
+  MapRayCaster caster_;
+  std::unique_ptr<WorkerPool> pool_;
+  // holds the distances of caster_ if the map was loaded from the cache
+  MapCache map_cache_;
+  bool map_loaded_ = false;
+  std::vector<float> angles_;
+  std::vector<float> ranges_;
+  Pose2d world_T_robot_;
+  double linear_speed_ = 0.0;
+  double angular_speed_ = 0.0;
+  double last_time_ = 0.0;
+  TickLatency tick_latency_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
+
+ISAAC_ALICE_REGISTER_CODELET(isaac::ev3::LidarSimulator);
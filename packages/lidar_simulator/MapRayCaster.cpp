@@ -0,0 +1,193 @@
+#include "MapRayCaster.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+
+// Four lanes, NEON on the Jetson and SSE on the host
+using Float4 = float __attribute__((vector_size(16)));
+using Int4 = int32_t __attribute__((vector_size(16)));
+
+// Beams handed to one thread at a time
+constexpr size_t kBeamsPerTask = 64;
+// Smallest step in cells, bounds the range error next to obstacles
+constexpr float kMinStep = 0.5f;
+
+// Squared distance transform along one line (Felzenszwalb and Huttenlocher), in place
+void distanceTransform1d(float *f, int n, std::vector<int> &v, std::vector<float> &z, std::vector<float> &d)
+{
+  v.resize(n);
+  z.resize(n + 1);
+  d.resize(n);
+  int k = 0;
+  v[0] = 0;
+  z[0] = -std::numeric_limits<float>::infinity();
+  z[1] = std::numeric_limits<float>::infinity();
+  for (int q = 1; q < n; q++)
+  {
+    float s;
+    while (true)
+    {
+      const int p = v[k];
+      s = ((f[q] + q * q) - (f[p] + p * p)) / (2.0f * (q - p));
+      if (s > z[k] || k == 0)
+        break;
+      k--;
+    }
+    if (s <= z[k])
+    {
+      // only possible for k == 0 with infinite values on both sides
+      s = z[k];
+    }
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = std::numeric_limits<float>::infinity();
+  }
+  k = 0;
+  for (int q = 0; q < n; q++)
+  {
+    while (z[k + 1] < q)
+      k++;
+    const float dq = q - v[k];
+    d[q] = dq * dq + f[v[k]];
+  }
+  std::copy(d.begin(), d.end(), f);
+}
+
+} // namespace
+
+void ComputeDistanceTransform(const uint8_t *occupied, int rows, int cols, std::vector<uint8_t> &distances)
+{
+  // large but finite, keeps the parabola intersections finite
+  const float kFar = 1e12f;
+  std::vector<float> squared(size_t(rows) * cols);
+  for (size_t i = 0; i < squared.size(); i++)
+  {
+    squared[i] = occupied[i] ? 0.0f : kFar;
+  }
+  std::vector<int> v;
+  std::vector<float> z, d;
+  std::vector<float> column(rows);
+  for (int c = 0; c < cols; c++)
+  {
+    for (int r = 0; r < rows; r++)
+      column[r] = squared[size_t(r) * cols + c];
+    distanceTransform1d(column.data(), rows, v, z, d);
+    for (int r = 0; r < rows; r++)
+      squared[size_t(r) * cols + c] = column[r];
+  }
+  for (int r = 0; r < rows; r++)
+  {
+    distanceTransform1d(squared.data() + size_t(r) * cols, cols, v, z, d);
+  }
+  distances.resize(squared.size());
+  for (size_t i = 0; i < squared.size(); i++)
+  {
+    distances[i] = static_cast<uint8_t>(std::min(255.0f, std::floor(std::sqrt(squared[i]))));
+  }
+}
+
+void MapRayCaster::setMap(const uint8_t *occupied, int rows, int cols, float cell_size)
+{
+  rows_ = rows;
+  cols_ = cols;
+  cell_size_ = cell_size;
+  ComputeDistanceTransform(occupied, rows, cols, owned_distances_);
+  distances_ = owned_distances_.data();
+}
+
+void MapRayCaster::setDistances(const uint8_t *distances, int rows, int cols, float cell_size)
+{
+  rows_ = rows;
+  cols_ = cols;
+  cell_size_ = cell_size;
+  distances_ = distances;
+  owned_distances_.clear();
+  owned_distances_.shrink_to_fit();
+}
+
+void MapRayCaster::cast(float x, float y, float heading, const float *angles, size_t count, float max_range,
+                        float *ranges, size_t threads) const
+{
+  const size_t tasks = (count + kBeamsPerTask - 1) / kBeamsPerTask;
+  parallelFor(tasks, threads, [&](size_t task) {
+    castRange(x, y, heading, angles, task * kBeamsPerTask, std::min(count, (task + 1) * kBeamsPerTask), count,
+              max_range, ranges);
+  });
+}
+
+void MapRayCaster::cast(float x, float y, float heading, const float *angles, size_t count, float max_range,
+                        float *ranges, WorkerPool &pool) const
+{
+  const size_t tasks = (count + kBeamsPerTask - 1) / kBeamsPerTask;
+  pool.run(tasks, [&](size_t task) {
+    castRange(x, y, heading, angles, task * kBeamsPerTask, std::min(count, (task + 1) * kBeamsPerTask), count,
+              max_range, ranges);
+  });
+}
+
+void MapRayCaster::castRange(float x, float y, float heading, const float *angles, size_t begin, size_t end,
+                             size_t count, float max_range, float *ranges) const
+{
+  const float inverse_cell_size = 1.0f / cell_size_;
+  const float max_t = max_range * inverse_cell_size;
+  const Float4 rows = {float(rows_), float(rows_), float(rows_), float(rows_)};
+  const Float4 cols = {float(cols_), float(cols_), float(cols_), float(cols_)};
+  const float start_r = x * inverse_cell_size;
+  const float start_c = y * inverse_cell_size;
+  const uint8_t *distances = distances_;
+
+  for (size_t i = begin; i < end; i += 4)
+  {
+    // load four beams, missing ones are duplicates of the last one and not stored
+    Float4 dir_r, dir_c;
+    for (int lane = 0; lane < 4; lane++)
+    {
+      const float angle = heading + angles[std::min(i + lane, count - 1)];
+      dir_r[lane] = std::cos(angle);
+      dir_c[lane] = std::sin(angle);
+    }
+    Float4 t = {0.0f, 0.0f, 0.0f, 0.0f};
+    Int4 active = {-1, -1, -1, -1};
+    Float4 hit = {max_t, max_t, max_t, max_t};
+    while (active[0] | active[1] | active[2] | active[3])
+    {
+      const Float4 r = start_r + t * dir_r;
+      const Float4 c = start_c + t * dir_c;
+      // leaving the map counts as no hit
+      const Int4 inside = (r >= 0.0f) & (r < rows) & (c >= 0.0f) & (c < cols) & (t <= max_t);
+      active &= inside;
+      const Int4 ri = __builtin_convertvector(r, Int4);
+      const Int4 ci = __builtin_convertvector(c, Int4);
+      Float4 distance;
+      for (int lane = 0; lane < 4; lane++)
+      {
+        // inactive lanes may point outside the map
+        distance[lane] = active[lane] ? distances[size_t(ri[lane]) * cols_ + ci[lane]] : 1.0f;
+      }
+      const Int4 now_hit = active & (distance == 0.0f);
+      hit = now_hit ? t : hit;
+      active &= ~now_hit;
+      // the distance is rounded down and measured between cell corners, one cell less is safe
+      const Float4 step = distance - 1.0f;
+      t += step > kMinStep ? step : Float4{kMinStep, kMinStep, kMinStep, kMinStep};
+    }
+    const Float4 range = hit * cell_size_;
+    for (int lane = 0; lane < 4 && i + lane < end; lane++)
+    {
+      ranges[i + lane] = std::min(range[lane], max_range);
+    }
+  }
+}
+
+} // namespace ev3
+} // namespace isaac
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "packages/utils/ParallelFor.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// Casts lidar beams into an occupancy grid map.
+//
+// The map is turned into a distance transform once, holding for every cell the distance in cells
+// to the closest obstacle. Beams are then sphere traced: every step advances by the distance to the
+// closest obstacle, which crosses open space in a few steps. Four beams are traced together with
+// vector instructions and groups of beams can be spread over several threads.
+//
+// Coordinates follow the Isaac map convention: x runs along the rows and y along the columns of the
+// map image, both in meters from the corner of cell (0, 0).
+class MapRayCaster {
+ public:
+  MapRayCaster() = default;
+
+  // Sets the map. `occupied` has rows * cols cells in row-major order, non-zero cells are
+  // obstacles. `cell_size` is in meters.
+  void setMap(const uint8_t* occupied, int rows, int cols, float cell_size);
+  // Sets a precomputed distance transform, e.g. from a MapCache, instead of computing it. The
+  // distances are not copied and must outlive the caster or the next call to setMap.
+  void setDistances(const uint8_t* distances, int rows, int cols, float cell_size);
+
+  // Casts `count` beams from (x, y) with the given heading. Beam angles are relative to the heading
+  // and counter-clockwise. Ranges are in meters; beams which do not hit anything within
+  // `max_range` or leave the map get `max_range`. Uses up to `threads` threads, 0 for all cores.
+  void cast(float x, float y, float heading, const float* angles, size_t count, float max_range,
+            float* ranges, size_t threads = 1) const;
+  // Same as above on the threads of `pool`, for callers which cast a scan per tick and should not
+  // start threads every time
+  void cast(float x, float y, float heading, const float* angles, size_t count, float max_range,
+            float* ranges, WorkerPool& pool) const;
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+  float cellSize() const { return cell_size_; }
+  // Distance to the closest obstacle in cells, saturated at 255
+  const uint8_t* distances() const { return distances_; }
+
+ private:
+  // Casts the beams [begin, end), `begin` is a multiple of four
+  void castRange(float x, float y, float heading, const float* angles, size_t begin, size_t end,
+                 size_t count, float max_range, float* ranges) const;
+
+  int rows_ = 0;
+  int cols_ = 0;
+  float cell_size_ = 1.0f;
+  // either owned_distances_ or memory of the caller
+  const uint8_t* distances_ = nullptr;
+  std::vector<uint8_t> owned_distances_;
+};
+
+// Computes the Euclidean distance transform of an occupancy grid in cells, rounded down and
+// saturated at 255. Non-zero cells of `occupied` are obstacles with distance 0.
+void ComputeDistanceTransform(const uint8_t* occupied, int rows, int cols, std::vector<uint8_t>& distances);
+
+}  // namespace ev3
+}  // namespace isaac
@@ -0,0 +1,81 @@
+// Measures how many simulated scans per second MapRayCaster casts into a map, by default the map of
+// the EV3 apps, with one thread and with all cores.
+//
+//   ray_cast_benchmark [MAP_PNG [CELL_SIZE [BEAMS]]] [--benchmark_out=PATH]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MapRayCaster.hpp"
+#include "engine/gems/image/io.hpp"
+#include "packages/utils/Benchmark.hpp"
+
+using namespace isaac::ev3;
+
+int main(int argc, char **argv)
+{
+  const std::string json_path = ParseBenchmarkOut(argc, argv);
+  const std::string path = argc > 1 ? argv[1] : "apps/assets/maps/map.png";
+  const float cell_size = argc > 2 ? std::atof(argv[2]) : 0.005f;
+  const size_t beams = argc > 3 ? std::atoi(argv[3]) : 720;
+
+  isaac::Image1ub image;
+  if (!isaac::LoadPng(path, image))
+  {
+    std::fprintf(stderr, "Could not load map '%s'\n", path.c_str());
+    return 1;
+  }
+  std::vector<uint8_t> occupied(image.num_pixels());
+  for (int row = 0; row < image.rows(); row++)
+  {
+    for (int col = 0; col < image.cols(); col++)
+    {
+      // threshold 0.4 of map.config.json, dark pixels are obstacles
+      occupied[row * image.cols() + col] = image(row, col) < 153;
+    }
+  }
+  MapRayCaster caster;
+  std::vector<BenchmarkResult> results;
+  results.push_back(RunBenchmark("distance transform",
+                                 [&] { caster.setMap(occupied.data(), image.rows(), image.cols(), cell_size); },
+                                 0.0, 1.0));
+
+  // a free cell near the center of the map to cast from
+  const uint8_t *distances = caster.distances();
+  int start = (image.rows() / 2) * image.cols() + image.cols() / 2;
+  while (start < int(image.num_pixels()) - 1 && distances[start] < 10)
+  {
+    start++;
+  }
+  const float x = (start / image.cols() + 0.5f) * cell_size;
+  const float y = (start % image.cols() + 0.5f) * cell_size;
+
+  std::vector<float> angles(beams), ranges(beams);
+  for (size_t i = 0; i < beams; i++)
+  {
+    angles[i] = -M_PI + 2.0 * M_PI * i / beams;
+  }
+  const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t threads : {size_t(1), cores})
+  {
+    // threads are started once, like in LidarSimulator
+    WorkerPool pool(threads);
+    float heading = 0.0f;
+    results.push_back(RunBenchmark(std::to_string(beams) + " beams, " + std::to_string(threads) + " threads",
+                                   [&] {
+                                     // turn a little every scan so the beams hit different cells
+                                     heading += 0.01f;
+                                     caster.cast(x, y, heading, angles.data(), beams, 10.0f, ranges.data(),
+                                                 pool);
+                                     DoNotOptimize(ranges[0]);
+                                   },
+                                   1.0));
+  }
+  const bool written = ReportBenchmarks(results, argv[0], json_path);
+  std::printf("items/s of the scan benchmarks are scans per second\n");
+  return written ? 0 : 1;
+}
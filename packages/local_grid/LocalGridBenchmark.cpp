@@ -0,0 +1,173 @@
+// Measures how many scans per second ScrollingGrid integrates while the robot drives through a
+// simulated room, against a baseline which works like the local_map subgraph: the grid is shifted
+// by copying when the robot moves and every cell of the grid is compared with the scan.
+//
+//   local_grid_benchmark [DIMENSION [CELL_SIZE [BEAMS]]] [--benchmark_out=PATH]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "ScrollingGrid.hpp"
+#include "packages/lidar_simulator/MapRayCaster.hpp"
+#include "packages/utils/Benchmark.hpp"
+
+using namespace isaac::ev3;
+
+namespace
+{
+
+// A room of 8 x 8 m with a few boxes, in cells of 2.5 cm
+constexpr int kRoomCells = 320;
+constexpr float kRoomCellSize = 0.025f;
+constexpr float kMaxRange = 6.0f;
+// Scans along the path of the robot
+constexpr int kScans = 200;
+
+struct Scan
+{
+  float x, y, heading;
+  std::vector<float> ranges;
+};
+
+std::vector<Scan> simulateScans(const std::vector<float> &angles)
+{
+  std::vector<uint8_t> room(kRoomCells * kRoomCells, 0);
+  auto box = [&](int r0, int c0, int r1, int c1) {
+    for (int r = r0; r < r1; r++)
+      for (int c = c0; c < c1; c++)
+        room[r * kRoomCells + c] = 1;
+  };
+  box(0, 0, 4, kRoomCells);
+  box(kRoomCells - 4, 0, kRoomCells, kRoomCells);
+  box(0, 0, kRoomCells, 4);
+  box(0, kRoomCells - 4, kRoomCells, kRoomCells);
+  box(100, 60, 140, 90);
+  box(200, 220, 230, 280);
+  box(60, 200, 70, 300);
+  MapRayCaster caster;
+  caster.setMap(room.data(), kRoomCells, kRoomCells, kRoomCellSize);
+
+  // a loop through the room at about 10 cm per scan
+  std::vector<Scan> scans(kScans);
+  for (int i = 0; i < kScans; i++)
+  {
+    const float t = 2.0f * M_PI * i / kScans;
+    Scan &scan = scans[i];
+    scan.x = 4.0f + 2.5f * std::cos(t);
+    scan.y = 4.0f + 2.5f * std::sin(t);
+    scan.heading = t + M_PI / 2;
+    scan.ranges.resize(angles.size());
+    caster.cast(scan.x, scan.y, scan.heading, angles.data(), angles.size(), kMaxRange, scan.ranges.data());
+  }
+  return scans;
+}
+
+// Reprocesses the whole grid for every scan like the local_map subgraph
+class FullGrid
+{
+public:
+  FullGrid(int size, float cell_size) : size_(size), cell_size_(cell_size), cells_(size * size, 0), shifted_(cells_)
+  {
+  }
+
+  void integrate(const Scan &scan, const std::vector<float> &angles)
+  {
+    const int row = int(std::floor(scan.x / cell_size_)) - size_ / 2;
+    const int col = int(std::floor(scan.y / cell_size_)) - size_ / 2;
+    // shift the grid by copying it into its new window
+    const int dr = row - origin_row_;
+    const int dc = col - origin_col_;
+    std::fill(shifted_.begin(), shifted_.end(), 0);
+    for (int r = std::max(0, -dr); r < std::min(size_, size_ - dr); r++)
+    {
+      const int c_begin = std::max(0, -dc);
+      const int c_end = std::min(size_, size_ - dc);
+      if (c_begin < c_end)
+      {
+        std::memcpy(&shifted_[r * size_ + c_begin], &cells_[(r + dr) * size_ + c_begin + dc], c_end - c_begin);
+      }
+    }
+    cells_.swap(shifted_);
+    origin_row_ = row;
+    origin_col_ = col;
+
+    // compare every cell with the beam pointing at it
+    const float angle_step = angles[1] - angles[0];
+    const int beams = int(angles.size());
+    for (int r = 0; r < size_; r++)
+    {
+      for (int c = 0; c < size_; c++)
+      {
+        const float x = (origin_row_ + r + 0.5f) * cell_size_ - scan.x;
+        const float y = (origin_col_ + c + 0.5f) * cell_size_ - scan.y;
+        const float range = std::sqrt(x * x + y * y);
+        float bearing = std::atan2(y, x) - scan.heading - angles[0];
+        bearing -= 2.0f * M_PI * std::floor(bearing / (2.0f * M_PI));
+        const int beam = std::min(beams - 1, int(bearing / angle_step + 0.5f) % beams);
+        const float measured = scan.ranges[beam];
+        int8_t &cell = cells_[r * size_ + c];
+        if (range < measured - cell_size_)
+        {
+          cell = int8_t(std::max(-100, cell - 4));
+        }
+        else if (range < measured + cell_size_ && measured < kMaxRange)
+        {
+          cell = int8_t(std::min(100, cell + 8));
+        }
+      }
+    }
+  }
+
+private:
+  int size_;
+  float cell_size_;
+  int origin_row_ = 0;
+  int origin_col_ = 0;
+  std::vector<int8_t> cells_;
+  std::vector<int8_t> shifted_;
+};
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const std::string json_path = ParseBenchmarkOut(argc, argv);
+  const int dimension = argc > 1 ? std::atoi(argv[1]) : 256;
+  const float cell_size = argc > 2 ? std::atof(argv[2]) : 0.025f;
+  const size_t beam_count = argc > 3 ? std::atoi(argv[3]) : 720;
+
+  std::vector<float> angles(beam_count);
+  for (size_t i = 0; i < beam_count; i++)
+  {
+    angles[i] = -M_PI + 2.0 * M_PI * i / beam_count;
+  }
+  const std::vector<Scan> scans = simulateScans(angles);
+
+  ScrollingGrid grid(dimension, cell_size);
+  FullGrid full(grid.size(), cell_size);
+  std::vector<uint8_t> pixels(size_t(grid.size()) * grid.size());
+  size_t next = 0;
+  size_t updated = 0;
+  std::vector<BenchmarkResult> results;
+  results.push_back(RunBenchmark("scrolling grid scan",
+                                 [&] {
+                                   const Scan &scan = scans[next++ % scans.size()];
+                                   grid.recenter(scan.x, scan.y);
+                                   grid.integrate(scan.x, scan.y, scan.heading, scan.ranges.data(), angles.data(),
+                                                  angles.size(), 0.12f, kMaxRange);
+                                   updated += grid.updatedCells();
+                                 },
+                                 1.0));
+  const double cells_per_scan = double(updated) / next;
+  results.push_back(RunBenchmark("scrolling grid render", [&] { grid.render(pixels.data(), grid.size()); }, 1.0));
+  next = 0;
+  results.push_back(RunBenchmark("full grid scan",
+                                 [&] { full.integrate(scans[next++ % scans.size()], angles); }, 1.0));
+  const bool written = ReportBenchmarks(results, argv[0], json_path);
+  std::printf("%dx%d cells of %.3f m, %zu beams, %.0f cell updates per scan of %d cells\n", grid.size(),
+              grid.size(), cell_size, beam_count, cells_per_scan, grid.size() * grid.size());
+  return written ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+#include "ScrollingGrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+
+// Log odds added by a hit and a miss, roughly p = 0.7 and p = 0.4 in units of 0.1
+constexpr int kHit = 8;
+constexpr int kMiss = -4;
+constexpr int kMaxLogOdds = 100;
+
+int8_t clampLogOdds(int value)
+{
+  return static_cast<int8_t>(std::max(-kMaxLogOdds, std::min(kMaxLogOdds, value)));
+}
+
+// Pixel values of all log odds, the probability of the cell to be free
+struct FreeProbabilityTable
+{
+  uint8_t pixel[256];
+  FreeProbabilityTable()
+  {
+    for (int i = 0; i < 256; i++)
+    {
+      const float occupied = 1.0f / (1.0f + std::exp(-0.1f * (i - 128)));
+      pixel[i] = static_cast<uint8_t>(std::lround(255.0f * (1.0f - occupied)));
+    }
+  }
+};
+
+int floorToCell(float value, float inverse_cell_size)
+{
+  return static_cast<int>(std::floor(value * inverse_cell_size));
+}
+
+} // namespace
+
+ScrollingGrid::ScrollingGrid(int size, float cell_size) : cell_size_(cell_size)
+{
+  size_ = kTileSize;
+  while (size_ < size)
+  {
+    size_ *= 2;
+  }
+  mask_ = size_ - 1;
+  tiles_per_side_ = size_ >> kTileBits;
+  cells_.assign(size_t(size_) * size_, 0);
+}
+
+void ScrollingGrid::recenter(float x, float y)
+{
+  const float inverse_cell_size = 1.0f / cell_size_;
+  const int row = floorToCell(x, inverse_cell_size) - size_ / 2;
+  const int col = floorToCell(y, inverse_cell_size) - size_ / 2;
+  if (std::abs(row - origin_row_) >= size_ || std::abs(col - origin_col_) >= size_)
+  {
+    std::fill(cells_.begin(), cells_.end(), 0);
+    origin_row_ = row;
+    origin_col_ = col;
+    return;
+  }
+  // the cells which leave on one side are the ones which enter on the other
+  if (row > origin_row_)
+  {
+    clearRows(origin_row_ + size_, row + size_);
+  }
+  else if (row < origin_row_)
+  {
+    clearRows(row, origin_row_);
+  }
+  origin_row_ = row;
+  if (col > origin_col_)
+  {
+    clearCols(origin_col_ + size_, col + size_);
+  }
+  else if (col < origin_col_)
+  {
+    clearCols(col, origin_col_);
+  }
+  origin_col_ = col;
+}
+
+void ScrollingGrid::clearRows(int begin, int end)
+{
+  for (int row = begin; row < end; row++)
+  {
+    for (int tile = 0; tile < tiles_per_side_; tile++)
+    {
+      std::memset(&cells_[index(row, tile << kTileBits)], 0, kTileSize);
+    }
+  }
+}
+
+void ScrollingGrid::clearCols(int begin, int end)
+{
+  for (int row = 0; row < size_; row++)
+  {
+    for (int col = begin; col < end; col++)
+    {
+      cells_[index(row, col)] = 0;
+    }
+  }
+}
+
+void ScrollingGrid::integrate(float x, float y, float heading, const float *ranges, const float *angles,
+                              size_t count, float min_range, float max_range)
+{
+  const float inverse_cell_size = 1.0f / cell_size_;
+  const int r0 = floorToCell(x, inverse_cell_size);
+  const int c0 = floorToCell(y, inverse_cell_size);
+  updated_cells_ = 0;
+  if (!inside(r0, c0))
+  {
+    return;
+  }
+  for (size_t i = 0; i < count; i++)
+  {
+    const float range = ranges[i];
+    if (!(range >= min_range))
+    {
+      continue;
+    }
+    const bool hit = range < max_range;
+    const float length = hit ? range : max_range;
+    const float angle = heading + angles[i];
+    const int r1 = floorToCell(x + length * std::cos(angle), inverse_cell_size);
+    const int c1 = floorToCell(y + length * std::sin(angle), inverse_cell_size);
+    trace(r0, c0, r1, c1, hit);
+  }
+}
+
+void ScrollingGrid::trace(int r0, int c0, int r1, int c1, bool hit)
+{
+  // Bresenham, stops at the border of the window
+  const int dr = std::abs(r1 - r0);
+  const int dc = std::abs(c1 - c0);
+  const int step_r = r0 < r1 ? 1 : -1;
+  const int step_c = c0 < c1 ? 1 : -1;
+  int error = dr - dc;
+  int r = r0;
+  int c = c0;
+  while (r != r1 || c != c1)
+  {
+    int8_t &cell = cells_[index(r, c)];
+    cell = clampLogOdds(cell + kMiss);
+    updated_cells_++;
+    const int twice = 2 * error;
+    if (twice > -dc)
+    {
+      error -= dc;
+      r += step_r;
+    }
+    if (twice < dr)
+    {
+      error += dr;
+      c += step_c;
+    }
+    if (!inside(r, c))
+    {
+      return;
+    }
+  }
+  if (hit)
+  {
+    int8_t &cell = cells_[index(r, c)];
+    cell = clampLogOdds(cell + kHit);
+    updated_cells_++;
+  }
+}
+
+int8_t ScrollingGrid::at(int row, int col) const
+{
+  return inside(row, col) ? cells_[index(row, col)] : 0;
+}
+
+void ScrollingGrid::render(uint8_t *pixels, size_t stride) const
+{
+  static const FreeProbabilityTable table;
+  for (int i = 0; i < size_; i++)
+  {
+    uint8_t *out = pixels + i * stride;
+    const int row = origin_row_ + i;
+    // runs of cells which are contiguous in their tile
+    for (int j = 0; j < size_;)
+    {
+      const int col = origin_col_ + j;
+      const int run = std::min(kTileSize - (col & (kTileSize - 1)), size_ - j);
+      const int8_t *cells = &cells_[index(row, col)];
+      for (int k = 0; k < run; k++)
+      {
+        out[j + k] = table.pixel[uint8_t(cells[k] + 128)];
+      }
+      j += run;
+    }
+  }
+}
+
+} // namespace ev3
+} // namespace isaac
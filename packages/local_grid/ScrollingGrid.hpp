@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace isaac {
+namespace ev3 {
+
+// A square occupancy grid which follows the robot.
+//
+// The grid is a window of size x size cells of the world, stored as a ring buffer: world cell
+// (r, c) lives at (r mod size, c mod size). When the robot moves the window scrolls by changing its
+// origin and only the rows and columns which enter the window are cleared, nothing is copied.
+//
+// Cells hold the log odds of being occupied. A scan only updates the cells its beams cross, which
+// are traced with integer steps. The ring is stored in tiles of 16 x 16 cells, 4 cache lines each,
+// thus a beam touches a few tiles instead of a new cache line for every row it crosses.
+//
+// Coordinates follow the Isaac map convention: x runs along the rows and y along the columns, both
+// in meters of the frame the poses are given in, e.g. odom.
+class ScrollingGrid {
+ public:
+  static constexpr int kTileBits = 4;
+  static constexpr int kTileSize = 1 << kTileBits;
+
+  // `size` is rounded up to a power of two and at least one tile
+  ScrollingGrid(int size, float cell_size);
+
+  // Moves the window such that (x, y) is in its center
+  void recenter(float x, float y);
+
+  // Integrates a scan taken at (x, y) with the given heading. Beam angles are relative to the
+  // heading and counter-clockwise. Beams shorter than `min_range` are ignored, beams at or beyond
+  // `max_range` only clear the cells up to `max_range`.
+  void integrate(float x, float y, float heading, const float* ranges, const float* angles,
+                 size_t count, float min_range, float max_range);
+
+  // Writes the window with its first row at origin_row() to `pixels` with `stride` bytes per row.
+  // Like map images the pixel value is the probability of the cell to be free, unknown cells are
+  // 128.
+  void render(uint8_t* pixels, size_t stride) const;
+
+  // Log odds of a world cell, 0 if it is outside of the window
+  int8_t at(int row, int col) const;
+
+  int size() const { return size_; }
+  float cellSize() const { return cell_size_; }
+  // World cell of the first row and column of the window
+  int originRow() const { return origin_row_; }
+  int originCol() const { return origin_col_; }
+  // Cells updated by the last scan
+  size_t updatedCells() const { return updated_cells_; }
+
+ private:
+  // Index of a world cell in the ring buffer
+  size_t index(int row, int col) const {
+    const int r = row & mask_;
+    const int c = col & mask_;
+    return ((size_t((r >> kTileBits) * tiles_per_side_ + (c >> kTileBits))) << (2 * kTileBits)) +
+           ((r & (kTileSize - 1)) << kTileBits) + (c & (kTileSize - 1));
+  }
+  bool inside(int row, int col) const {
+    return unsigned(row - origin_row_) < unsigned(size_) &&
+           unsigned(col - origin_col_) < unsigned(size_);
+  }
+  // Clears the world rows [begin, end) or columns [begin, end) of the window
+  void clearRows(int begin, int end);
+  void clearCols(int begin, int end);
+  // Traces one beam from cell (r0, c0) to (r1, c1), the end cell is a hit if `hit` is set
+  void trace(int r0, int c0, int r1, int c1, bool hit);
+
+  int size_;
+  int mask_;
+  int tiles_per_side_;
+  float cell_size_;
+  int origin_row_ = 0;
+  int origin_col_ = 0;
+  size_t updated_cells_ = 0;
+  std::vector<int8_t> cells_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
@@ -0,0 +1,76 @@
+#include "ScrollingLocalMap.hpp"
+
+#include <algorithm>
+
+#include "engine/core/image/image.hpp"
+#include "engine/core/time.hpp"
+#include "messages/image.hpp"
+
+namespace isaac
+{
+namespace ev3
+{
+
+void ScrollingLocalMap::start()
+{
+  grid_.reset(new ScrollingGrid(get_dimension(), static_cast<float>(get_cell_size())));
+  tickOnMessage(rx_flatscan());
+}
+
+void ScrollingLocalMap::stop()
+{
+  tick_latency_.dump(full_name());
+}
+
+void ScrollingLocalMap::tick()
+{
+  const auto timer = tick_latency_.measure();
+  tick_latency_.report(getTickTime(), [this](const char* tag, double value) { show(tag, value); });
+
+  const int64_t acqtime = rx_flatscan().acqtime();
+  bool ok;
+  const Pose2d odom_T_robot = get_odom_T_robot(ToSeconds(acqtime), ok);
+  if (!ok)
+  {
+    return;
+  }
+  const float x = odom_T_robot.translation.x();
+  const float y = odom_T_robot.translation.y();
+  grid_->recenter(x, y);
+
+  auto scan = rx_flatscan().getProto();
+  auto ranges = scan.getRanges();
+  auto angles = scan.getAngles();
+  const size_t count = std::min(ranges.size(), angles.size());
+  ranges_.resize(count);
+  angles_.resize(count);
+  for (size_t i = 0; i < count; i++)
+  {
+    ranges_[i] = ranges[i];
+    angles_[i] = angles[i];
+  }
+  grid_->integrate(x, y, odom_T_robot.rotation.angle(), ranges_.data(), angles_.data(), count,
+                   scan.getInvalidRangeThreshold(), scan.getOutOfRangeThreshold());
+  show("updated_cells", static_cast<double>(grid_->updatedCells()));
+
+  if (scans_++ % std::max(1, get_publish_every()) != 0)
+  {
+    return;
+  }
+  const int size = grid_->size();
+  const double cell_size = grid_->cellSize();
+  Image1ub image(size, size);
+  grid_->render(image.element_wise_begin(), size);
+  auto proto = tx_local_map().initProto();
+  ToProto(std::move(image), proto.initGrid(), tx_local_map().buffers());
+  proto.setCellSize(cell_size);
+  proto.setMapFrame("local_map");
+  // the window is axis-aligned in odom, its first cell is at the origin of the map frame
+  set_odom_T_local_map(Pose2d::FromXYA(grid_->originRow() * cell_size,
+                                       grid_->originCol() * cell_size, 0.0),
+                       ToSeconds(acqtime));
+  tx_local_map().publish(acqtime);
+}
+
+} // namespace ev3
+} // namespace isaac
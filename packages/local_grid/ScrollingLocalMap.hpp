@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "ScrollingGrid.hpp"
+
+#include "engine/alice/alice.hpp"
+#include "messages/messages.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// Builds the local obstacle map around the robot from flatscans, in place of the local_map
+// subgraph which re-renders its whole grid for every scan. The grid is a ScrollingGrid in the odom
+// frame which scrolls with the robot and only updates the cells crossed by the beams of a scan.
+//
+// The map is published like isaac.navigation.LocalMap publishes local_map: an OccupancyMapProto
+// whose pixels are the probability of a cell to be free, in the frame local_map which is written
+// to the pose tree as odom_T_local_map. Like that map it becomes an obstacle of the planner through
+// OccupancyToBinaryMap and BinaryToDistanceMap, see the scrolling_local_map node of the ev3 app.
+class ScrollingLocalMap : public isaac::alice::Codelet {
+ public:
+  void start() override;
+  void stop() override;
+  void tick() override;
+
+  // Scans in the robot frame, e.g. from LidarAngleChanger
+  ISAAC_PROTO_RX(FlatscanProto, flatscan);
+  // Local obstacle map around the robot
+  ISAAC_PROTO_TX(OccupancyMapProto, local_map);
+
+  // Number of cells along each side of the map, rounded up to a power of two
+  ISAAC_PARAM(int, dimension, 256);
+  // Size of a cell in meters
+  ISAAC_PARAM(double, cell_size, 0.025);
+  // The map is published for every n-th scan, cells are updated for every scan
+  ISAAC_PARAM(int, publish_every, 1);
+  ISAAC_POSE2(odom, robot);
+  ISAAC_POSE2(odom, local_map);
+
+ private:
+  std::unique_ptr<ScrollingGrid> grid_;
+  std::vector<float> ranges_;
+  std::vector<float> angles_;
+  uint64_t scans_ = 0;
+  TickLatency tick_latency_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
+
+ISAAC_ALICE_REGISTER_CODELET(isaac::ev3::ScrollingLocalMap);
@@ -0,0 +1,97 @@
+#include "MapAsset.hpp"
+
+#include <sys/stat.h>
+
+#include "engine/core/logger.hpp"
+#include "engine/gems/image/io.hpp"
+#include "engine/gems/serialization/json.hpp"
+#include "packages/lidar_simulator/MapRayCaster.hpp"
+
+namespace isaac
+{
+namespace ev3
+{
+
+bool LoadOccupancyConfig(const std::string &config_path, OccupancyConfig &config)
+{
+  const auto json = serialization::TryLoadJsonFromFile(config_path);
+  if (!json)
+  {
+    LOG_ERROR("Could not load map config '%s'", config_path.c_str());
+    return false;
+  }
+  // same layout as the occupancy component of isaac::map::Map
+  for (const auto &node : json->items())
+  {
+    const auto it = node.value().find("occupancy");
+    if (it != node.value().end())
+    {
+      config.filename = it->value("filename", "");
+      config.cell_size = it->value("cell_size", 0.05f);
+      config.threshold = it->value("threshold", 0.4f);
+      return true;
+    }
+  }
+  LOG_ERROR("Map config '%s' has no occupancy grid", config_path.c_str());
+  return false;
+}
+
+bool LoadOccupancy(const OccupancyConfig &config, std::vector<uint8_t> &occupancy, int &rows, int &cols)
+{
+  Image1ub image;
+  if (!LoadPng(config.filename, image))
+  {
+    LOG_ERROR("Could not load map image '%s'", config.filename.c_str());
+    return false;
+  }
+  rows = image.rows();
+  cols = image.cols();
+  BuildOccupancy(image.element_wise_begin(), rows, cols, cols, config.threshold, occupancy);
+  return true;
+}
+
+bool BuildMapCache(const OccupancyConfig &config, const std::string &directory)
+{
+  MapSource source;
+  if (!MapSource::Stat(config.filename, config.cell_size, config.threshold, source))
+  {
+    LOG_ERROR("Map image '%s' does not exist", config.filename.c_str());
+    return false;
+  }
+  std::vector<uint8_t> occupancy, distances;
+  int rows, cols;
+  if (!LoadOccupancy(config, occupancy, rows, cols))
+  {
+    return false;
+  }
+  ComputeDistanceTransform(occupancy.data(), rows, cols, distances);
+  mkdir(directory.c_str(), 0755);
+  const std::string path = MapCachePath(directory, config.filename);
+  if (!MapCache::Write(path, source, rows, cols, distances.data()))
+  {
+    LOG_ERROR("Could not write map cache '%s'", path.c_str());
+    return false;
+  }
+  LOG_INFO("Wrote map cache '%s' with %dx%d cells", path.c_str(), rows, cols);
+  return true;
+}
+
+bool OpenMapCache(const OccupancyConfig &config, const std::string &directory, MapCache &cache)
+{
+  MapSource source;
+  if (!MapSource::Stat(config.filename, config.cell_size, config.threshold, source))
+  {
+    LOG_ERROR("Map image '%s' does not exist", config.filename.c_str());
+    return false;
+  }
+  const std::string path = MapCachePath(directory, config.filename);
+  if (cache.open(path) && cache.matches(source))
+  {
+    return true;
+  }
+  cache.close();
+  return BuildMapCache(config, directory) && cache.open(path) && cache.matches(source);
+}
+
+} // namespace ev3
+} // namespace isaac
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "MapCache.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// The occupancy grid of a map config as written by the Isaac map editor
+struct OccupancyConfig {
+  std::string filename;
+  float cell_size = 0.05f;
+  float threshold = 0.4f;
+};
+
+// Reads the occupancy component of a map config, false if it has none
+bool LoadOccupancyConfig(const std::string& config_path, OccupancyConfig& config);
+
+// Decodes the map image and marks its obstacles, see BuildOccupancy
+bool LoadOccupancy(const OccupancyConfig& config, std::vector<uint8_t>& occupancy, int& rows,
+                   int& cols);
+
+// Builds the cache of an occupancy grid in `directory`, creating the directory if needed
+bool BuildMapCache(const OccupancyConfig& config, const std::string& directory);
+
+// Maps the cache of an occupancy grid from `directory`. Missing or stale caches, e.g. after the map
+// image was edited, are built first, thus only the first start after a change pays for the
+// distance transform.
+bool OpenMapCache(const OccupancyConfig& config, const std::string& directory, MapCache& cache);
+
+}  // namespace ev3
+}  // namespace isaac
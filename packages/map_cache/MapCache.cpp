@@ -0,0 +1,233 @@
+#include "MapCache.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+
+constexpr char kMagic[8] = {'E', 'V', '3', 'M', 'A', 'P', '\0', '\0'};
+// The distances start at a multiple of this, a page, so they can be mapped on their own if needed
+constexpr size_t kAlignment = 4096;
+
+struct Header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  int32_t rows;
+  int32_t cols;
+  uint64_t source_size;
+  int64_t source_mtime_ns;
+  float cell_size;
+  float threshold;
+  uint64_t distances_offset;
+  uint64_t file_size;
+};
+
+size_t aligned(size_t size)
+{
+  return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+const Header &header(const uint8_t *base)
+{
+  return *reinterpret_cast<const Header *>(base);
+}
+
+bool writeAll(int fd, const void *data, size_t size)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  while (size > 0)
+  {
+    const ssize_t written = ::write(fd, bytes, size);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
+} // namespace
+
+bool MapSource::Stat(const std::string &image_path, float cell_size, float threshold, MapSource &source)
+{
+  struct stat info;
+  if (stat(image_path.c_str(), &info) != 0)
+  {
+    return false;
+  }
+  source.size = info.st_size;
+  source.mtime_ns = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+  source.cell_size = cell_size;
+  source.threshold = threshold;
+  return true;
+}
+
+bool MapSource::operator==(const MapSource &other) const
+{
+  return size == other.size && mtime_ns == other.mtime_ns && cell_size == other.cell_size &&
+         threshold == other.threshold;
+}
+
+bool MapCache::open(const std::string &path)
+{
+  close();
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(Header))
+  {
+    ::close(fd);
+    return false;
+  }
+  void *base = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED)
+  {
+    return false;
+  }
+  base_ = static_cast<uint8_t *>(base);
+  size_ = info.st_size;
+  const Header &h = header(base_);
+  const size_t cells = size_t(h.rows) * h.cols;
+  const bool valid = std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 && h.version == kVersion &&
+                     h.header_size == sizeof(Header) && h.rows > 0 && h.cols > 0 && h.file_size == size_ &&
+                     h.distances_offset + cells <= size_;
+  if (!valid)
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void MapCache::close()
+{
+  if (base_ != nullptr)
+  {
+    munmap(base_, size_);
+    base_ = nullptr;
+    size_ = 0;
+  }
+}
+
+bool MapCache::matches(const MapSource &source) const
+{
+  if (!isOpen())
+  {
+    return false;
+  }
+  const Header &h = header(base_);
+  MapSource cached;
+  cached.size = h.source_size;
+  cached.mtime_ns = h.source_mtime_ns;
+  cached.cell_size = h.cell_size;
+  cached.threshold = h.threshold;
+  return cached == source;
+}
+
+int MapCache::rows() const
+{
+  return header(base_).rows;
+}
+
+int MapCache::cols() const
+{
+  return header(base_).cols;
+}
+
+float MapCache::cellSize() const
+{
+  return header(base_).cell_size;
+}
+
+const uint8_t *MapCache::distances() const
+{
+  return base_ + header(base_).distances_offset;
+}
+
+bool MapCache::Write(const std::string &path, const MapSource &source, int rows, int cols,
+                     const uint8_t *distances)
+{
+  const size_t cells = size_t(rows) * cols;
+  Header h;
+  std::memset(&h, 0, sizeof(h));
+  std::memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.version = kVersion;
+  h.header_size = sizeof(Header);
+  h.rows = rows;
+  h.cols = cols;
+  h.source_size = source.size;
+  h.source_mtime_ns = source.mtime_ns;
+  h.cell_size = source.cell_size;
+  h.threshold = source.threshold;
+  h.distances_offset = aligned(sizeof(Header));
+  h.file_size = h.distances_offset + cells;
+
+  const std::string temporary = path + ".tmp";
+  const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+  {
+    return false;
+  }
+  const std::vector<uint8_t> padding(kAlignment, 0);
+  const bool ok = writeAll(fd, &h, sizeof(h)) && writeAll(fd, padding.data(), h.distances_offset - sizeof(h)) &&
+                  writeAll(fd, distances, cells);
+  if (::close(fd) != 0 || !ok || std::rename(temporary.c_str(), path.c_str()) != 0)
+  {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+void BuildOccupancy(const uint8_t *pixels, int rows, int cols, size_t stride, float threshold,
+                    std::vector<uint8_t> &occupancy)
+{
+  const int free_min = static_cast<int>((1.0f - threshold) * 255.0f);
+  occupancy.resize(size_t(rows) * cols);
+  for (int row = 0; row < rows; row++)
+  {
+    const uint8_t *line = pixels + row * stride;
+    uint8_t *out = occupancy.data() + size_t(row) * cols;
+    for (int col = 0; col < cols; col++)
+    {
+      out[col] = line[col] < free_min;
+    }
+  }
+}
+
+std::string MapCachePath(const std::string &directory, const std::string &image_path)
+{
+  // keep the directories of the image in the name, maps of different apps share file names
+  std::string name = image_path;
+  for (char &c : name)
+  {
+    if (c == '/')
+      c = '.';
+  }
+  return directory + "/" + name + ".cache";
+}
+
+} // namespace ev3
+} // namespace isaac
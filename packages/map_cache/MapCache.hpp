@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace isaac {
+namespace ev3 {
+
+// Identifies the map image a cache was built from without reading it
+struct MapSource {
+  uint64_t size = 0;
+  int64_t mtime_ns = 0;
+  float cell_size = 0.0f;
+  float threshold = 0.0f;
+
+  // Reads size and modification time of the image, false if it does not exist
+  static bool Stat(const std::string& image_path, float cell_size, float threshold, MapSource& source);
+  bool operator==(const MapSource& other) const;
+};
+
+// The distance transform of an occupancy grid, as used by MapRayCaster, in a versioned binary file
+// which is memory-mapped instead of decoding the map image and rebuilding the transform on every
+// start of LidarSimulator.
+//
+// The file is a header followed by the distance to the closest obstacle in cells, saturated at 255,
+// one byte per cell in row-major order. The header holds the MapSource the distances were built from
+// so that stale caches are detected.
+class MapCache {
+ public:
+  static constexpr uint32_t kVersion = 2;
+
+  MapCache() = default;
+  MapCache(const MapCache&) = delete;
+  MapCache& operator=(const MapCache&) = delete;
+  ~MapCache() { close(); }
+
+  // Maps a cache file, false if it is missing, truncated or of another version
+  bool open(const std::string& path);
+  void close();
+  bool isOpen() const { return base_ != nullptr; }
+
+  // True if the cache was built from `source`
+  bool matches(const MapSource& source) const;
+
+  int rows() const;
+  int cols() const;
+  float cellSize() const;
+  const uint8_t* distances() const;
+
+  // Writes a cache, false on failure. The file is written next to `path` and renamed into place,
+  // thus readers never see a partial cache.
+  static bool Write(const std::string& path, const MapSource& source, int rows, int cols,
+                    const uint8_t* distances);
+
+ private:
+  uint8_t* base_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Marks cells of a grayscale map image as obstacles. Dark pixels are obstacles: the pixel value is
+// the probability of the cell to be free and cells which are occupied with more than `threshold`
+// are obstacles, like the occupancy grids of the Isaac map.
+void BuildOccupancy(const uint8_t* pixels, int rows, int cols, size_t stride, float threshold,
+                    std::vector<uint8_t>& occupancy);
+
+// Path of the cache of a map image in `directory`
+std::string MapCachePath(const std::string& directory, const std::string& image_path);
+
+}  // namespace ev3
+}  // namespace isaac
@@ -0,0 +1,229 @@
+#include "LinkFraming.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+
+bool ReadAll(int fd, void *data, size_t size)
+{
+  uint8_t *bytes = static_cast<uint8_t *>(data);
+  while (size > 0)
+  {
+    const ssize_t count = read(fd, bytes, size);
+    if (count < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (count <= 0)
+    {
+      return false;
+    }
+    bytes += count;
+    size -= count;
+  }
+  return true;
+}
+
+void SetNoDelay(int fd)
+{
+  const int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+} // namespace
+
+float *PrepareScan(uint32_t count, float invalid_range_threshold, float out_of_range_threshold,
+                   LinkMessage &message)
+{
+  message.channel = LinkChannel::kFlatscan;
+  message.payload.resize(3 * sizeof(uint32_t) + 2 * count * sizeof(float));
+  uint8_t *data = message.payload.data();
+  std::memcpy(data, &invalid_range_threshold, sizeof(float));
+  std::memcpy(data + 4, &out_of_range_threshold, sizeof(float));
+  std::memcpy(data + 8, &count, sizeof(count));
+  return reinterpret_cast<float *>(data + 12);
+}
+
+void EncodeScan(const float *ranges, const float *angles, uint32_t count, float invalid_range_threshold,
+                float out_of_range_threshold, LinkMessage &message)
+{
+  float *values = PrepareScan(count, invalid_range_threshold, out_of_range_threshold, message);
+  std::memcpy(values, ranges, count * sizeof(float));
+  std::memcpy(values + count, angles, count * sizeof(float));
+}
+
+void EncodeOdometry(const LinkOdometry &odometry, LinkMessage &message)
+{
+  message.channel = LinkChannel::kOdometry;
+  message.payload.resize(sizeof(odometry));
+  std::memcpy(message.payload.data(), &odometry, sizeof(odometry));
+}
+
+bool DecodeScan(const uint8_t *payload, size_t length, LinkScan &scan)
+{
+  uint32_t count = 0;
+  if (length < 3 * sizeof(uint32_t))
+  {
+    return false;
+  }
+  std::memcpy(&scan.invalid_range_threshold, payload, sizeof(float));
+  std::memcpy(&scan.out_of_range_threshold, payload + 4, sizeof(float));
+  std::memcpy(&count, payload + 8, sizeof(count));
+  if (length != 3 * sizeof(uint32_t) + 2 * size_t(count) * sizeof(float))
+  {
+    return false;
+  }
+  scan.ranges.resize(count);
+  scan.angles.resize(count);
+  std::memcpy(scan.ranges.data(), payload + 12, count * sizeof(float));
+  std::memcpy(scan.angles.data(), payload + 12 + count * sizeof(float), count * sizeof(float));
+  return true;
+}
+
+bool DecodeOdometry(const uint8_t *payload, size_t length, LinkOdometry &odometry)
+{
+  if (length != sizeof(odometry))
+  {
+    return false;
+  }
+  std::memcpy(&odometry, payload, sizeof(odometry));
+  return true;
+}
+
+size_t WriteFrame(int fd, const LinkMessage &message)
+{
+  const LinkFrameHeader header{kLinkFrameMagic, static_cast<uint8_t>(message.channel), 0,
+                               static_cast<uint32_t>(message.payload.size()), message.acqtime};
+  iovec parts[2] = {{const_cast<LinkFrameHeader *>(&header), sizeof(header)},
+                    {const_cast<uint8_t *>(message.payload.data()), message.payload.size()}};
+  msghdr frame{};
+  const size_t total = sizeof(header) + message.payload.size();
+  size_t written = 0;
+  int index = 0;
+  while (written < total)
+  {
+    frame.msg_iov = parts + index;
+    frame.msg_iovlen = 2 - index;
+    // a closed connection fails the write instead of raising SIGPIPE
+    const ssize_t count = sendmsg(fd, &frame, MSG_NOSIGNAL);
+    if (count < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (count <= 0)
+    {
+      return 0;
+    }
+    written += count;
+    // skip what was written, a partial write is continued where it stopped
+    size_t left = count;
+    while (index < 2 && left >= parts[index].iov_len)
+    {
+      left -= parts[index].iov_len;
+      index++;
+    }
+    if (index < 2)
+    {
+      parts[index].iov_base = static_cast<uint8_t *>(parts[index].iov_base) + left;
+      parts[index].iov_len -= left;
+    }
+  }
+  return total;
+}
+
+bool ReadFrame(int fd, LinkMessage &message)
+{
+  LinkFrameHeader header;
+  if (!ReadAll(fd, &header, sizeof(header)) || header.magic != kLinkFrameMagic ||
+      header.channel > static_cast<uint8_t>(LinkChannel::kFlatscan) || header.length > kLinkMaxPayload)
+  {
+    return false;
+  }
+  message.channel = static_cast<LinkChannel>(header.channel);
+  message.acqtime = header.acqtime;
+  message.payload.resize(header.length);
+  return ReadAll(fd, message.payload.data(), header.length);
+}
+
+int ListenTcp(int port)
+{
+  const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  const int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(fd, 1) < 0)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int ConnectTcp(const std::string &host, int port)
+{
+  addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *result = nullptr;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0)
+  {
+    return -1;
+  }
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd >= 0 && connect(fd, result->ai_addr, result->ai_addrlen) < 0)
+  {
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(result);
+  if (fd >= 0)
+  {
+    SetNoDelay(fd);
+  }
+  return fd;
+}
+
+int AcceptTcp(int listen_fd, int send_buffer, int timeout_ms)
+{
+  pollfd waiting{listen_fd, POLLIN, 0};
+  if (poll(&waiting, 1, timeout_ms) <= 0)
+  {
+    return -1;
+  }
+  const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  SetNoDelay(fd);
+  if (send_buffer > 0)
+  {
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &send_buffer, sizeof(send_buffer));
+  }
+  return fd;
+}
+
+} // namespace ev3
+} // namespace isaac
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "LinkQueue.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// Every message on the link is a LinkFrameHeader followed by `length` bytes of payload. All
+// values are little-endian, as on the brick, the Jetson and the host.
+struct LinkFrameHeader {
+  uint16_t magic;
+  uint8_t channel;
+  uint8_t reserved;
+  uint32_t length;
+  int64_t acqtime;
+};
+static_assert(sizeof(LinkFrameHeader) == 16, "LinkFrameHeader must not be padded");
+
+constexpr uint16_t kLinkFrameMagic = 0x4b4c;  // "LK"
+// Frames longer than this are treated as a corrupt stream
+constexpr uint32_t kLinkMaxPayload = 1 << 20;
+
+// Payload of a flatscan: invalid and out of range thresholds, the count, then `count` ranges and
+// `count` angles
+struct LinkScan {
+  float invalid_range_threshold = 0.0f;
+  float out_of_range_threshold = 0.0f;
+  std::vector<float> ranges;
+  std::vector<float> angles;
+};
+
+// Payload of an odometry message
+struct LinkOdometry {
+  double x, y, heading;
+  double speed_x, speed_y, angular_speed;
+};
+
+// Sizes the payload of `message` for a scan of `count` rays and writes the header of the scan.
+// Returns where the ranges are to be written, followed by the angles.
+float* PrepareScan(uint32_t count, float invalid_range_threshold, float out_of_range_threshold,
+                   LinkMessage& message);
+// Serialize into the payload of `message`, reusing its capacity
+void EncodeScan(const float* ranges, const float* angles, uint32_t count,
+                float invalid_range_threshold, float out_of_range_threshold,
+                LinkMessage& message);
+void EncodeOdometry(const LinkOdometry& odometry, LinkMessage& message);
+// Deserialize a payload, false if it is malformed
+bool DecodeScan(const uint8_t* payload, size_t length, LinkScan& scan);
+bool DecodeOdometry(const uint8_t* payload, size_t length, LinkOdometry& odometry);
+
+// Writes the header and the payload of a message with a single system call. Returns the number of
+// bytes written or 0 if the connection failed.
+size_t WriteFrame(int fd, const LinkMessage& message);
+// Reads the next frame, false if the connection failed or the stream is corrupt
+bool ReadFrame(int fd, LinkMessage& message);
+
+// Opens a listening TCP socket on all interfaces, -1 on error
+int ListenTcp(int port);
+// Connects to host:port with TCP_NODELAY, -1 on error
+int ConnectTcp(const std::string& host, int port);
+// Accepts a connection with TCP_NODELAY and a send buffer of `send_buffer` bytes. A small send
+// buffer keeps messages in the LinkQueue, where they can still be dropped or replaced, instead of
+// in the kernel. Waits at most `timeout_ms`, -1 on timeout or error.
+int AcceptTcp(int listen_fd, int send_buffer, int timeout_ms);
+
+}  // namespace ev3
+}  // namespace isaac
@@ -0,0 +1,121 @@
+#include "LinkQueue.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace isaac
+{
+namespace ev3
+{
+
+LinkQueue::LinkQueue(size_t max_scans, double max_scan_age)
+    : max_scans_(std::max<size_t>(1, max_scans)), max_scan_age_(static_cast<int64_t>(max_scan_age * 1e9))
+{
+}
+
+std::vector<uint8_t> LinkQueue::takeBuffer()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (spare_.empty())
+  {
+    return std::vector<uint8_t>();
+  }
+  std::vector<uint8_t> buffer = std::move(spare_.back());
+  spare_.pop_back();
+  buffer.clear();
+  return buffer;
+}
+
+void LinkQueue::recycle(std::vector<uint8_t> &&buffer)
+{
+  // one buffer per queued message is enough
+  if (buffer.capacity() > 0 && spare_.size() <= max_scans_)
+  {
+    spare_.push_back(std::move(buffer));
+  }
+}
+
+void LinkQueue::push(LinkMessage &&message)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    newest_acqtime_ = std::max(newest_acqtime_, message.acqtime);
+    if (message.channel == LinkChannel::kOdometry)
+    {
+      // only the newest odometry matters, an older one is replaced
+      stats_.replaced_odometry += has_odometry_;
+      recycle(std::move(odometry_.payload));
+      odometry_ = std::move(message);
+      has_odometry_ = true;
+    }
+    else
+    {
+      if (scans_.size() >= max_scans_)
+      {
+        recycle(std::move(scans_.front().payload));
+        scans_.pop_front();
+        stats_.dropped_overflow++;
+      }
+      scans_.push_back(std::move(message));
+    }
+    dropStaleScans();
+  }
+  available_.notify_one();
+}
+
+void LinkQueue::dropStaleScans()
+{
+  while (!scans_.empty() && newest_acqtime_ - scans_.front().acqtime > max_scan_age_)
+  {
+    recycle(std::move(scans_.front().payload));
+    scans_.pop_front();
+    stats_.dropped_stale++;
+  }
+}
+
+bool LinkQueue::pop(LinkMessage &message, std::chrono::milliseconds timeout)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!available_.wait_for(lock, timeout, [this] { return closed_ || has_odometry_ || !scans_.empty(); }) ||
+      closed_)
+  {
+    return false;
+  }
+  recycle(std::move(message.payload));
+  if (has_odometry_)
+  {
+    message = std::move(odometry_);
+    has_odometry_ = false;
+    return true;
+  }
+  message = std::move(scans_.front());
+  scans_.pop_front();
+  return true;
+}
+
+void LinkQueue::markSent(size_t bytes)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.sent++;
+  stats_.bytes_sent += bytes;
+}
+
+void LinkQueue::close()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+  }
+  available_.notify_all();
+}
+
+LinkQueueStats LinkQueue::stats() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  LinkQueueStats stats = stats_;
+  stats.depth = scans_.size() + (has_odometry_ ? 1 : 0);
+  return stats;
+}
+
+} // namespace ev3
+} // namespace isaac
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace isaac {
+namespace ev3 {
+
+// Channels of the link, in order of priority
+enum class LinkChannel : uint8_t {
+  kOdometry = 0,
+  kFlatscan = 1,
+};
+
+// A serialized message waiting to be sent
+struct LinkMessage {
+  LinkChannel channel = LinkChannel::kFlatscan;
+  // Acquisition time in nanoseconds of the sender's app clock
+  int64_t acqtime = 0;
+  std::vector<uint8_t> payload;
+};
+
+struct LinkQueueStats {
+  // Messages waiting to be sent
+  size_t depth = 0;
+  uint64_t sent = 0;
+  uint64_t bytes_sent = 0;
+  // Scans dropped because the queue was full or because they were older than max_scan_age when
+  // their turn came
+  uint64_t dropped_overflow = 0;
+  uint64_t dropped_stale = 0;
+  // Odometry messages replaced by a newer one before they were sent
+  uint64_t replaced_odometry = 0;
+};
+
+// The send queue of a link which is slower than the data put into it, e.g. WiFi.
+//
+// A plain FIFO grows without bound on such a link and everything arrives late. This queue is
+// bounded and ordered by what the receiver needs: only the newest odometry is kept and it is sent
+// before anything else, scans are kept up to max_scans and the oldest ones are dropped first, on
+// overflow or when they are older than max_scan_age compared to the newest message. Thread-safe.
+class LinkQueue {
+ public:
+  LinkQueue(size_t max_scans, double max_scan_age);
+
+  // Returns an empty payload buffer with the capacity of a sent or dropped message, to serialize
+  // the next message into without allocating
+  std::vector<uint8_t> takeBuffer();
+  // Adds a message, possibly dropping or replacing older ones
+  void push(LinkMessage&& message);
+  // Takes the next message to send, waiting up to `timeout` for one. The payload buffer of
+  // `message` is recycled. Returns false on timeout or once the queue is closed.
+  bool pop(LinkMessage& message, std::chrono::milliseconds timeout);
+  // Counts a message as sent
+  void markSent(size_t bytes);
+  // Wakes up and fails all waiting and future pops
+  void close();
+
+  LinkQueueStats stats() const;
+
+ private:
+  // Drops scans which are older than max_scan_age, the lock is held
+  void dropStaleScans();
+  // Keeps a payload buffer for takeBuffer, the lock is held
+  void recycle(std::vector<uint8_t>&& buffer);
+
+  const size_t max_scans_;
+  const int64_t max_scan_age_;
+  mutable std::mutex mutex_;
+  std::condition_variable available_;
+  bool closed_ = false;
+  bool has_odometry_ = false;
+  LinkMessage odometry_;
+  std::deque<LinkMessage> scans_;
+  // payload buffers of sent and dropped messages, see takeBuffer
+  std::vector<std::vector<uint8_t>> spare_;
+  int64_t newest_acqtime_ = 0;
+  LinkQueueStats stats_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
@@ -0,0 +1,248 @@
+// Sends simulated scans and odometry through a LinkQueue over a loopback TCP connection whose
+// receiver reads no faster than a given rate, as a stand-in for the WiFi between the robot and the
+// GMapping host. Reports how late scans and odometry arrive and how many scans were dropped,
+// against a plain unbounded FIFO which sends everything in order like the TcpPublisher.
+//
+//   link_throttle_benchmark [BYTES_PER_SECOND [SECONDS]]
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "LinkFraming.hpp"
+#include "LinkQueue.hpp"
+
+using namespace isaac::ev3;
+
+namespace
+{
+
+// A YdLidar X4 scan and the odometry rate of ScanOdometry and the wheels
+constexpr int kRays = 720;
+constexpr double kScanRate = 7.0;
+constexpr double kOdometryRate = 50.0;
+// Send buffer of the PriorityLinkPublisher and receive buffer of the stand-in, which is about what
+// is in flight on the WiFi. The kernel doubles both.
+constexpr int kSendBuffer = 4096;
+constexpr int kReceiveBuffer = 4096;
+
+int64_t Now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Sends everything in order and never drops, like the TcpPublisher
+class FifoQueue
+{
+public:
+  std::vector<uint8_t> takeBuffer()
+  {
+    return std::vector<uint8_t>();
+  }
+  void push(LinkMessage &&message)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      messages_.push_back(std::move(message));
+    }
+    available_.notify_one();
+  }
+  bool pop(LinkMessage &message, std::chrono::milliseconds timeout)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!available_.wait_for(lock, timeout, [this] { return closed_ || !messages_.empty(); }) || closed_)
+    {
+      return false;
+    }
+    message = std::move(messages_.front());
+    messages_.pop_front();
+    return true;
+  }
+  void markSent(size_t) {}
+  void close()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    available_.notify_all();
+  }
+  size_t depth()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return messages_.size();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable available_;
+  bool closed_ = false;
+  std::deque<LinkMessage> messages_;
+};
+
+struct Latencies
+{
+  std::vector<double> scans;
+  std::vector<double> odometry;
+};
+
+double Percentile(std::vector<double> values, double fraction)
+{
+  if (values.empty())
+  {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, size_t(fraction * values.size()))];
+}
+
+// Reads frames no faster than `rate` bytes per second and records their latency in milliseconds
+void Receive(int fd, double rate, Latencies &latencies)
+{
+  LinkMessage message;
+  auto next = std::chrono::steady_clock::now();
+  while (ReadFrame(fd, message))
+  {
+    const double latency = 1e-6 * (Now() - message.acqtime);
+    (message.channel == LinkChannel::kFlatscan ? latencies.scans : latencies.odometry).push_back(latency);
+    next += std::chrono::nanoseconds(int64_t(1e9 * (sizeof(LinkFrameHeader) + message.payload.size()) / rate));
+    std::this_thread::sleep_until(next);
+  }
+}
+
+size_t queueDepth(FifoQueue &queue)
+{
+  return queue.depth();
+}
+
+size_t queueDepth(LinkQueue &queue)
+{
+  return queue.stats().depth;
+}
+
+template <typename Queue>
+void Run(const char *name, Queue &queue, double rate, double seconds)
+{
+  const int listen_fd = ListenTcp(0);
+  sockaddr_storage address;
+  socklen_t length = sizeof(address);
+  getsockname(listen_fd, reinterpret_cast<sockaddr *>(&address), &length);
+  const int port = ntohs(reinterpret_cast<sockaddr_in *>(&address)->sin_port);
+  // the receive buffer limits the TCP window only if it is set before connecting
+  const int receive_fd = socket(AF_INET, SOCK_STREAM, 0);
+  setsockopt(receive_fd, SOL_SOCKET, SO_RCVBUF, &kReceiveBuffer, sizeof(kReceiveBuffer));
+  reinterpret_cast<sockaddr_in *>(&address)->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(receive_fd, reinterpret_cast<sockaddr *>(&address), length) < 0)
+  {
+    std::fprintf(stderr, "Could not connect to port %d\n", port);
+    std::exit(1);
+  }
+  const int send_fd = AcceptTcp(listen_fd, kSendBuffer, 1000);
+  if (listen_fd < 0 || receive_fd < 0 || send_fd < 0)
+  {
+    std::fprintf(stderr, "Could not open a loopback connection\n");
+    std::exit(1);
+  }
+
+  Latencies latencies;
+  std::thread receiver(Receive, receive_fd, rate, std::ref(latencies));
+  std::atomic<bool> running{true};
+  uint64_t bytes = 0;
+  std::thread sender([&] {
+    LinkMessage message;
+    while (running)
+    {
+      if (queue.pop(message, std::chrono::milliseconds(100)))
+      {
+        const size_t written = WriteFrame(send_fd, message);
+        queue.markSent(written);
+        bytes += written;
+      }
+    }
+  });
+
+  // the robot drives a circle, the scans are noise of the right size
+  std::vector<float> ranges(kRays), angles(kRays);
+  for (int i = 0; i < kRays; i++)
+  {
+    angles[i] = 2.0f * M_PI * i / kRays;
+    ranges[i] = 1.0f + 0.001f * (i % 97);
+  }
+  const auto start = std::chrono::steady_clock::now();
+  const int ticks = int(seconds * kOdometryRate);
+  const int odometry_per_scan = int(kOdometryRate / kScanRate);
+  size_t max_depth = 0;
+  for (int tick = 0; tick < ticks; tick++)
+  {
+    std::this_thread::sleep_until(start + std::chrono::nanoseconds(int64_t(1e9 * tick / kOdometryRate)));
+    const double t = tick / kOdometryRate;
+    LinkMessage odometry;
+    odometry.payload = queue.takeBuffer();
+    odometry.acqtime = Now();
+    EncodeOdometry({std::cos(t), std::sin(t), t, -std::sin(t), std::cos(t), 1.0}, odometry);
+    queue.push(std::move(odometry));
+    if (tick % odometry_per_scan == 0)
+    {
+      LinkMessage scan;
+      scan.payload = queue.takeBuffer();
+      scan.acqtime = Now();
+      EncodeScan(ranges.data(), angles.data(), kRays, 0.1f, 12.0f, scan);
+      queue.push(std::move(scan));
+    }
+    max_depth = std::max(max_depth, queueDepth(queue));
+  }
+  // whatever is still queued is never delivered within the run
+  running = false;
+  queue.close();
+  sender.join();
+  shutdown(send_fd, SHUT_WR);
+  receiver.join();
+  close(send_fd);
+  close(receive_fd);
+  close(listen_fd);
+
+  const int scans = (ticks + odometry_per_scan - 1) / odometry_per_scan;
+  std::printf("%-10s %8d %10zu %10.1f %10.1f %10.1f %10.1f %10zu %10.1f\n", name, scans, latencies.scans.size(),
+              Percentile(latencies.scans, 0.5), Percentile(latencies.scans, 0.95),
+              Percentile(latencies.odometry, 0.5), Percentile(latencies.odometry, 0.95), max_depth,
+              8e-3 * bytes / seconds);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  // about 80 % of the scan data, a WiFi link with a weak signal
+  const double rate = argc > 1 ? std::atof(argv[1]) : 35000.0;
+  const double seconds = argc > 2 ? std::atof(argv[2]) : 10.0;
+  std::printf("%d rays at %.0f Hz, odometry at %.0f Hz, link %.1f kB/s for %.0f s\n", kRays, kScanRate,
+              kOdometryRate, 1e-3 * rate, seconds);
+  std::printf("%-10s %8s %10s %10s %10s %10s %10s %10s %10s\n", "queue", "scans", "delivered", "scan p50",
+              "scan p95", "odom p50", "odom p95", "max depth", "kbit/s");
+  std::printf("%-10s %8s %10s %10s %10s %10s %10s %10s %10s\n", "", "", "", "ms", "ms", "ms", "ms", "", "");
+
+  FifoQueue fifo;
+  Run("fifo", fifo, rate, seconds);
+  // the defaults of PriorityLinkPublisher
+  LinkQueue priority(2, 0.5);
+  Run("priority", priority, rate, seconds);
+  const LinkQueueStats stats = priority.stats();
+  std::printf("priority queue dropped %llu scans on overflow and %llu stale, replaced %llu odometry messages\n",
+              static_cast<unsigned long long>(stats.dropped_overflow),
+              static_cast<unsigned long long>(stats.dropped_stale),
+              static_cast<unsigned long long>(stats.replaced_odometry));
+  return 0;
+}
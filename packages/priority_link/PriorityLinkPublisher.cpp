@@ -0,0 +1,194 @@
+#include "PriorityLinkPublisher.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "messages/math.hpp"
+#include "packages/priority_link/LinkFraming.hpp"
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+// Shortest interval in seconds over which the throughput is measured
+constexpr double kStatsInterval = 1.0;
+} // namespace
+
+void PriorityLinkPublisher::start()
+{
+  listen_fd_ = ListenTcp(get_port());
+  if (listen_fd_ < 0)
+  {
+    LOG_ERROR("Could not listen on port %d, not publishing", get_port());
+    return;
+  }
+  queue_.reset(new LinkQueue(std::max(1, get_max_scans()), get_max_scan_age()));
+  running_ = true;
+  sender_ = std::thread(&PriorityLinkPublisher::sendLoop, this, get_send_buffer());
+  tickOnMessage(rx_flatscan());
+  tickOnMessage(rx_odometry());
+}
+
+void PriorityLinkPublisher::stop()
+{
+  tick_latency_.dump(full_name());
+  running_ = false;
+  {
+    // a write blocked on a stalled link fails instead of delaying the join below
+    std::lock_guard<std::mutex> lock(connection_mutex_);
+    if (connection_fd_ >= 0)
+    {
+      shutdown(connection_fd_, SHUT_RDWR);
+    }
+  }
+  if (queue_)
+  {
+    queue_->close();
+    const LinkQueueStats stats = queue_->stats();
+    LOG_INFO("Sent %llu messages, dropped %llu scans on overflow and %llu stale, replaced %llu "
+             "odometry messages",
+             static_cast<unsigned long long>(stats.sent),
+             static_cast<unsigned long long>(stats.dropped_overflow),
+             static_cast<unsigned long long>(stats.dropped_stale),
+             static_cast<unsigned long long>(stats.replaced_odometry));
+  }
+  if (sender_.joinable())
+  {
+    sender_.join();
+  }
+  if (listen_fd_ >= 0)
+  {
+    close(listen_fd_);
+    listen_fd_ = -1;
+  }
+}
+
+void PriorityLinkPublisher::tick()
+{
+  const auto timer = tick_latency_.measure();
+  tick_latency_.report(getTickTime(), [this](const char* tag, double value) { show(tag, value); });
+
+  // the tick is triggered by either channel, only new messages are queued
+  if (rx_odometry().available() && rx_odometry().acqtime() != odometry_acqtime_)
+  {
+    odometry_acqtime_ = rx_odometry().acqtime();
+    queueOdometry();
+  }
+  if (rx_flatscan().available() && rx_flatscan().acqtime() != scan_acqtime_)
+  {
+    scan_acqtime_ = rx_flatscan().acqtime();
+    queueScan();
+  }
+  showStats();
+}
+
+void PriorityLinkPublisher::queueScan()
+{
+  auto scan = rx_flatscan().getProto();
+  auto ranges = scan.getRanges();
+  auto angles = scan.getAngles();
+  const uint32_t count = std::min(ranges.size(), angles.size());
+  LinkMessage message;
+  message.payload = queue_->takeBuffer();
+  message.acqtime = scan_acqtime_;
+  float* values = PrepareScan(count, scan.getInvalidRangeThreshold(), scan.getOutOfRangeThreshold(),
+                              message);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    values[i] = ranges[i];
+    values[count + i] = angles[i];
+  }
+  queue_->push(std::move(message));
+}
+
+void PriorityLinkPublisher::queueOdometry()
+{
+  auto proto = rx_odometry().getProto();
+  const Pose2d odom_T_robot = FromProto(proto.getOdomTRobot());
+  const Vector2d speed = FromProto(proto.getSpeed());
+  const LinkOdometry odometry{odom_T_robot.translation.x(), odom_T_robot.translation.y(),
+                              odom_T_robot.rotation.angle(), speed.x(), speed.y(),
+                              proto.getAngularSpeed()};
+  LinkMessage message;
+  message.payload = queue_->takeBuffer();
+  message.acqtime = odometry_acqtime_;
+  EncodeOdometry(odometry, message);
+  queue_->push(std::move(message));
+}
+
+void PriorityLinkPublisher::showStats()
+{
+  const LinkQueueStats stats = queue_->stats();
+  show("connected", connected_ ? 1.0 : 0.0);
+  show("queue.depth", static_cast<double>(stats.depth));
+  show("dropped.overflow", static_cast<double>(stats.dropped_overflow));
+  show("dropped.stale", static_cast<double>(stats.dropped_stale));
+  show("odometry.replaced", static_cast<double>(stats.replaced_odometry));
+  const double elapsed = getTickTime() - stats_time_;
+  if (elapsed >= kStatsInterval)
+  {
+    show("throughput_kbps", 8e-3 * static_cast<double>(stats.bytes_sent - stats_bytes_) / elapsed);
+    stats_time_ = getTickTime();
+    stats_bytes_ = stats.bytes_sent;
+  }
+}
+
+void PriorityLinkPublisher::sendLoop(int send_buffer)
+{
+  constexpr int kTimeoutMs = 100;
+  int fd = -1;
+  LinkMessage message;
+  while (running_)
+  {
+    if (fd < 0)
+    {
+      // messages keep being queued and dropped while nobody is connected
+      fd = AcceptTcp(listen_fd_, send_buffer, kTimeoutMs);
+      std::lock_guard<std::mutex> lock(connection_mutex_);
+      if (fd >= 0 && !running_)
+      {
+        // stop() did not see this connection
+        close(fd);
+        fd = -1;
+      }
+      connection_fd_ = fd;
+      connected_ = fd >= 0;
+      continue;
+    }
+    if (!queue_->pop(message, std::chrono::milliseconds(kTimeoutMs)))
+    {
+      continue;
+    }
+    const size_t written = WriteFrame(fd, message);
+    if (written == 0)
+    {
+      if (running_)
+      {
+        LOG_WARNING("Subscriber disconnected");
+      }
+      std::lock_guard<std::mutex> lock(connection_mutex_);
+      close(fd);
+      fd = -1;
+      connection_fd_ = -1;
+      connected_ = false;
+      continue;
+    }
+    queue_->markSent(written);
+  }
+  std::lock_guard<std::mutex> lock(connection_mutex_);
+  if (fd >= 0)
+  {
+    close(fd);
+    connection_fd_ = -1;
+  }
+}
+
+} // namespace ev3
+} // namespace isaac
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "engine/alice/alice.hpp"
+#include "messages/messages.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
+#include "packages/priority_link/LinkQueue.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// Sends flatscans and odometry to a PriorityLinkSubscriber over TCP, as a replacement of the
+// TcpPublisher for links which are slower than the data, e.g. the WiFi of the robot.
+//
+// Messages wait in a LinkQueue: the newest odometry is always sent next, the oldest scans are
+// dropped first if the link falls behind. A sender thread writes to the connected subscriber and
+// keeps the kernel send buffer small, thus stale data is dropped here instead of queuing in the
+// kernel. The queue depth, the drop counts and the throughput are shown as telemetry.
+class PriorityLinkPublisher : public isaac::alice::Codelet {
+ public:
+  void start() override;
+  void stop() override;
+  void tick() override;
+
+  // Scans to send, dropped first if the link is too slow
+  ISAAC_PROTO_RX(FlatscanProto, flatscan);
+  // Odometry to send, only the newest one is kept
+  ISAAC_PROTO_RX(Odometry2Proto, odometry);
+
+  // TCP port on which the subscriber connects
+  ISAAC_PARAM(int, port, 5000);
+  // Number of scans which wait for the link at most
+  ISAAC_PARAM(int, max_scans, 2);
+  // Scans older than this many seconds compared to the newest message are not sent anymore
+  ISAAC_PARAM(double, max_scan_age, 0.5);
+  // Size of the kernel send buffer in bytes, which the kernel doubles. About one scan fits.
+  ISAAC_PARAM(int, send_buffer, 4096);
+
+ private:
+  // Accepts the subscriber and sends queued messages until stop
+  void sendLoop(int send_buffer);
+  // Serializes the received messages into the queue
+  void queueScan();
+  void queueOdometry();
+  // Shows the queue statistics and the throughput since the last call
+  void showStats();
+
+  std::unique_ptr<LinkQueue> queue_;
+  std::thread sender_;
+  std::atomic<bool> running_{false};
+  std::atomic<bool> connected_{false};
+  int listen_fd_ = -1;
+  // Connection of the sender thread, shut down by stop() to wake a blocked write. Only the sender
+  // thread closes it, under the mutex, thus stop() never shuts down a reused descriptor.
+  std::mutex connection_mutex_;
+  int connection_fd_ = -1;
+  int64_t scan_acqtime_ = 0;
+  int64_t odometry_acqtime_ = 0;
+  double stats_time_ = 0.0;
+  uint64_t stats_bytes_ = 0;
+  TickLatency tick_latency_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
+
+ISAAC_ALICE_REGISTER_CODELET(isaac::ev3::PriorityLinkPublisher);
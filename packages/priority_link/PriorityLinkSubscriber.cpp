@@ -0,0 +1,179 @@
+#include "PriorityLinkSubscriber.hpp"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+#include "messages/math.hpp"
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+// Longest time in milliseconds a tick waits for the next frame, thus ticks end while the link is idle
+constexpr int kPollTimeoutMs = 100;
+} // namespace
+
+void PriorityLinkSubscriber::start()
+{
+  {
+    std::lock_guard<std::mutex> lock(fd_mutex_);
+    stopping_ = false;
+  }
+  // reading blocks until the next frame arrives
+  tickBlocking();
+}
+
+void PriorityLinkSubscriber::stop()
+{
+  {
+    std::unique_lock<std::mutex> lock(fd_mutex_);
+    stopping_ = true;
+    if (fd_ >= 0)
+    {
+      // a read in tick() fails instead of waiting for the next frame
+      shutdown(fd_, SHUT_RDWR);
+    }
+    read_done_.wait(lock, [this] { return !reading_; });
+    if (fd_ >= 0)
+    {
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+  LOG_INFO("Received %llu scans and %llu odometry messages", static_cast<unsigned long long>(scans_),
+           static_cast<unsigned long long>(odometries_));
+  tick_latency_.dump(full_name());
+}
+
+void PriorityLinkSubscriber::tick()
+{
+  tick_latency_.report(getTickTime(), [this](const char* tag, double value) { show(tag, value); });
+  int fd;
+  {
+    std::lock_guard<std::mutex> lock(fd_mutex_);
+    if (stopping_)
+    {
+      return;
+    }
+    fd = fd_;
+  }
+  if (fd < 0)
+  {
+    fd = ConnectTcp(get_host(), get_port());
+    if (fd < 0)
+    {
+      std::this_thread::sleep_for(std::chrono::duration<double>(get_reconnect_interval()));
+      return;
+    }
+    std::lock_guard<std::mutex> lock(fd_mutex_);
+    if (stopping_)
+    {
+      close(fd);
+      return;
+    }
+    fd_ = fd;
+    LOG_INFO("Connected to %s:%d", get_host().c_str(), get_port());
+  }
+  {
+    std::lock_guard<std::mutex> lock(fd_mutex_);
+    if (stopping_)
+    {
+      return;
+    }
+    reading_ = true;
+  }
+  // a shutdown by stop() wakes both the poll and the read
+  pollfd waiting{fd, POLLIN, 0};
+  const bool readable = poll(&waiting, 1, kPollTimeoutMs) != 0;
+  bool received = false;
+  if (readable)
+  {
+    const auto timer = tick_latency_.measure();
+    received = ReadFrame(fd, message_) && publish(message_);
+  }
+  {
+    std::lock_guard<std::mutex> lock(fd_mutex_);
+    reading_ = false;
+    read_done_.notify_all();
+    if (!readable)
+    {
+      return;
+    }
+    if (!received)
+    {
+      if (!stopping_)
+      {
+        LOG_WARNING("Lost the connection to %s:%d", get_host().c_str(), get_port());
+        close(fd_);
+        fd_ = -1;
+      }
+      return;
+    }
+  }
+  bytes_ += sizeof(LinkFrameHeader) + message_.payload.size();
+  showStats();
+}
+
+bool PriorityLinkSubscriber::publish(const LinkMessage& message)
+{
+  if (message.channel == LinkChannel::kOdometry)
+  {
+    LinkOdometry odometry;
+    if (!DecodeOdometry(message.payload.data(), message.payload.size(), odometry))
+    {
+      return false;
+    }
+    auto proto = tx_odometry().initProto();
+    ToProto(Pose2d::FromXYA(odometry.x, odometry.y, odometry.heading), proto.initOdomTRobot());
+    ToProto(Vector2d(odometry.speed_x, odometry.speed_y), proto.initSpeed());
+    proto.setAngularSpeed(odometry.angular_speed);
+    proto.setOdometryFrame(get_odometry_frame());
+    proto.setRobotFrame(get_robot_frame());
+    tx_odometry().publish(message.acqtime);
+    odometries_++;
+    return true;
+  }
+  if (!DecodeScan(message.payload.data(), message.payload.size(), scan_))
+  {
+    return false;
+  }
+  const uint32_t count = scan_.ranges.size();
+  auto proto = tx_flatscan().initProto();
+  auto ranges = proto.initRanges(count);
+  auto angles = proto.initAngles(count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    ranges.set(i, scan_.ranges[i]);
+    angles.set(i, scan_.angles[i]);
+  }
+  proto.setInvalidRangeThreshold(scan_.invalid_range_threshold);
+  proto.setOutOfRangeThreshold(scan_.out_of_range_threshold);
+  // GMapping looks up the odometry at the acquisition time of the scan
+  tx_flatscan().publish(message.acqtime);
+  scans_++;
+  return true;
+}
+
+void PriorityLinkSubscriber::showStats()
+{
+  const double elapsed = getTickTime() - stats_time_;
+  if (elapsed < 1.0)
+  {
+    return;
+  }
+  show("received.scans", static_cast<double>(scans_));
+  show("received.odometry", static_cast<double>(odometries_));
+  show("throughput_kbps", 8e-3 * static_cast<double>(bytes_ - stats_bytes_) / elapsed);
+  stats_time_ = getTickTime();
+  stats_bytes_ = bytes_;
+}
+
+} // namespace ev3
+} // namespace isaac
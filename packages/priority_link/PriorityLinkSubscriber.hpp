@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include "engine/alice/alice.hpp"
+#include "messages/messages.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
+#include "packages/priority_link/LinkFraming.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// Receives flatscans and odometry from a PriorityLinkPublisher and publishes them with their
+// original acquisition time. Reconnects if the link drops.
+class PriorityLinkSubscriber : public isaac::alice::Codelet {
+ public:
+  void start() override;
+  void stop() override;
+  void tick() override;
+
+  ISAAC_PROTO_TX(FlatscanProto, flatscan);
+  ISAAC_PROTO_TX(Odometry2Proto, odometry);
+
+  // Address of the robot running the publisher
+  ISAAC_PARAM(std::string, host, "localhost");
+  ISAAC_PARAM(int, port, 5000);
+  // Seconds to wait before connecting again
+  ISAAC_PARAM(double, reconnect_interval, 1.0);
+  // Frames written into the odometry messages
+  ISAAC_PARAM(std::string, odometry_frame, "odom");
+  ISAAC_PARAM(std::string, robot_frame, "robot");
+
+ private:
+  // Publishes a received message, false if it is malformed
+  bool publish(const LinkMessage& message);
+  void showStats();
+
+  // The connection is closed under the mutex and never while tick() reads from it. stop() shuts it
+  // down to wake a blocked read, waits for the read to end and then closes it.
+  std::mutex fd_mutex_;
+  std::condition_variable read_done_;
+  int fd_ = -1;
+  bool reading_ = false;
+  bool stopping_ = false;
+  LinkMessage message_;
+  LinkScan scan_;
+  uint64_t scans_ = 0;
+  uint64_t odometries_ = 0;
+  uint64_t bytes_ = 0;
+  double stats_time_ = 0.0;
+  uint64_t stats_bytes_ = 0;
+  // reading and publishing a frame, without the wait for it
+  TickLatency tick_latency_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
+
+ISAAC_ALICE_REGISTER_CODELET(isaac::ev3::PriorityLinkSubscriber);
@@ -0,0 +1,68 @@
+#include "ScanKeyframeGate.hpp"
+
+#include <cmath>
+
+#include "engine/core/time.hpp"
+#include "messages/math.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+void ScanKeyframeGate::start() {
+  tickOnMessage(rx_flatscan());
+}
+
+void ScanKeyframeGate::stop() {
+  tick_latency_.dump(full_name());
+  LOG_INFO("Forwarded %llu of %llu scans", static_cast<unsigned long long>(forwarded_),
+           static_cast<unsigned long long>(received_));
+}
+
+void ScanKeyframeGate::tick() {
+  const auto timer = tick_latency_.measure();
+  tick_latency_.report(getTickTime(), [this](const char* tag, double value) { show(tag, value); });
+
+  received_++;
+  const int64_t acqtime = rx_flatscan().acqtime();
+  // without odometry there is nothing to gate on
+  bool pass = !has_keyframe_ || !rx_odometry().available();
+  if (!pass) {
+    pass = ToSeconds(acqtime - keyframe_acqtime_) >= get_max_interval();
+  }
+  Pose2d odom_T_robot;
+  if (rx_odometry().available()) {
+    odom_T_robot = FromProto(rx_odometry().getProto().getOdomTRobot());
+    if (!pass) {
+      const Pose2d keyframe_T_robot = odom_T_keyframe_.inverse() * odom_T_robot;
+      pass = keyframe_T_robot.translation.norm() >= get_linear_distance() ||
+             std::abs(keyframe_T_robot.rotation.angle()) >= get_angular_distance();
+    }
+  }
+
+  if (pass) {
+    forward();
+    has_keyframe_ = rx_odometry().available();
+    odom_T_keyframe_ = odom_T_robot;
+    keyframe_acqtime_ = acqtime;
+    forwarded_++;
+  }
+  show("forwarded", static_cast<double>(forwarded_));
+  show("dropped", static_cast<double>(received_ - forwarded_));
+}
+
+void ScanKeyframeGate::forward() {
+  auto scan = rx_flatscan().getProto();
+  auto keyframe = tx_keyframe().initProto();
+  keyframe.setRanges(scan.getRanges());
+  keyframe.setAngles(scan.getAngles());
+  keyframe.setInvalidRangeThreshold(scan.getInvalidRangeThreshold());
+  keyframe.setOutOfRangeThreshold(scan.getOutOfRangeThreshold());
+  if (scan.getVisibilities().size() > 0) {
+    keyframe.setVisibilities(scan.getVisibilities());
+  }
+  // GMapping looks up the odometry at the acquisition time of the scan
+  tx_keyframe().publish(rx_flatscan().acqtime());
+}
+
+}  // namespace ev3
+}  // namespace isaac
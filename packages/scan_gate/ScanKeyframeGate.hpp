@@ -0,0 +1,50 @@
+#pragma once
+
+#include "engine/alice/alice.hpp"
+#include "messages/messages.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// Forwards a flatscan only if the robot moved far enough since the last forwarded scan, as
+// measured by odometry, or if the last forwarded scan is older than max_interval. GMapping ignores
+// updates below its linear and angular distance anyway, thus this keeps redundant scans off the
+// link while the robot stands still or moves slowly. Odometry is not gated and should be sent
+// directly.
+class ScanKeyframeGate : public isaac::alice::Codelet {
+ public:
+  void start() override;
+  void stop() override;
+  void tick() override;
+
+  // Scans to gate
+  ISAAC_PROTO_RX(FlatscanProto, flatscan);
+  // Odometry used to measure the motion between scans
+  ISAAC_PROTO_RX(Odometry2Proto, odometry);
+  // Scans which passed the gate
+  ISAAC_PROTO_TX(FlatscanProto, keyframe);
+
+  // Distance in meters the robot has to move to pass a new scan
+  ISAAC_PARAM(double, linear_distance, 0.02);
+  // Angle in radians the robot has to turn to pass a new scan
+  ISAAC_PARAM(double, angular_distance, 0.02);
+  // A scan passes if the last one passed longer than this many seconds ago
+  ISAAC_PARAM(double, max_interval, 1.0);
+
+ private:
+  // Copies the received scan to the keyframe channel
+  void forward();
+
+  bool has_keyframe_ = false;
+  Pose2d odom_T_keyframe_;
+  int64_t keyframe_acqtime_ = 0;
+  uint64_t received_ = 0;
+  uint64_t forwarded_ = 0;
+  TickLatency tick_latency_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
+
+ISAAC_ALICE_REGISTER_CODELET(isaac::ev3::ScanKeyframeGate);
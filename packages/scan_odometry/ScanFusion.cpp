@@ -0,0 +1,144 @@
+#include "ScanFusion.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+
+// Blends two small motions component-wise, they are close to each other for a good match
+ScanPose blend(const ScanPose &a, const ScanPose &b, float weight_b)
+{
+  const float weight_a = 1.0f - weight_b;
+  return ScanPose{weight_a * a.x + weight_b * b.x, weight_a * a.y + weight_b * b.y,
+                  weight_a * a.heading + weight_b * b.heading};
+}
+
+} // namespace
+
+ScanPose Compose(const ScanPose &a, const ScanPose &b)
+{
+  const float c = std::cos(a.heading), s = std::sin(a.heading);
+  return ScanPose{a.x + c * b.x - s * b.y, a.y + s * b.x + c * b.y,
+                  std::remainder(a.heading + b.heading, 2.0f * float(M_PI))};
+}
+
+ScanPose Inverse(const ScanPose &a)
+{
+  const float c = std::cos(a.heading), s = std::sin(a.heading);
+  return ScanPose{-c * a.x - s * a.y, s * a.x - c * a.y, -a.heading};
+}
+
+WheelIntegrator::WheelIntegrator(double timeout) : timeout_(timeout) {}
+
+void WheelIntegrator::reset(double time)
+{
+  pending_.clear();
+  current_ = State{time, 0.0, 0.0};
+  integrated_time_ = time;
+  motion_ = ScanPose();
+}
+
+void WheelIntegrator::addState(double time, double linear_speed, double angular_speed)
+{
+  pending_.push_back(State{time, linear_speed, angular_speed});
+}
+
+void WheelIntegrator::integrate(double time)
+{
+  // the speeds hold from the time they were measured until `time` or the timeout
+  const double end = std::min(time, current_.time + timeout_);
+  const double dt = end - integrated_time_;
+  if (dt > 0.0)
+  {
+    motion_ = Compose(motion_, ScanPose{static_cast<float>(current_.linear_speed * dt), 0.0f,
+                                        static_cast<float>(current_.angular_speed * dt)});
+  }
+  integrated_time_ = std::max(integrated_time_, time);
+}
+
+ScanPose WheelIntegrator::take(double time)
+{
+  size_t used = 0;
+  for (; used < pending_.size() && pending_[used].time <= time; used++)
+  {
+    integrate(pending_[used].time);
+    current_ = pending_[used];
+  }
+  pending_.erase(pending_.begin(), pending_.begin() + used);
+  integrate(time);
+  const ScanPose motion = motion_;
+  motion_ = ScanPose();
+  return motion;
+}
+
+ScanFusion::ScanFusion(const ScanFusionOptions &options) : options_(options), matcher_(options.matcher) {}
+
+void ScanFusion::mergePoints(const float *xs, const float *ys, size_t count)
+{
+  const float min_distance2 = options_.min_point_distance * options_.min_point_distance;
+  xs_.clear();
+  ys_.clear();
+  for (size_t i = 0; i < count; i++)
+  {
+    if (!xs_.empty())
+    {
+      const float dx = xs[i] - xs_.back();
+      const float dy = ys[i] - ys_.back();
+      if (dx * dx + dy * dy < min_distance2)
+      {
+        continue;
+      }
+    }
+    xs_.push_back(xs[i]);
+    ys_.push_back(ys[i]);
+  }
+}
+
+ScanFusionResult ScanFusion::add(const float *xs, const float *ys, size_t count, const ScanPose &wheel_delta)
+{
+  ScanFusionResult result;
+  const ScanPose wheel = Compose(pending_wheel_, wheel_delta);
+  mergePoints(xs, ys, count);
+  if (xs_.size() < options_.min_points)
+  {
+    pending_wheel_ = wheel;
+    return result;
+  }
+  pending_wheel_ = ScanPose();
+  if (!matcher_.hasReference())
+  {
+    matcher_.setReference(xs_.data(), ys_.data(), xs_.size());
+    return result;
+  }
+  result.used = true;
+
+  // the wheel motion is the initial guess of the pose relative to the keyframe
+  const ScanPose guess = Compose(keyframe_T_robot_, wheel);
+  result.match = matcher_.match(xs_.data(), ys_.data(), xs_.size(), guess);
+  result.delta = wheel;
+  if (result.match.valid)
+  {
+    // the fewer points found a correspondence the less the match is trusted
+    const float outliers = 1.0f - float(result.match.inliers) / float(xs_.size());
+    result.delta = blend(Compose(Inverse(keyframe_T_robot_), result.match.pose), wheel,
+                         options_.wheel_weight * std::max(0.0f, outliers));
+  }
+  keyframe_T_robot_ = Compose(keyframe_T_robot_, result.delta);
+
+  if (std::hypot(keyframe_T_robot_.x, keyframe_T_robot_.y) >= options_.keyframe_distance ||
+      std::abs(keyframe_T_robot_.heading) >= options_.keyframe_angle || !result.match.valid)
+  {
+    matcher_.setReference(xs_.data(), ys_.data(), xs_.size());
+    keyframe_T_robot_ = ScanPose();
+  }
+  return result;
+}
+
+} // namespace ev3
+} // namespace isaac
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "ScanMatcher.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// Composes two poses, `a` followed by `b` in the frame of `a`
+ScanPose Compose(const ScanPose& a, const ScanPose& b);
+// The pose which composed with `a` gives the identity
+ScanPose Inverse(const ScanPose& a);
+
+// Integrates the speeds of a differential base into a motion. The speeds of a state hold until the
+// next state, but at most `timeout` seconds after they were measured: a base whose states stop
+// arriving is assumed to stand instead of driving on forever.
+class WheelIntegrator {
+ public:
+  explicit WheelIntegrator(double timeout = 0.5);
+
+  // Restarts the integration at `time` with the base standing
+  void reset(double time);
+  // Adds the speeds measured at `time`. States are expected in the order of their times and may be
+  // newer than the next scan, they are only integrated once a scan is taken after them.
+  void addState(double time, double linear_speed, double angular_speed);
+  // Integrates all states up to `time` and returns the motion since the previous call
+  ScanPose take(double time);
+
+ private:
+  struct State {
+    double time;
+    double linear_speed;
+    double angular_speed;
+  };
+
+  // Integrates the current speeds up to `time`
+  void integrate(double time);
+
+  double timeout_;
+  // states newer than the last scan
+  std::vector<State> pending_;
+  State current_{0.0, 0.0, 0.0};
+  double integrated_time_ = 0.0;
+  ScanPose motion_;
+};
+
+struct ScanFusionOptions {
+  ScanMatcherOptions matcher;
+  // Distance in meters and angle in radians from the keyframe at which a new keyframe is taken
+  float keyframe_distance = 0.1f;
+  float keyframe_angle = 0.2f;
+  // Weight of the wheel motion when fusing it with a valid matched motion, scaled by the fraction
+  // of points without a correspondence. The default 0 uses the wheels only as the initial guess and
+  // for failed matches: the tracks slip, thus a fixed blend pulls the pose towards the slip.
+  float wheel_weight = 0.0f;
+  // Points closer than this to each other are merged, bounds the matching time of dense scans
+  float min_point_distance = 0.01f;
+  // Scans with fewer points after merging are skipped
+  size_t min_points = 16;
+};
+
+// Outcome of adding a scan
+struct ScanFusionResult {
+  // False if the scan had too few points or was the first one. Its wheel motion is then carried
+  // over to the next scan.
+  bool used = false;
+  // Fused motion since the previous used scan
+  ScanPose delta;
+  ScanMatch match;
+};
+
+// The odometry step of ScanOdometry: matches every scan against a keyframe starting from the wheel
+// motion, uses the matched motion or the wheel motion if the match failed, and takes a new keyframe
+// once the robot moved far enough from the old one or the match failed.
+class ScanFusion {
+ public:
+  explicit ScanFusion(const ScanFusionOptions& options = ScanFusionOptions());
+
+  // Adds a scan given as points in the robot frame in scan order together with the wheel motion
+  // since the previous scan. Does not allocate once buffers reached the scan size.
+  ScanFusionResult add(const float* xs, const float* ys, size_t count, const ScanPose& wheel_delta);
+
+  // Number of points of the last scan after merging close ones
+  size_t points() const { return xs_.size(); }
+  const ScanFusionOptions& options() const { return options_; }
+
+ private:
+  // Copies the points to xs_ and ys_, skipping points close to the previous one
+  void mergePoints(const float* xs, const float* ys, size_t count);
+
+  ScanFusionOptions options_;
+  ScanMatcher matcher_;
+  std::vector<float> xs_;
+  std::vector<float> ys_;
+  ScanPose keyframe_T_robot_;
+  // wheel motion of skipped scans
+  ScanPose pending_wheel_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
@@ -0,0 +1,172 @@
+// Measures the time the odometry step of ScanOdometry takes for the scans of a robot driving through
+// a simulated room and how far its poses drift compared to wheel odometry with track slip. The scans
+// go through ScanFusion like in the codelet, with point merging, keyframes and the optional blend
+// with the wheel motion, which is integrated by WheelIntegrator from base states arriving between
+// the scans.
+// Also times the two parts of ScanMatcher on their own.
+//
+//   scan_match_benchmark [BEAMS [NOISE_M [SLIP [WHEEL_WEIGHT]]]] [--benchmark_out=PATH]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "ScanFusion.hpp"
+#include "packages/lidar_simulator/MapRayCaster.hpp"
+#include "packages/utils/Benchmark.hpp"
+
+using namespace isaac::ev3;
+
+namespace
+{
+
+// A room of 8 x 8 m with a few boxes, in cells of 2.5 cm
+constexpr int kRoomCells = 320;
+constexpr float kRoomCellSize = 0.025f;
+constexpr float kMinRange = 0.12f;
+constexpr float kMaxRange = 8.0f;
+constexpr int kScans = 400;
+// The lidar of the EV3 turns at 5 Hz, Ev3Driver publishes base states at 20 Hz
+constexpr double kScanPeriod = 0.2;
+constexpr int kStatesPerScan = 4;
+// Base states are measured a bit after the scans
+constexpr double kStateDelay = 0.01;
+
+struct Points
+{
+  std::vector<float> x, y;
+};
+
+float wrap(float angle)
+{
+  return std::remainder(angle, 2.0f * float(M_PI));
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const std::string json_path = ParseBenchmarkOut(argc, argv);
+  const size_t beams = argc > 1 ? std::atoi(argv[1]) : 720;
+  const float noise = argc > 2 ? std::atof(argv[2]) : 0.01f;
+  // fraction of the wheel motion lost to slip, more when turning
+  const float slip = argc > 3 ? std::atof(argv[3]) : 0.15f;
+  ScanFusionOptions options;
+  if (argc > 4)
+  {
+    options.wheel_weight = std::atof(argv[4]);
+  }
+
+  std::vector<uint8_t> room(kRoomCells * kRoomCells, 0);
+  auto box = [&](int r0, int c0, int r1, int c1) {
+    for (int r = r0; r < r1; r++)
+      for (int c = c0; c < c1; c++)
+        room[r * kRoomCells + c] = 1;
+  };
+  box(0, 0, 4, kRoomCells);
+  box(kRoomCells - 4, 0, kRoomCells, kRoomCells);
+  box(0, 0, kRoomCells, 4);
+  box(0, kRoomCells - 4, kRoomCells, kRoomCells);
+  // boxes inside and outside of the loop the robot drives
+  box(130, 150, 170, 180);
+  box(250, 250, 290, 290);
+  box(30, 250, 60, 290);
+  box(260, 20, 300, 40);
+  MapRayCaster caster;
+  caster.setMap(room.data(), kRoomCells, kRoomCells, kRoomCellSize);
+
+  std::vector<float> angles(beams), ranges(beams);
+  for (size_t i = 0; i < beams; i++)
+  {
+    angles[i] = -M_PI + 2.0 * M_PI * i / beams;
+  }
+  // a loop through the room, about 4 cm and 1 degree per scan
+  std::mt19937 rng(7);
+  std::normal_distribution<float> gaussian(0.0f, 1.0f);
+  std::vector<ScanPose> truth(kScans);
+  std::vector<Points> scans(kScans);
+  for (int i = 0; i < kScans; i++)
+  {
+    const float t = 2.0f * M_PI * i / kScans;
+    truth[i] = ScanPose{4.0f + 2.5f * std::cos(t), 4.0f + 2.5f * std::sin(t), t + float(M_PI) / 2};
+    caster.cast(truth[i].x, truth[i].y, truth[i].heading, angles.data(), beams, kMaxRange, ranges.data());
+    for (size_t k = 0; k < beams; k++)
+    {
+      const float range = ranges[k] + noise * gaussian(rng);
+      if (range >= kMinRange && ranges[k] < kMaxRange)
+      {
+        scans[i].x.push_back(range * std::cos(angles[k]));
+        scans[i].y.push_back(range * std::sin(angles[k]));
+      }
+    }
+  }
+
+  // the tracks slip, the wheels report more motion than happened
+  auto slipping = [&](const ScanPose &delta) {
+    return ScanPose{delta.x * (1.0f + slip), delta.y * (1.0f + slip), delta.heading * (1.0f + 2.0f * slip)};
+  };
+  WheelIntegrator wheels;
+  wheels.reset(0.0);
+  ScanFusion fusion(options);
+  ScanPose wheel_pose = truth[0], scan_pose = truth[0];
+  size_t valid = 0;
+  double time_budget = 0.0;
+  fusion.add(scans[0].x.data(), scans[0].y.data(), scans[0].x.size(), wheels.take(0.0));
+  for (int i = 1; i < kScans; i++)
+  {
+    // speeds of the motion to this scan, reported during the previous scan period
+    const ScanPose delta = slipping(Compose(Inverse(truth[i - 1]), truth[i]));
+    const double linear_speed = std::hypot(delta.x, delta.y) / kScanPeriod;
+    const double angular_speed = delta.heading / kScanPeriod;
+    for (int k = 0; k < kStatesPerScan; k++)
+    {
+      wheels.addState((i - 1 + double(k) / kStatesPerScan) * kScanPeriod + kStateDelay, linear_speed, angular_speed);
+    }
+    const ScanPose wheel = wheels.take(i * kScanPeriod);
+    wheel_pose = Compose(wheel_pose, wheel);
+    const auto begin = std::chrono::steady_clock::now();
+    const ScanFusionResult result = fusion.add(scans[i].x.data(), scans[i].y.data(), scans[i].x.size(), wheel);
+    time_budget += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    valid += result.match.valid;
+    scan_pose = Compose(scan_pose, result.delta);
+  }
+  const ScanPose &end = truth[kScans - 1];
+  auto error = [&](const ScanPose &pose) { return std::hypot(pose.x - end.x, pose.y - end.y); };
+
+  // time of one match and of building the reference, between two scans with slip as guess, and of
+  // the whole odometry step while driving the loop again
+  const ScanPose guess = slipping(Compose(Inverse(truth[100]), truth[101]));
+  ScanMatcher matcher;
+  std::vector<BenchmarkResult> results;
+  results.push_back(RunBenchmark("correspondence grid",
+                                 [&] {
+                                   matcher.setReference(scans[100].x.data(), scans[100].y.data(),
+                                                        scans[100].x.size());
+                                 },
+                                 1.0));
+  results.push_back(RunBenchmark("point-to-line icp", [&] {
+    DoNotOptimize(matcher.match(scans[101].x.data(), scans[101].y.data(), scans[101].x.size(), guess).pose.x);
+  }, 1.0));
+  int next = 0;
+  results.push_back(RunBenchmark("scan fusion", [&] {
+    // the loop closes, the last scan is next to the first one
+    const int i = next;
+    next = (next + 1) % kScans;
+    const ScanPose wheel = slipping(Compose(Inverse(truth[(i + kScans - 1) % kScans]), truth[i]));
+    DoNotOptimize(fusion.add(scans[i].x.data(), scans[i].y.data(), scans[i].x.size(), wheel).delta.x);
+  }, 1.0));
+  const bool written = ReportBenchmarks(results, argv[0], json_path);
+  const ScanMatch match = matcher.match(scans[101].x.data(), scans[101].y.data(), scans[101].x.size(), guess);
+  std::printf("%zu beams, %.3f m noise, %.0f%% slip, wheel weight %.2f: %d iterations, %zu inliers, rms %.4f m\n",
+              beams, noise, 100.0f * slip, options.wheel_weight, match.iterations, match.inliers, match.rms);
+  std::printf("%d scans, %zu valid matches, %.3f ms per scan fusion on average\n", kScans - 1, valid,
+              1e3 * time_budget / (kScans - 1));
+  std::printf("end position error: wheels %.3f m, scan matching %.3f m; heading error: wheels %.3f rad, scan "
+              "matching %.3f rad\n",
+              error(wheel_pose), error(scan_pose), std::abs(wrap(wheel_pose.heading - end.heading)),
+              std::abs(wrap(scan_pose.heading - end.heading)));
+  return written ? 0 : 1;
+}
@@ -0,0 +1,232 @@
+#include "ScanMatcher.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace isaac
+{
+namespace ev3
+{
+
+namespace
+{
+
+// Four lanes, NEON on the Jetson and SSE on the host
+using Float4 = float __attribute__((vector_size(16)));
+using Int4 = int32_t __attribute__((vector_size(16)));
+
+Float4 broadcast(float value)
+{
+  return Float4{value, value, value, value};
+}
+
+float sum(Float4 value)
+{
+  return value[0] + value[1] + value[2] + value[3];
+}
+
+// Solves the symmetric 3x3 system h * x = g, false if it is (nearly) singular
+bool solve3(const double h[6], const double g[3], double x[3])
+{
+  // h = [h0 h1 h2; h1 h3 h4; h2 h4 h5]
+  const double c0 = h[3] * h[5] - h[4] * h[4];
+  const double c1 = h[2] * h[4] - h[1] * h[5];
+  const double c2 = h[1] * h[4] - h[2] * h[3];
+  const double det = h[0] * c0 + h[1] * c1 + h[2] * c2;
+  // for a positive semi-definite matrix the determinant is at most the product of the diagonal
+  if (!(det > 1e-6 * h[0] * h[3] * h[5]))
+  {
+    return false;
+  }
+  const double c4 = h[0] * h[5] - h[2] * h[2];
+  const double c5 = h[1] * h[2] - h[0] * h[4];
+  const double c8 = h[0] * h[3] - h[1] * h[1];
+  x[0] = (c0 * g[0] + c1 * g[1] + c2 * g[2]) / det;
+  x[1] = (c1 * g[0] + c4 * g[1] + c5 * g[2]) / det;
+  x[2] = (c2 * g[0] + c5 * g[1] + c8 * g[2]) / det;
+  return true;
+}
+
+} // namespace
+
+ScanMatcher::ScanMatcher(const ScanMatcherOptions &options) : options_(options) {}
+
+void ScanMatcher::setReference(const float *xs, const float *ys, size_t count)
+{
+  ref_x_.clear();
+  ref_y_.clear();
+  ref_nx_.clear();
+  ref_ny_.clear();
+  const float max_neighbor2 = options_.max_neighbor_distance * options_.max_neighbor_distance;
+  auto close = [&](size_t a, size_t b) {
+    const float dx = xs[a] - xs[b];
+    const float dy = ys[a] - ys[b];
+    return dx * dx + dy * dy <= max_neighbor2;
+  };
+  // the line through a point is given by its neighbors in scan order
+  for (size_t i = 0; i < count; i++)
+  {
+    const size_t prev = i > 0 && close(i, i - 1) ? i - 1 : i;
+    const size_t next = i + 1 < count && close(i, i + 1) ? i + 1 : i;
+    const float dx = xs[next] - xs[prev];
+    const float dy = ys[next] - ys[prev];
+    const float length = std::sqrt(dx * dx + dy * dy);
+    if (prev == next || length < 1e-6f)
+    {
+      continue;
+    }
+    ref_x_.push_back(xs[i]);
+    ref_y_.push_back(ys[i]);
+    ref_nx_.push_back(-dy / length);
+    ref_ny_.push_back(dx / length);
+  }
+  grid_.clear();
+  if (ref_x_.empty())
+  {
+    return;
+  }
+
+  const float margin = options_.max_correspondence;
+  const float cell = options_.grid_cell_size;
+  origin_x_ = *std::min_element(ref_x_.begin(), ref_x_.end()) - margin;
+  origin_y_ = *std::min_element(ref_y_.begin(), ref_y_.end()) - margin;
+  rows_ = int((*std::max_element(ref_x_.begin(), ref_x_.end()) + margin - origin_x_) / cell) + 1;
+  cols_ = int((*std::max_element(ref_y_.begin(), ref_y_.end()) + margin - origin_y_) / cell) + 1;
+  grid_.assign(size_t(rows_) * cols_, -1);
+  best_.assign(grid_.size(), margin * margin);
+  const int radius = int(std::ceil(margin / cell));
+  for (size_t i = 0; i < ref_x_.size(); i++)
+  {
+    const int row = int((ref_x_[i] - origin_x_) / cell);
+    const int col = int((ref_y_[i] - origin_y_) / cell);
+    for (int r = std::max(0, row - radius); r <= std::min(rows_ - 1, row + radius); r++)
+    {
+      for (int c = std::max(0, col - radius); c <= std::min(cols_ - 1, col + radius); c++)
+      {
+        const float dx = origin_x_ + (r + 0.5f) * cell - ref_x_[i];
+        const float dy = origin_y_ + (c + 0.5f) * cell - ref_y_[i];
+        const float distance2 = dx * dx + dy * dy;
+        const size_t index = size_t(r) * cols_ + c;
+        if (distance2 < best_[index])
+        {
+          best_[index] = distance2;
+          grid_[index] = int32_t(i);
+        }
+      }
+    }
+  }
+}
+
+ScanMatch ScanMatcher::match(const float *xs, const float *ys, size_t count, const ScanPose &guess)
+{
+  ScanMatch result;
+  result.pose = guess;
+  if (!hasReference() || count < 3)
+  {
+    return result;
+  }
+  // pad with copies of the first point, they are masked out below
+  const size_t padded = (count + 3) & ~size_t(3);
+  query_x_.assign(xs, xs + count);
+  query_y_.assign(ys, ys + count);
+  query_x_.resize(padded, xs[0]);
+  query_y_.resize(padded, ys[0]);
+
+  const float inverse_cell = 1.0f / options_.grid_cell_size;
+  const Float4 huber = broadcast(options_.huber);
+  const Float4 max_residual = broadcast(options_.max_correspondence);
+  const Float4 zero = broadcast(0.0f);
+  const Float4 one = broadcast(1.0f);
+  ScanPose pose = guess;
+  bool converged = false;
+  for (int iteration = 0; iteration < options_.max_iterations && !converged; iteration++)
+  {
+    const float c = std::cos(pose.heading);
+    const float s = std::sin(pose.heading);
+    const Float4 vc = broadcast(c), vs = broadcast(s);
+    const Float4 tx = broadcast(pose.x), ty = broadcast(pose.y);
+    const Float4 ox = broadcast(origin_x_), oy = broadcast(origin_y_);
+    const Float4 inv = broadcast(inverse_cell);
+    // upper triangle of J^T W J and J^T W r, plus inlier count and squared residuals
+    Float4 h00 = zero, h01 = zero, h02 = zero, h11 = zero, h12 = zero, h22 = zero;
+    Float4 g0 = zero, g1 = zero, g2 = zero, inliers = zero, squared = zero;
+    for (size_t i = 0; i < padded; i += 4)
+    {
+      const Float4 px = *reinterpret_cast<const Float4 *>(&query_x_[i]);
+      const Float4 py = *reinterpret_cast<const Float4 *>(&query_y_[i]);
+      // rotated point, the lever arm of the heading
+      const Float4 rx = vc * px - vs * py;
+      const Float4 ry = vs * px + vc * py;
+      const Float4 wx = rx + tx;
+      const Float4 wy = ry + ty;
+      const Float4 gx = (wx - ox) * inv;
+      const Float4 gy = (wy - oy) * inv;
+      // correspondences are a gather, one lane at a time
+      Float4 qx, qy, nx, ny, found;
+      for (int k = 0; k < 4; k++)
+      {
+        const int row = int(gx[k]);
+        const int col = int(gy[k]);
+        int32_t index = -1;
+        if (gx[k] >= 0.0f && gy[k] >= 0.0f && row < rows_ && col < cols_)
+        {
+          index = grid_[size_t(row) * cols_ + col];
+        }
+        const bool valid = index >= 0 && i + k < count;
+        const size_t j = valid ? index : 0;
+        qx[k] = ref_x_[j];
+        qy[k] = ref_y_[j];
+        nx[k] = ref_nx_[j];
+        ny[k] = ref_ny_[j];
+        found[k] = valid ? 1.0f : 0.0f;
+      }
+      const Float4 residual = nx * (wx - qx) + ny * (wy - qy);
+      const Float4 magnitude = residual < zero ? -residual : residual;
+      // Huber weight, 0 without correspondence or beyond max_correspondence
+      const Int4 inside = (magnitude <= max_residual) & (found > zero);
+      const Float4 weight = magnitude <= huber ? one : huber / magnitude;
+      const Float4 w = inside ? weight : zero;
+      const Float4 j2 = ny * rx - nx * ry;
+      const Float4 wn = w * nx, wny = w * ny, wj2 = w * j2;
+      h00 += wn * nx;
+      h01 += wn * ny;
+      h02 += wn * j2;
+      h11 += wny * ny;
+      h12 += wny * j2;
+      h22 += wj2 * j2;
+      g0 += wn * residual;
+      g1 += wny * residual;
+      g2 += wj2 * residual;
+      inliers += inside ? one : zero;
+      squared += inside ? residual * residual : zero;
+    }
+    const double h[6] = {sum(h00), sum(h01), sum(h02), sum(h11), sum(h12), sum(h22)};
+    const double g[3] = {-sum(g0), -sum(g1), -sum(g2)};
+    result.inliers = size_t(sum(inliers));
+    result.rms = result.inliers > 0 ? std::sqrt(sum(squared) / result.inliers) : 0.0f;
+    result.iterations = iteration + 1;
+    double delta[3];
+    if (result.inliers < 3 || !solve3(h, g, delta))
+    {
+      result.pose = guess;
+      return result;
+    }
+    pose.x += float(delta[0]);
+    pose.y += float(delta[1]);
+    pose.heading += float(delta[2]);
+    converged = std::abs(delta[0]) < options_.translation_tolerance &&
+                std::abs(delta[1]) < options_.translation_tolerance &&
+                std::abs(delta[2]) < options_.rotation_tolerance;
+  }
+  result.pose = pose;
+  result.valid = result.inliers >= options_.min_inlier_ratio * count;
+  if (!result.valid)
+  {
+    result.pose = guess;
+  }
+  return result;
+}
+
+} // namespace ev3
+} // namespace isaac
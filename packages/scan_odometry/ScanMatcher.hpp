@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace isaac {
+namespace ev3 {
+
+// A 2D pose, the transformation of points of the matched scan into the reference scan
+struct ScanPose {
+  float x = 0.0f;
+  float y = 0.0f;
+  float heading = 0.0f;
+};
+
+// Outcome of matching a scan against the reference
+struct ScanMatch {
+  ScanPose pose;
+  int iterations = 0;
+  // Points which found a correspondence in the last iteration
+  size_t inliers = 0;
+  // RMS of the point-to-line distances of the inliers in meters
+  float rms = 0.0f;
+  // False if there were too few inliers or the scan does not constrain all three directions, e.g.
+  // in a long corridor. The pose is the initial guess in that case.
+  bool valid = false;
+};
+
+struct ScanMatcherOptions {
+  // Cell size of the correspondence grid in meters
+  float grid_cell_size = 0.025f;
+  // Points further than this from a line of the reference have no correspondence
+  float max_correspondence = 0.1f;
+  // Residuals beyond this are down-weighted (Huber)
+  float huber = 0.03f;
+  // Neighbors further apart than this do not form a line
+  float max_neighbor_distance = 0.1f;
+  int max_iterations = 15;
+  // Iterations stop once an update moves less than these
+  float translation_tolerance = 1e-4f;
+  float rotation_tolerance = 1e-4f;
+  // Fraction of the points which need a correspondence for a valid match
+  float min_inlier_ratio = 0.3f;
+};
+
+// Matches a 2D scan against a reference scan with point-to-line ICP.
+//
+// The reference is turned into a correspondence grid once: every cell within max_correspondence of
+// a reference point holds the closest point and the normal of the line through its neighbors, thus
+// finding correspondences is a lookup instead of a search. Points are transformed and residuals
+// accumulated four at a time with vector instructions.
+//
+// Points are in meters in scan order, which is used to find the neighbors forming the lines.
+class ScanMatcher {
+ public:
+  explicit ScanMatcher(const ScanMatcherOptions& options = ScanMatcherOptions());
+
+  void setReference(const float* xs, const float* ys, size_t count);
+  bool hasReference() const { return !grid_.empty(); }
+
+  // Matches a scan starting at `guess`. Does not allocate once buffers reached the scan size.
+  ScanMatch match(const float* xs, const float* ys, size_t count, const ScanPose& guess);
+
+  const ScanMatcherOptions& options() const { return options_; }
+
+ private:
+  ScanMatcherOptions options_;
+  // reference points with valid normals, structure of arrays
+  std::vector<float> ref_x_, ref_y_, ref_nx_, ref_ny_;
+  // index of the closest reference point of every cell, -1 for none
+  std::vector<int32_t> grid_;
+  // squared distance of the closest point of every cell while building the grid
+  std::vector<float> best_;
+  float origin_x_ = 0.0f;
+  float origin_y_ = 0.0f;
+  int rows_ = 0;
+  int cols_ = 0;
+  // query points padded to a multiple of four
+  std::vector<float> query_x_, query_y_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
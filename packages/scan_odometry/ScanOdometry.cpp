@@ -0,0 +1,165 @@
+#include "ScanOdometry.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include "engine/core/tensor/tensor.hpp"
+#include "engine/core/time.hpp"
+#include "engine/gems/state/io.hpp"
+#include "messages/math.hpp"
+#include "messages/state/differential_base.hpp"
+#include "messages/tensor.hpp"
+
+namespace isaac
+{
+namespace ev3
+{
+
+void ScanOdometry::start()
+{
+  ScanFusionOptions options;
+  options.matcher.max_correspondence = static_cast<float>(get_max_correspondence());
+  options.matcher.max_iterations = get_max_iterations();
+  options.keyframe_distance = static_cast<float>(get_keyframe_distance());
+  options.keyframe_angle = static_cast<float>(get_keyframe_angle());
+  options.wheel_weight = static_cast<float>(get_wheel_weight());
+  options.min_point_distance = static_cast<float>(get_min_point_distance());
+  fusion_.reset(new ScanFusion(options));
+  wheels_.reset(new WheelIntegrator(get_base_state_timeout()));
+  wheels_->reset(getTickTime());
+  odom_T_robot_ = Pose2d::Identity();
+  last_acqtime_ = 0;
+  use_points_ = get_use_points();
+  if (use_points_)
+  {
+    tickOnMessage(rx_points());
+  }
+  else
+  {
+    tickOnMessage(rx_flatscan());
+  }
+}
+
+void ScanOdometry::stop()
+{
+  tick_latency_.dump(full_name());
+  LOG_INFO("Matched %llu scans, %llu fell back to wheel odometry",
+           static_cast<unsigned long long>(scans_), static_cast<unsigned long long>(failed_matches_));
+}
+
+void ScanOdometry::readBaseStates()
+{
+  rx_base_state().processAllNewMessages([this](auto proto, int64_t pubtime, int64_t acqtime) {
+    messages::DifferentialBaseDynamics state;
+    if (FromProto(proto, rx_base_state().buffers(), state))
+    {
+      wheels_->addState(ToSeconds(acqtime), state.linear_speed(), state.angular_speed());
+    }
+  });
+}
+
+void ScanOdometry::readPoints()
+{
+  auto scan = rx_flatscan().getProto();
+  auto ranges = scan.getRanges();
+  auto angles = scan.getAngles();
+  const float min_range = scan.getInvalidRangeThreshold();
+  const float max_range = scan.getOutOfRangeThreshold();
+  const size_t count = std::min(ranges.size(), angles.size());
+  xs_.clear();
+  ys_.clear();
+  for (size_t i = 0; i < count; i++)
+  {
+    const float range = ranges[i];
+    if (!(range >= min_range && range < max_range))
+    {
+      continue;
+    }
+    xs_.push_back(range * std::cos(angles[i]));
+    ys_.push_back(range * std::sin(angles[i]));
+  }
+}
+
+bool ScanOdometry::readTensorPoints()
+{
+  CpuTensorConstView2f points;
+  if (!FromProto(rx_points().getProto(), rx_points().buffers(), points) || points.dimensions()[0] != 2)
+  {
+    return false;
+  }
+  const int count = points.dimensions()[1];
+  xs_.clear();
+  ys_.clear();
+  for (int i = 0; i < count; i++)
+  {
+    // invalid and out of range beams are NaN
+    if (std::isnan(points(0, i)))
+    {
+      continue;
+    }
+    xs_.push_back(points(0, i));
+    ys_.push_back(points(1, i));
+  }
+  return true;
+}
+
+void ScanOdometry::tick()
+{
+  const auto timer = tick_latency_.measure();
+  tick_latency_.report(getTickTime(), [this](const char* tag, double value) { show(tag, value); });
+
+  const int64_t acqtime = use_points_ ? rx_points().acqtime() : rx_flatscan().acqtime();
+  readBaseStates();
+  const ScanPose wheel_delta = wheels_->take(ToSeconds(acqtime));
+  if (!use_points_)
+  {
+    readPoints();
+  }
+  else if (!readTensorPoints())
+  {
+    LOG_WARNING("Points are not a 2 x N tensor");
+    xs_.clear();
+    ys_.clear();
+  }
+  const ScanFusionResult result = fusion_->add(xs_.data(), ys_.data(), xs_.size(), wheel_delta);
+  if (!result.used)
+  {
+    // the first scan became the keyframe or the scan had too few points
+    if (last_acqtime_ == 0)
+    {
+      last_acqtime_ = acqtime;
+    }
+    return;
+  }
+  scans_++;
+  if (!result.match.valid)
+  {
+    failed_matches_++;
+  }
+  const Pose2d delta = Pose2d::FromXYA(result.delta.x, result.delta.y, result.delta.heading);
+  odom_T_robot_ = odom_T_robot_ * delta;
+
+  const double dt = std::max(1e-3, ToSeconds(acqtime - last_acqtime_));
+  last_acqtime_ = acqtime;
+  auto odometry = tx_odometry().initProto();
+  ToProto(odom_T_robot_, odometry.initOdomTRobot());
+  ToProto(Vector2d(delta.translation.x() / dt, delta.translation.y() / dt), odometry.initSpeed());
+  odometry.setAngularSpeed(delta.rotation.angle() / dt);
+  odometry.setOdometryFrame("scan_odom");
+  odometry.setRobotFrame("robot");
+  tx_odometry().publish(acqtime);
+  set_scan_odom_T_robot(odom_T_robot_, ToSeconds(acqtime));
+
+  show("x", odom_T_robot_.translation.x());
+  show("y", odom_T_robot_.translation.y());
+  show("heading", odom_T_robot_.rotation.angle());
+  show("points", static_cast<double>(fusion_->points()));
+  show("match.iterations", result.match.iterations);
+  show("match.inliers", static_cast<double>(result.match.inliers));
+  show("match.rms", result.match.rms);
+  show("match.failed", static_cast<double>(failed_matches_));
+}
+
+} // namespace ev3
+} // namespace isaac
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "ScanFusion.hpp"
+
+#include "engine/alice/alice.hpp"
+#include "messages/messages.hpp"
+#include "packages/instrumentation/TickLatency.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// Odometry from matching lidar scans, fused with the wheel speeds of the EV3.
+//
+// The tracks of the tank slip, thus integrating the wheel speeds alone drifts quickly. Every scan
+// is matched against a keyframe scan with ScanMatcher, starting from the motion integrated from
+// every base_state received up to the acquisition time of the scan. A new keyframe is taken once
+// the robot moved far enough from the old one, which keeps the drift low while standing still. If
+// a scan does not match, e.g. when it sees only a straight wall, the wheel motion is used for it.
+// These steps are in ScanFusion.
+//
+// The pose is published as Odometry2Proto and written to the pose tree as scan_odom_T_robot, thus
+// it can replace the wheel odometry of DifferentialBaseWheelImuOdometry for consumers like
+// ScanKeyframeGate or GMapping.
+class ScanOdometry : public isaac::alice::Codelet {
+ public:
+  void start() override;
+  void stop() override;
+  void tick() override;
+
+  // Scans in the robot frame, e.g. from LidarAngleChanger
+  ISAAC_PROTO_RX(FlatscanProto, flatscan);
+  // The same scans as a 2 x N tensor of points in the robot frame with NaN for invalid beams, the
+  // points of LidarAngleChanger. Used instead of flatscan with use_points.
+  ISAAC_PROTO_RX(TensorProto, points);
+  // Speeds reported by Ev3Driver
+  ISAAC_PROTO_RX(StateProto, base_state);
+  // Fused odometry
+  ISAAC_PROTO_TX(Odometry2Proto, odometry);
+
+  // Distance in meters and angle in radians from the keyframe at which a new keyframe is taken
+  ISAAC_PARAM(double, keyframe_distance, 0.1);
+  ISAAC_PARAM(double, keyframe_angle, 0.2);
+  // Weight of the wheel motion when fusing it with the matched motion, see ScanFusionOptions. 0
+  // uses the wheels only as the initial guess and for failed matches.
+  ISAAC_PARAM(double, wheel_weight, 0.0);
+  // See ScanMatcherOptions
+  ISAAC_PARAM(double, max_correspondence, 0.1);
+  ISAAC_PARAM(int, max_iterations, 15);
+  // Points closer than this to each other are merged, bounds the matching time of dense scans
+  ISAAC_PARAM(double, min_point_distance, 0.01);
+  // Match the points instead of the flatscan, thus the sines and cosines of the beams are not
+  // computed again here and the mount offset of LidarAngleChanger applies
+  ISAAC_PARAM(bool, use_points, false);
+  // Seconds after a base_state at which its speeds stop being integrated when no newer one arrived
+  ISAAC_PARAM(double, base_state_timeout, 0.5);
+  ISAAC_POSE2(scan_odom, robot);
+
+ private:
+  // Converts the received scan to points
+  void readPoints();
+  // Copies the valid received points, false if the tensor is not 2 x N
+  bool readTensorPoints();
+  // Queues the speeds of all base_state received since the previous tick
+  void readBaseStates();
+
+  std::unique_ptr<ScanFusion> fusion_;
+  std::unique_ptr<WheelIntegrator> wheels_;
+  std::vector<float> xs_;
+  std::vector<float> ys_;
+  // use_points when the codelet started, which decides the channel it ticks on
+  bool use_points_ = false;
+  Pose2d odom_T_robot_;
+  int64_t last_acqtime_ = 0;
+  uint64_t scans_ = 0;
+  uint64_t failed_matches_ = 0;
+  TickLatency tick_latency_;
+};
+
+}  // namespace ev3
+}  // namespace isaac
+
+ISAAC_ALICE_REGISTER_CODELET(isaac::ev3::ScanOdometry);
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace isaac {
+namespace ev3 {
+
+// Keeps the compiler from optimizing away a value computed in a benchmark
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Result of one benchmark
+struct BenchmarkResult {
+  std::string name;
+  size_t iterations = 0;
+  // Average wall time of one iteration
+  double ns_per_iteration = 0.0;
+  // Optional throughput in items per second, 0 if not applicable
+  double items_per_second = 0.0;
+};
+
+// Runs `function` with a growing number of iterations until one batch takes at least `min_time`
+// seconds and reports the time per iteration of that batch. `items_per_iteration` is used to
+// compute a throughput, for example pixels or beams.
+template <typename Function>
+BenchmarkResult RunBenchmark(const std::string& name, Function&& function, double items_per_iteration = 0.0,
+                             double min_time = 0.5) {
+  using Clock = std::chrono::steady_clock;
+  // warm up caches and lazily allocated buffers
+  function();
+  BenchmarkResult result;
+  result.name = name;
+  for (size_t iterations = 1;; iterations *= 2) {
+    const Clock::time_point begin = Clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+      function();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    if (seconds >= min_time || iterations >= (size_t(1) << 40)) {
+      result.iterations = iterations;
+      result.ns_per_iteration = 1e9 * seconds / iterations;
+      result.items_per_second = items_per_iteration * iterations / seconds;
+      break;
+    }
+  }
+  return result;
+}
+
+// Prints results as a table
+inline void PrintBenchmarks(const std::vector<BenchmarkResult>& results) {
+  std::printf("%-48s %14s %14s %16s\n", "benchmark", "iterations", "ns/iteration", "items/s");
+  for (const auto& result : results) {
+    std::printf("%-48s %14zu %14.1f %16.1f\n", result.name.c_str(), result.iterations, result.ns_per_iteration,
+                result.items_per_second);
+  }
+}
+
+// Removes --benchmark_out=PATH from the arguments, like Google Benchmark's Initialize, and returns
+// PATH or an empty string. The remaining arguments can be parsed as before.
+inline std::string ParseBenchmarkOut(int& argc, char** argv) {
+  static const char kFlag[] = "--benchmark_out=";
+  std::string path;
+  int kept = 0;
+  for (int i = 0; i < argc; i++) {
+    if (std::strncmp(argv[i], kFlag, sizeof(kFlag) - 1) == 0) {
+      path = argv[i] + sizeof(kFlag) - 1;
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  argc = kept;
+  return path;
+}
+
+// Writes results in the JSON format of Google Benchmark, thus compare_benchmarks.py and
+// Google Benchmark's own tools can read them. Returns false if the file could not be written.
+inline bool WriteBenchmarksJson(const std::vector<BenchmarkResult>& results, const std::string& executable,
+                                const std::string& path) {
+  FILE* file = std::fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+  // names are plain ASCII, only quotes and backslashes need escaping
+  auto quoted = [](const std::string& text) {
+    std::string result = "\"";
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        result += '\\';
+      }
+      result += c;
+    }
+    return result + "\"";
+  };
+  std::fprintf(file, "{\n  \"context\": {\n    \"executable\": %s,\n    \"num_cpus\": %u\n  },\n",
+               quoted(executable).c_str(), std::thread::hardware_concurrency());
+  std::fprintf(file, "  \"benchmarks\": [");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult& result = results[i];
+    std::fprintf(file,
+                 "%s\n    {\n      \"name\": %s,\n      \"iterations\": %zu,\n      \"real_time\": %.3f,\n"
+                 "      \"time_unit\": \"ns\",\n      \"items_per_second\": %.3f\n    }",
+                 i == 0 ? "" : ",", quoted(result.name).c_str(), result.iterations, result.ns_per_iteration,
+                 result.items_per_second);
+  }
+  std::fprintf(file, "\n  ]\n}\n");
+  return std::fclose(file) == 0;
+}
+
+// Prints results as a table and writes them as JSON to `json_path` unless it is empty. Returns
+// false if the JSON could not be written.
+inline bool ReportBenchmarks(const std::vector<BenchmarkResult>& results, const std::string& executable,
+                             const std::string& json_path) {
+  PrintBenchmarks(results);
+  if (json_path.empty()) {
+    return true;
+  }
+  if (!WriteBenchmarksJson(results, executable, json_path)) {
+    std::fprintf(stderr, "Could not write %s\n", json_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ev3
+}  // namespace isaac
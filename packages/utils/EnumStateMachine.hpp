@@ -0,0 +1,179 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <type_traits>
+
+#include "InlineFunction.hpp"
+
+namespace isaac {
+namespace ev3 {
+
+// A state machine for states given as an enum. It has the same interface as
+// state_machine::StateMachine but the tables are arrays indexed by the state and all callbacks are
+// stored in place, thus a tick does no lookups, no allocations and no std::function calls.
+//
+// The enum must be contiguous, start at 0 and end with a `kCount` entry. At most `MaxTransitions`
+// transitions can leave a state; they are checked in the order they were added.
+//
+// The machine records how long it stayed in each state and how much time was spent evaluating
+// transition conditions, see `stats`. Reading the clock costs more than checking a few simple
+// conditions, thus only one in `kCheckSampling` checks is timed; the clock is read on every
+// transition though.
+template <typename State, size_t MaxTransitions = 4>
+class EnumStateMachine {
+ public:
+  static_assert(std::is_enum<State>::value, "States must be an enum");
+  static constexpr size_t kStateCount = static_cast<size_t>(State::kCount);
+
+  using Action = InlineFunction<void()>;
+  using Condition = InlineFunction<bool()>;
+  using Clock = std::chrono::steady_clock;
+  // Every n-th check of the transitions is timed, must be a power of two
+  static constexpr uint64_t kCheckSampling = 64;
+  static_assert((kCheckSampling & (kCheckSampling - 1)) == 0, "Sampling must be a power of two");
+
+  // Timing of one state
+  struct Stats {
+    // Number of times the state was entered and ticked
+    uint64_t entries = 0;
+    uint64_t ticks = 0;
+    // Total time spent in the state, including the time of the current visit only after it ended
+    Clock::duration time_in_state = Clock::duration::zero();
+    // Number of ticks in which the transitions leaving this state were checked
+    uint64_t checks = 0;
+    // Number of timed checks and the total time they took
+    uint64_t timed_checks = 0;
+    Clock::duration check_time = Clock::duration::zero();
+
+    // Average time to check the transitions in seconds
+    double averageCheckTime() const {
+      return timed_checks == 0 ? 0.0 : std::chrono::duration<double>(check_time).count() / timed_checks;
+    }
+  };
+
+  // Sets a function to get a printable name for a state
+  void setToString(const char* (*to_string)(State)) { to_string_ = to_string; }
+
+  // Adds a state with actions called when the state is entered, on every tick while in the state
+  // and when the state is left
+  void addState(State state, Action entry, Action stay, Action exit) {
+    Slot& slot = slots_[index(state)];
+    slot.added = true;
+    slot.entry = entry;
+    slot.stay = stay;
+    slot.exit = exit;
+  }
+
+  // Adds a transition which is taken if `condition` is true. `on_transition` is called after the
+  // old state was exited and before the new state is entered.
+  void addTransition(State from, State to, Condition condition, Action on_transition) {
+    Slot& slot = slots_[index(from)];
+    // Too many transitions for this state, increase MaxTransitions
+    if (slot.transition_count == MaxTransitions) std::terminate();
+    slot.transitions[slot.transition_count++] = Transition{to, condition, on_transition};
+  }
+
+  // Enters the given state
+  void start(State state) {
+    running_ = true;
+    enter(state, Clock::now());
+  }
+
+  // Takes the first transition of the current state whose condition holds, otherwise calls the
+  // stay action of the current state
+  void tick() {
+    if (!running_) return;
+    Slot& slot = slots_[index(current_)];
+    Stats& stats = stats_[index(current_)];
+    stats.ticks++;
+    if (slot.transition_count > 0) {
+      const bool timed = (stats.checks++ & (kCheckSampling - 1)) == 0;
+      const Clock::time_point begin = timed ? Clock::now() : Clock::time_point();
+      const Transition* taken = nullptr;
+      for (size_t i = 0; i < slot.transition_count; i++) {
+        if (slot.transitions[i].condition()) {
+          taken = &slot.transitions[i];
+          break;
+        }
+      }
+      if (timed) {
+        stats.timed_checks++;
+        stats.check_time += Clock::now() - begin;
+      }
+      if (taken != nullptr) {
+        const Clock::time_point now = Clock::now();
+        leave(now);
+        if (taken->on_transition) taken->on_transition();
+        enter(taken->to, now);
+        return;
+      }
+    }
+    if (slot.stay) slot.stay();
+  }
+
+  // Exits the current state
+  void stop() {
+    if (!running_) return;
+    leave(Clock::now());
+    running_ = false;
+  }
+
+  bool running() const { return running_; }
+  // The current state, only meaningful while running
+  State current_state() const { return current_; }
+  // Name of a state as given by the function set with setToString
+  const char* name(State state) const { return to_string_ ? to_string_(state) : "?"; }
+
+  // Timing of a state. The time of the current visit is added once the state is left.
+  const Stats& stats(State state) const { return stats_[index(state)]; }
+  // Time since the current state was entered
+  Clock::duration timeInCurrentState() const { return Clock::now() - entered_at_; }
+
+ private:
+  struct Transition {
+    State to;
+    Condition condition;
+    Action on_transition;
+  };
+
+  struct Slot {
+    bool added = false;
+    Action entry;
+    Action stay;
+    Action exit;
+    std::array<Transition, MaxTransitions> transitions;
+    size_t transition_count = 0;
+  };
+
+  static size_t index(State state) { return static_cast<size_t>(state); }
+
+  void enter(State state, Clock::time_point now) {
+    // Entering a state which was never added is a programming error
+    if (!slots_[index(state)].added) std::terminate();
+    current_ = state;
+    entered_at_ = now;
+    stats_[index(state)].entries++;
+    const Action& entry = slots_[index(state)].entry;
+    if (entry) entry();
+  }
+
+  void leave(Clock::time_point now) {
+    stats_[index(current_)].time_in_state += now - entered_at_;
+    const Action& exit = slots_[index(current_)].exit;
+    if (exit) exit();
+  }
+
+  std::array<Slot, kStateCount> slots_;
+  std::array<Stats, kStateCount> stats_;
+  const char* (*to_string_)(State) = nullptr;
+  State current_ = State::kCount;
+  Clock::time_point entered_at_;
+  bool running_ = false;
+};
+
+}  // namespace ev3
+}  // namespace isaac
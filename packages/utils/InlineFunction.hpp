@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace isaac {
+namespace ev3 {
+
+template <typename Signature, size_t Capacity = 2 * sizeof(void*)>
+class InlineFunction;
+
+// A callable stored in place without heap allocation or virtual dispatch. It only accepts
+// trivially copyable callables which fit into `Capacity` bytes, which covers lambdas capturing
+// `this` or a couple of pointers. Bigger captures fail to compile instead of silently allocating.
+template <typename Result, typename... Args, size_t Capacity>
+class InlineFunction<Result(Args...), Capacity> {
+ public:
+  InlineFunction() = default;
+
+  template <typename Function,
+            typename = std::enable_if_t<!std::is_same<std::decay_t<Function>, InlineFunction>::value>>
+  InlineFunction(Function function) {
+    static_assert(sizeof(Function) <= Capacity, "Callable is too big, capture less");
+    static_assert(alignof(Function) <= alignof(Storage), "Callable is over-aligned");
+    static_assert(std::is_trivially_copyable<Function>::value,
+                  "Callable must be trivially copyable, capture pointers instead of objects");
+    new (&storage_) Function(function);
+    invoke_ = [](const Storage& storage, Args... args) -> Result {
+      return (*reinterpret_cast<const Function*>(&storage))(std::forward<Args>(args)...);
+    };
+  }
+
+  explicit operator bool() const { return invoke_ != nullptr; }
+
+  Result operator()(Args... args) const { return invoke_(storage_, std::forward<Args>(args)...); }
+
+ private:
+  using Storage = std::aligned_storage_t<Capacity, alignof(void*)>;
+
+  Storage storage_;
+  Result (*invoke_)(const Storage&, Args...) = nullptr;
+};
+
+}  // namespace ev3
+}  // namespace isaac
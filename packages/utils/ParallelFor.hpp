@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace isaac {
+namespace ev3 {
+
+// Calls `function(i)` for every i in [0, count) using up to `threads` threads. The calling thread
+// does part of the work and the call returns once all items are done. Items are handed out one by
+// one, thus they should each be big enough to be worth a thread hop (e.g. a band of image rows).
+// A thread count of 0 uses all hardware threads.
+template <typename Function>
+void parallelFor(size_t count, size_t threads, Function&& function) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min(threads, count);
+  if (threads <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      function(i);
+    }
+    return;
+  }
+  std::atomic<size_t> next(0);
+  auto worker = [&] {
+    for (size_t i = next++; i < count; i = next++) {
+      function(i);
+    }
+  };
+  std::vector<std::thread> helpers;
+  helpers.reserve(threads - 1);
+  for (size_t i = 1; i < threads; i++) {
+    helpers.emplace_back(worker);
+  }
+  worker();
+  for (auto& helper : helpers) {
+    helper.join();
+  }
+}
+
+// Threads which are started once and then run parallelFor-style loops, for callers which run a
+// loop per frame and should neither spawn threads nor allocate in steady state. The calling thread
+// takes part in every loop. Not thread safe: one loop runs at a time.
+class WorkerPool {
+ public:
+  // A thread count of 0 uses all hardware threads
+  explicit WorkerPool(size_t threads = 0) {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    helpers_.reserve(threads - 1);
+    for (size_t i = 1; i < threads; i++) {
+      helpers_.emplace_back([this] { helperLoop(); });
+    }
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    start_.notify_all();
+    for (auto& helper : helpers_) {
+      helper.join();
+    }
+  }
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // Number of threads including the calling one
+  size_t threads() const { return helpers_.size() + 1; }
+
+  // Calls `function(i)` for every i in [0, count) and returns once all items are done
+  template <typename Function>
+  void run(size_t count, Function&& function) {
+    using Callable = typename std::remove_reference<Function>::type;
+    if (helpers_.empty() || count <= 1) {
+      for (size_t i = 0; i < count; i++) {
+        function(i);
+      }
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      function_ = const_cast<void*>(static_cast<const void*>(&function));
+      call_ = [](void* function, size_t i) { (*static_cast<Callable*>(function))(i); };
+      count_ = count;
+      next_ = 0;
+      busy_ = helpers_.size();
+      generation_++;
+    }
+    start_.notify_all();
+    work();
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busy_ == 0; });
+  }
+
+ private:
+  void work() {
+    for (size_t i = next_++; i < count_; i = next_++) {
+      call_(function_, i);
+    }
+  }
+
+  void helperLoop() {
+    uint64_t generation = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_.wait(lock, [&] { return stop_ || generation_ != generation; });
+        if (stop_) {
+          return;
+        }
+        generation = generation_;
+      }
+      work();
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--busy_ == 0) {
+        done_.notify_one();
+      }
+    }
+  }
+
+  std::vector<std::thread> helpers_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  bool stop_ = false;
+  uint64_t generation_ = 0;
+  size_t busy_ = 0;
+  // the current loop, set under mutex_ before the helpers are woken
+  void* function_ = nullptr;
+  void (*call_)(void*, size_t) = nullptr;
+  size_t count_ = 0;
+  std::atomic<size_t> next_{0};
+};
+
+}  // namespace ev3
+}  // namespace isaac
@@ -0,0 +1,112 @@
+'''
+Compares benchmark results against a checked-in baseline and flags regressions.
+
+The results are the JSON files written by the benchmarks of this repository with
+--benchmark_out=PATH, see Benchmark.hpp, or by Google Benchmark. Benchmarks are matched by the name
+of their executable and their own name, the baseline keeps the executable of every benchmark in
+its own field. A benchmark regressed if its time per iteration grew by more than the threshold; the
+script then exits with 1. It also fails for results without a baseline, which is added with
+--update on the machine the baseline is kept for. Baseline benchmarks missing from the results
+are listed but do not fail the comparison, thus a subset of the suite can be compared.
+
+  compare_benchmarks.py [--threshold 0.15] [--allow-new] BASELINE RESULTS...
+  compare_benchmarks.py --update BASELINE RESULTS...
+
+run_benchmarks.sh runs the suite and compares it with benchmark_baseline.json.
+'''
+
+import argparse
+import json
+import os
+import sys
+
+
+def load(path):
+    '''Returns the benchmarks of a results file or the baseline by (executable, name).'''
+    with open(path) as file:
+        results = json.load(file)
+    executable = os.path.basename(results.get('context', {}).get('executable', ''))
+    benchmarks = {}
+    for benchmark in results.get('benchmarks', []):
+        # entries of the baseline carry their executable, results files have it in the context
+        key = (benchmark.get('executable', executable), benchmark['name'])
+        benchmarks[key] = benchmark
+    return benchmarks
+
+
+def label(key):
+    return '%s/%s' % key
+
+
+def nanoseconds(benchmark):
+    scale = {'ns': 1.0, 'us': 1e3, 'ms': 1e6, 's': 1e9}[benchmark.get('time_unit', 'ns')]
+    return benchmark['real_time'] * scale
+
+
+def update(baseline_path, results):
+    baseline = load(baseline_path) if os.path.exists(baseline_path) else {}
+    baseline.update(results)
+    benchmarks = []
+    for key in sorted(baseline):
+        benchmark = dict(baseline[key])
+        benchmark['executable'], benchmark['name'] = key
+        benchmarks.append(benchmark)
+    with open(baseline_path, 'w') as file:
+        json.dump({'context': {'executable': ''}, 'benchmarks': benchmarks}, file, indent=2)
+        file.write('\n')
+    print('Wrote %d benchmarks to %s' % (len(benchmarks), baseline_path))
+    return 0
+
+
+def compare(baseline, results, threshold, allow_new):
+    regressions = 0
+    unknown = 0
+    print('%-64s %14s %14s %9s' % ('benchmark', 'baseline ns', 'current ns', 'change'))
+    for key in sorted(set(baseline) | set(results)):
+        if key not in results:
+            print('%-64s %14.1f %14s %9s' % (label(key), nanoseconds(baseline[key]), '-', 'missing'))
+            continue
+        if key not in baseline:
+            print('%-64s %14s %14.1f %9s' % (label(key), '-', nanoseconds(results[key]), 'new'))
+            unknown += 1
+            continue
+        before = nanoseconds(baseline[key])
+        after = nanoseconds(results[key])
+        change = after / before - 1.0
+        flag = ''
+        if change > threshold:
+            flag = '  REGRESSION'
+            regressions += 1
+        print('%-64s %14.1f %14.1f %+8.1f%%%s' % (label(key), before, after, 100.0 * change, flag))
+    failed = False
+    if regressions:
+        print('%d benchmarks regressed by more than %.0f%%' % (regressions, 100.0 * threshold))
+        failed = True
+    if unknown and not allow_new:
+        print('%d benchmarks have no baseline, add them with --update' % unknown)
+        failed = True
+    return 1 if failed else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compares benchmark results with a baseline')
+    parser.add_argument('baseline', help='Baseline JSON file')
+    parser.add_argument('results', nargs='+', help='JSON files written with --benchmark_out')
+    parser.add_argument('--threshold', type=float, default=0.15,
+                        help='Relative slowdown above which a benchmark regressed')
+    parser.add_argument('--update', action='store_true',
+                        help='Merge the results into the baseline instead of comparing')
+    parser.add_argument('--allow-new', action='store_true',
+                        help='Do not fail for results without a baseline')
+    args = parser.parse_args()
+
+    results = {}
+    for path in args.results:
+        results.update(load(path))
+    if args.update:
+        return update(args.baseline, results)
+    return compare(load(args.baseline), results, args.threshold, args.allow_new)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,26 @@
+#!/bin/bash
+# Runs the benchmarks of the hot kernels and compares them with benchmark_baseline.json. Extra
+# arguments are passed to compare_benchmarks.py, e.g. --update to refresh the baseline on the
+# machine it is kept for.
+#
+#   packages/utils/run_benchmarks.sh [--threshold 0.15] [--update]
+
+set -e
+
+TARGETS=(
+  //packages/ev3/control:kinematics_benchmark
+  //packages/ev3/ev3dev:ev3_control_rpc_benchmark
+  //packages/lidar_angle_changer:scan_transform_benchmark
+  //apps/ev3/battle_tank:imaging_benchmark
+)
+
+ROOT="$(cd "$(dirname "$0")/../.." && pwd)"
+OUT="$(mktemp -d /tmp/benchmarks.XXXXXX)"
+RESULTS=()
+for target in "${TARGETS[@]}"; do
+  result="$OUT/${target##*:}.json"
+  (cd "$ROOT" && bazel run -c opt "$target" -- --benchmark_out="$result")
+  RESULTS+=("$result")
+done
+python3 "$ROOT/packages/utils/compare_benchmarks.py" "$@" "$ROOT/packages/utils/benchmark_baseline.json" \
+  "${RESULTS[@]}"